@@ -75,6 +75,7 @@ void ClockWithConfig::configForm(WebContext* svr) {
 }
 
 void ClockWithConfig::handleSetConfiguration(WebContext* svr) {
+  boolean changed = false;
   int numArgs = svr->argCount();
   for( int i=0; i<numArgs; i++) {
      const String& argName = svr->argName(i);
@@ -84,9 +85,16 @@ void ClockWithConfig::handleSetConfiguration(WebContext* svr) {
         if(arg.startsWith("-")) tz = -(arg.substring(1).toDouble());
         else tz = arg.toDouble();
         setTimezone(tz);
+        changed = true;
+     }
+     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {
+        if( arg.length() > 0 ) {
+           setDisplayName(arg.c_str());
+           changed = true;
+        }
      }
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
   }
+  if( changed ) entityTag()->touchConfig();            // Only a change invalidates cached configuration and ETags
   display(svr);  
 }
 
@@ -0,0 +1,123 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "ChunkedWriter.h"
+#include "HandlerMetrics.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+ChunkedWriter::ChunkedWriter(WebContext* svr, const char* contentType, int code) : _svr(svr), _contentType(contentType), _code(code) {
+  _buffer[0] = '\0';
+}
+
+/**
+ *  Format f into the buffer at the current position. If the result does not fit, send what was in the buffer
+ *  before f was called and format f again into the empty buffer. A fragment that does not fit in an empty
+ *  buffer is truncated.
+ */
+void ChunkedWriter::write(FormatFunction f) {
+  if( _ended ) return;
+  int start = _pos;
+  int pos = f(_buffer,CHUNK_SIZE,start);
+  if( overflow(pos) && (start > 0) ) {
+    _buffer[start] = '\0';
+    flush();
+    pos = f(_buffer,CHUNK_SIZE,0);
+  }
+  if( overflow(pos) ) {
+    _truncated++;
+    pos = CHUNK_SIZE-1;
+    _buffer[pos] = '\0';
+  }
+  _pos = ((pos<0)?(0):(pos));
+}
+
+void ChunkedWriter::printf_P(PGM_P format, ...) {
+  va_list args;
+  va_start(args,format);
+  write([format,&args](char buffer[], int size, int pos) {
+    va_list a;
+    va_copy(a,args);
+    int n = vsnprintf_P(buffer+pos,size-pos,format,a);
+    va_end(a);
+    return ((n<0)?(pos):(pos+n));
+  });
+  va_end(args);
+}
+
+/**
+ *  formatHeader() always writes from the start of a buffer so anything pending is sent first
+ */
+void ChunkedWriter::header(const char* title) {
+  if( _pos > 0 ) flush();
+  write([title](char buffer[], int size, int pos) {return formatHeader(buffer,size,title);});
+}
+
+void ChunkedWriter::tail() {
+  write([](char buffer[], int size, int pos) {return formatTail(buffer,size,pos);});
+}
+
+void ChunkedWriter::content(UPnPDevice* d) {
+  if( d != NULL ) write([d](char buffer[], int size, int pos) {return d->formatContent(buffer,size,pos);});
+}
+
+void ChunkedWriter::rootContent(UPnPDevice* d) {
+  if( d != NULL ) write([d](char buffer[], int size, int pos) {return d->formatRootContent(buffer,size,pos);});
+}
+
+/**
+ *  First flush sends the status line and headers with unknown content length, which switches the WebServer to
+ *  chunked transfer encoding. Every flush after that is a single chunk.
+ */
+void ChunkedWriter::flush() {
+  if( _pos <= 0 ) return;
+  if( !_chunked ) {
+    _svr->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    _svr->send(_code,_contentType,"");
+    _chunked = true;
+  }
+  _svr->sendContent(_buffer,_pos);
+  HandlerMetrics::shared()->sent(_pos);
+  _sent += _pos;
+  _pos = 0;
+  _buffer[0] = '\0';
+}
+
+void ChunkedWriter::end() {
+  if( _ended ) return;
+  if( !_chunked ) {
+    _svr->send(_code,_contentType,_buffer);
+    HandlerMetrics::shared()->sent(_pos);
+    _sent += _pos;
+    _pos = 0;
+  }
+  else {
+    flush();
+    _svr->sendContent("");                // Zero length chunk terminates the response
+  }
+  _ended = true;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,97 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef CHUNKED_WRITER_H
+#define CHUNKED_WRITER_H
+
+#include <UPnPLib.h>
+
+/**
+ *   Size of the chunk buffer. Any single fragment (header, one device's content, one button...) must fit
+ *   in a chunk, but the page as a whole can be any length.
+ */
+#define CHUNK_SIZE 1024
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *   A format function has the same signature as UPnPDevice::formatContent(); it writes into buffer starting at pos
+ *   and returns the updated write position.
+ */
+typedef std::function<int(char[],int,int)> FormatFunction;
+
+/** ChunkedWriter streams an HTTP response through a fixed size buffer. Page fragments are formatted into the buffer
+ *  with the usual formatBuffer_P() style functions, and when a fragment would not fit, the buffer is sent to the client
+ *  as an HTTP chunk (Transfer-Encoding: chunked) and the fragment is formatted again into the empty buffer. Peak RAM is
+ *  CHUNK_SIZE, independent of the number of embedded devices on the page.
+ *  If the entire response fits in a single chunk, it is sent with a normal svr->send() on end().
+ *  Usage:
+ *      ChunkedWriter w(svr);
+ *      w.header(getDisplayName());
+ *      w.content(device);
+ *      w.printf_P(config_button,pathBuff,"Configure");
+ *      w.tail();
+ *  The response is completed by end(), which is called from the destructor if not called explicitly.
+ */
+class ChunkedWriter {
+  public:
+    ChunkedWriter(WebContext* svr, const char* contentType = "text/html", int code = 200);
+    virtual ~ChunkedWriter()                 {end();}
+
+    void           write(FormatFunction f);                                     // Append the output of a format function
+    void           printf_P(PGM_P format, ...);                                 // Append a PROGMEM template
+    void           header(const char* title);                                   // Append HTML header and title (formatHeader)
+    void           tail();                                                      // Append HTML tail (formatTail)
+    void           content(UPnPDevice* d);                                      // Append d->formatContent()
+    void           rootContent(UPnPDevice* d);                                  // Append d->formatRootContent()
+    void           end();                                                       // Flush remaining content and complete the response
+
+    size_t         bytesSent()               {return _sent;}                    // Number of bytes sent so far
+    int            truncated()               {return _truncated;}               // Number of fragments larger than CHUNK_SIZE
+    boolean        isChunked()               {return _chunked;}
+
+  private:
+    void           flush();
+    boolean        overflow(int pos)         {return (pos >= CHUNK_SIZE-1);}
+
+    WebContext*    _svr;
+    const char*    _contentType;
+    int            _code;
+    int            _pos       = 0;
+    size_t         _sent      = 0;
+    int            _truncated = 0;
+    boolean        _chunked   = false;
+    boolean        _ended     = false;
+    char           _buffer[CHUNK_SIZE];
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(ChunkedWriter);
+};
+
+} // End of namespace lsc
+
+#endif
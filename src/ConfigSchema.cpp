@@ -0,0 +1,314 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "ConfigSchema.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char config_displayName[]    PROGMEM = "displayName";
+const char sensor_name_label[]     PROGMEM = "Sensor Name";
+const char control_name_label[]    PROGMEM = "Control Name";
+
+#ifdef ARDUINO
+constexpr ConfigField displayName_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(UPnPObject,sensor_name_label)
+};
+const ConfigSchema displayName_schema(displayName_fields,sizeof(displayName_fields)/sizeof(ConfigField));
+
+/**
+ *  Field inputs take the field name, label, field name (id), and field name (name), followed by the type specific values
+ */
+const char field_text[]            PROGMEM = "<label for=\"%s\">%s</label>&emsp;"
+                                             "<input type=\"text\" id=\"%s\" name=\"%s\" maxlength=\"%ld\" placeholder=\"%s\">";
+const char field_number[]          PROGMEM = "<label for=\"%s\">%s</label>&emsp;"
+                                             "<input type=\"number\" id=\"%s\" name=\"%s\" min=\"%ld\" max=\"%ld\" style=\"width:4.1em\" value=\"%ld\">";
+const char field_char[]            PROGMEM = "<label for=\"%s\">%s</label>&emsp;"
+                                             "<input type=\"text\" id=\"%s\" name=\"%s\" pattern=\"[%s]{1}\" maxlength=\"1\" style=\"width:2.1em;font-size:1em\" placeholder=\"%c\">";
+const char field_offset[]          PROGMEM = "<label for=\"%s\">%s</label>&emsp;"
+                                             "<input type=\"text\" id=\"%s\" name=\"%s\" pattern=\"[+\\-]?[0-9]{1,2}(:[0-9]{2})?\" style=\"width:4.1em\" placeholder=\"%s\">";
+const char field_break[]           PROGMEM = "<br><br>";
+const char schema_form_head[]      PROGMEM = "<form action=\"%s\"><div align=\"center\">";
+const char schema_form_tail[]      PROGMEM = "<button class=\"fmButton\" type=\"submit\">Submit</button>&nbsp&nbsp"
+                                             "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button>"
+                                             "</div></form>";
+const char schema_xml_head[]       PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><config>";
+const char schema_xml_field[]      PROGMEM = "<%s>";
+const char schema_xml_field_end[]  PROGMEM = "</%s>";
+const char schema_xml_tail[]       PROGMEM = "</config>";
+const char schema_json_field[]     PROGMEM = "%s\"%s\":";
+#endif
+
+ConfigField ConfigSchema::field(int i) const {
+  ConfigField result;
+  memcpy_P(&result,&_fields[i],sizeof(ConfigField));
+  return result;
+}
+
+int ConfigSchema::indexOf(uint32_t hash) const {
+  for( int i=0; i<_numFields; i++ ) {if( field(i).hash == hash ) return i;}
+  return -1;
+}
+
+boolean ConfigSchema::valid(const ConfigField& f, long value) const {
+  if( f.type == CHAR_FIELD ) {
+    char choices[16];
+    strncpy_P(choices,f.choices,16);
+    choices[15] = '\0';
+    return (value > 0) && (strchr(choices,(char)value) != NULL);
+  }
+  return (value >= f.min) && (value <= f.max);
+}
+
+#ifdef ARDUINO
+/**
+ *  Names and labels are copied out of PROGMEM before formatting. Text values are shown as the placeholder, so an
+ *  untouched input submits empty and leaves the value unchanged.
+ */
+int ConfigSchema::formatField(char buffer[], int size, int pos, void* obj, int i) const {
+  ConfigField f = field(i);
+  long value = ((f.get != NULL)?(f.get(obj)):(0));
+  return formatField(buffer,size,pos,obj,i,value);
+}
+
+int ConfigSchema::formatField(char buffer[], int size, int pos, void* obj, int i, long value) const {
+  ConfigField f = field(i);
+  char name[24];
+  char label[48];
+  strncpy_P(name,f.name,24);
+  strncpy_P(label,f.label,48);
+  name[23]  = '\0';
+  label[47] = '\0';
+  if( f.type == TEXT_FIELD ) {
+    const char* text = ((f.getText!=NULL)?(f.getText(obj)):(""));
+    return formatBuffer_P(buffer,size,pos,field_text,name,label,name,name,f.max,text);
+  }
+  if( f.type == CHAR_FIELD ) {
+    char choices[16];
+    strncpy_P(choices,f.choices,16);
+    choices[15] = '\0';
+    return formatBuffer_P(buffer,size,pos,field_char,name,label,name,name,choices,(char)value);
+  }
+  if( f.type == OFFSET_FIELD ) {
+    char offset[8];
+    long m = ((value<0)?(-value):(value));
+    snprintf(offset,8,"%c%02ld:%02ld",((value<0)?('-'):('+')),m/60,m%60);
+    return formatBuffer_P(buffer,size,pos,field_offset,name,label,name,name,offset);
+  }
+  return formatBuffer_P(buffer,size,pos,field_number,name,label,name,name,f.min,f.max,value);
+}
+
+int ConfigSchema::formatFields(char buffer[], int size, int pos, void* obj) const {
+  for( int i=0; (i<_numFields) && (pos<size-1); i++ ) {
+    pos = formatField(buffer,size,pos,obj,i);
+    pos = formatBuffer_P(buffer,size,pos,field_break);
+  }
+  return pos;
+}
+
+int ConfigSchema::formatForm(char buffer[], int size, int pos, void* obj, const char* action, const char* cancel) const {
+  pos = formatFormHead(buffer,size,pos,action);
+  pos = formatFields(buffer,size,pos,obj);
+  pos = formatFormTail(buffer,size,pos,cancel);
+  return pos;
+}
+
+int ConfigSchema::formatFormHead(char buffer[], int size, int pos, const char* action) {return formatBuffer_P(buffer,size,pos,schema_form_head,action);}
+int ConfigSchema::formatFormTail(char buffer[], int size, int pos, const char* cancel) {return formatBuffer_P(buffer,size,pos,schema_form_tail,cancel);}
+
+/**
+ *  Text and character values are quoted and escaped in JSON, offsets are reported as decimal hours
+ */
+int ConfigSchema::formatValue(char buffer[], int size, int pos, void* obj, const ConfigField& f, boolean json) const {
+  if( f.type == TEXT_FIELD ) {
+    const char* text = ((f.getText!=NULL)?(f.getText(obj)):(""));
+    return ((json)?(formatJSONString(buffer,size,pos,text)):(formatBuffer_P(buffer,size,pos,PSTR("%s"),text)));
+  }
+  long value = ((f.get!=NULL)?(f.get(obj)):(0));
+  if( f.type == CHAR_FIELD ) {
+    char c[2] = {(char)value,'\0'};
+    return ((json)?(formatJSONString(buffer,size,pos,c)):(formatBuffer_P(buffer,size,pos,PSTR("%c"),c[0])));
+  }
+  if( f.type == OFFSET_FIELD ) return formatBuffer_P(buffer,size,pos,PSTR("%.2f"),value/60.0);
+  return formatBuffer_P(buffer,size,pos,PSTR("%ld"),value);
+}
+
+int ConfigSchema::formatXML(char buffer[], int size, int pos, void* obj) const {
+  char name[24];
+  pos = formatBuffer_P(buffer,size,pos,schema_xml_head);
+  for( int i=0; (i<_numFields) && (pos<size-1); i++ ) {
+    ConfigField f = field(i);
+    strncpy_P(name,f.name,24);
+    name[23] = '\0';
+    pos = formatBuffer_P(buffer,size,pos,schema_xml_field,name);
+    pos = formatValue(buffer,size,pos,obj,f,false);
+    pos = formatBuffer_P(buffer,size,pos,schema_xml_field_end,name);
+  }
+  return formatBuffer_P(buffer,size,pos,schema_xml_tail);
+}
+
+int ConfigSchema::formatJSON(char buffer[], int size, int pos, void* obj) const {
+  char name[24];
+  pos = formatBuffer_P(buffer,size,pos,PSTR("{"));
+  for( int i=0; (i<_numFields) && (pos<size-1); i++ ) {
+    ConfigField f = field(i);
+    strncpy_P(name,f.name,24);
+    name[23] = '\0';
+    pos = formatBuffer_P(buffer,size,pos,schema_json_field,((i>0)?(","):("")),name);
+    pos = formatValue(buffer,size,pos,obj,f,true);
+  }
+  return formatBuffer_P(buffer,size,pos,PSTR("}"));
+}
+
+void ConfigSchema::send(WebContext* svr, void* obj) const {
+  ContentFormat format = contentFormat(svr);
+  if( format == BINARY_FORMAT ) {
+    svr->send(406,"text/plain","Not Acceptable");
+    return;
+  }
+  char buffer[512];
+  if( format == JSON_FORMAT ) formatJSON(buffer,sizeof(buffer),0,obj);
+  else formatXML(buffer,sizeof(buffer),0,obj);
+  svr->send(200,contentType(format),buffer);
+}
+
+/**
+ *  A single pass over the arguments: each is matched to a field by name hash, validated, and set. Invalid values
+ *  are ignored, so one bad input does not discard the rest of the form, and a value equal to the current one is not
+ *  set or counted, so resubmitting a form changes nothing.
+ */
+int ConfigSchema::parse(WebContext* svr, void* obj, ArgFunction other) const {
+  QueryArgs args(svr);
+  int result = 0;
+  for( int i=0; i<args.count(); i++ ) {
+    ArgView a = args.arg(i);
+    if( indexOf(a.hash()) < 0 ) {
+      if( other != NULL ) other(a);
+    }
+    else if( parse(a,obj) ) result++;
+  }
+  return result;
+}
+#endif
+
+boolean ConfigSchema::parse(ArgView& a, void* obj) const {
+  int i = indexOf(a.hash());
+  if( (i < 0) || a.empty() ) return false;
+  ConfigField f = field(i);
+  if( f.type == TEXT_FIELD ) {
+    if( ((long)strlen(a.value()) > f.max) || (f.setText == NULL) ) return false;
+    if( (f.getText != NULL) && (strcmp(f.getText(obj),a.value()) == 0) ) return false;
+    f.setText(obj,a.value());
+    return true;
+  }
+  long value = 0;
+  int  h     = 0;
+  int  m     = 0;
+  if( f.type == CHAR_FIELD ) {
+    if( a.value()[1] != '\0' ) return false;
+    value = a.value()[0];
+  }
+  else if( f.type == OFFSET_FIELD ) {
+    if( !a.toOffset(h,m) ) return false;
+    value = 60L*h + m;
+  }
+  else if( !a.toInt(value) ) return false;
+  if( !valid(f,value) || (f.set == NULL) ) return false;
+  if( (f.get != NULL) && (f.get(obj) == value) ) return false;
+  f.set(obj,value);
+  return true;
+}
+
+uint32_t ConfigSchema::signature() const {
+  uint32_t result = ARG_HASH_SEED;
+  for( int i=0; i<_numFields; i++ ) {
+    ConfigField f = field(i);
+    result = (uint32_t)((result ^ f.hash)*ARG_HASH_PRIME);
+    result = (uint32_t)((result ^ (uint32_t)f.type)*ARG_HASH_PRIME);
+  }
+  return result;
+}
+
+int ConfigSchema::serialize(uint8_t buffer[], int size, void* obj) const {
+  int pos = 0;
+  if( size < 4 ) return 0;
+  uint32_t sig = signature();
+  for( int b=0; b<4; b++ ) buffer[pos++] = (uint8_t)(sig >> (8*b));
+  for( int i=0; i<_numFields; i++ ) {
+    ConfigField f = field(i);
+    if( f.type == TEXT_FIELD ) {
+      const char* text = ((f.getText!=NULL)?(f.getText(obj)):(""));
+      int len = strlen(text);
+      if( len > CONFIG_TEXT_SIZE-1 ) len = CONFIG_TEXT_SIZE-1;
+      if( pos + 1 + len > size ) return 0;
+      buffer[pos++] = (uint8_t)len;
+      memcpy(buffer+pos,text,len);
+      pos += len;
+    }
+    else {
+      if( pos + 4 > size ) return 0;
+      uint32_t value = (uint32_t)((f.get!=NULL)?(f.get(obj)):(0));
+      for( int b=0; b<4; b++ ) buffer[pos++] = (uint8_t)(value >> (8*b));
+    }
+  }
+  return pos;
+}
+
+/**
+ *  The image is checked end to end before any field is set; each value is then validated as if it had been submitted.
+ */
+int ConfigSchema::deserialize(const uint8_t* data, int len, void* obj) const {
+  if( (data == NULL) || (len < 4) ) return 0;
+  uint32_t sig = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+  if( sig != signature() ) return 0;
+  int pos = 4;
+  for( int i=0; i<_numFields; i++ ) {
+    if( field(i).type == TEXT_FIELD ) pos += ((pos<len)?(1 + data[pos]):(1));
+    else pos += 4;
+    if( pos > len ) return 0;
+  }
+  int result = pos;
+
+  pos = 4;
+  for( int i=0; i<_numFields; i++ ) {
+    ConfigField f = field(i);
+    if( f.type == TEXT_FIELD ) {
+      char text[CONFIG_TEXT_SIZE];
+      int  n = data[pos++];
+      if( n > CONFIG_TEXT_SIZE-1 ) n = CONFIG_TEXT_SIZE-1;
+      memcpy(text,data+pos,n);
+      text[n] = '\0';
+      pos += data[pos-1];
+      if( (n > 0) && (f.setText != NULL) ) f.setText(obj,text);
+    }
+    else {
+      long value = (long)(int32_t)(data[pos] | (data[pos+1] << 8) | (data[pos+2] << 16) | ((uint32_t)data[pos+3] << 24));
+      pos += 4;
+      if( valid(f,value) && (f.set != NULL) ) f.set(obj,value);
+    }
+  }
+  return result;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,174 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+/**
+ *   The field table, argument parsing and flash image only depend on the Arduino core, so they can also be compiled
+ *   on a host; forms and configuration documents need UPnPLib
+ */
+#ifdef ARDUINO
+#include <UPnPLib.h>
+#include "ContentFormat.h"
+#else
+#include <functional>
+#define PROGMEM
+#define PGM_P          const char*
+#define memcpy_P       memcpy
+#define strncpy_P      strncpy
+class WebContext;
+#endif
+#include "QueryArgs.h"
+
+/**
+ *   Longest TEXT_FIELD value kept by ConfigSchema::serialize()
+ */
+#define CONFIG_TEXT_SIZE     32
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef enum FieldType {
+  TEXT_FIELD,                             // String, such as the display name; an empty argument leaves it unchanged
+  INT_FIELD,                              // Integer in [min,max]
+  CHAR_FIELD,                             // One character of choices (case insensitive)
+  OFFSET_FIELD                            // Signed minutes in [min,max], entered as +/-hh:mm and reported as decimal hours
+} FieldType;
+
+typedef long        (*FieldGetter)(void* obj);
+typedef void        (*FieldSetter)(void* obj, long value);
+typedef const char* (*TextGetter)(void* obj);
+typedef void        (*TextSetter)(void* obj, const char* value);
+typedef std::function<void(ArgView&)> ArgFunction;
+
+/**
+ *   A field describes one configuration value: its argument/element name, form label, type, range and accessors.
+ *   Name, label and choices are PROGMEM strings; hash is argHash(name), computed by the compiler.
+ */
+typedef struct ConfigField {
+  PGM_P           name;
+  uint32_t        hash;
+  PGM_P           label;
+  FieldType       type;
+  long            min;
+  long            max;
+  PGM_P           choices;
+  FieldGetter     get;
+  FieldSetter     set;
+  TextGetter      getText;
+  TextSetter      setText;
+} ConfigField;
+
+/**
+ *   Field table entries. Accessors are captureless lambdas on the device class, so a table is a constant expression 
+ *   and can be placed in PROGMEM (requires -std=gnu++17, the default for ESP8266 and ESP32 cores):
+ *      const char Thermometer_unit[]   PROGMEM = "unit";
+ *      const char Thermometer_label[]  PROGMEM = "Thermometer Unit";
+ *      constexpr ConfigField Thermometer_fields[] PROGMEM = {
+ *        CONFIG_DISPLAY_NAME(Thermometer,sensor_name_label),
+ *        CONFIG_CHAR(Thermometer,Thermometer_unit,Thermometer_label,Thermometer_choices,unit(),setUnit(v))
+ *      };
+ *   get is an expression on the device, set a statement on the device using the (validated) value v.
+ */
+#define CONFIG_DISPLAY_NAME(cls,label)                  {config_displayName,argHash("displayName"),label,TEXT_FIELD,0,CONFIG_TEXT_SIZE-1,NULL,NULL,NULL, \
+                                                          [](void* o)->const char* {return ((cls*)o)->getDisplayName();},[](void* o, const char* v){((cls*)o)->setDisplayName(v);}}
+#define CONFIG_INT(cls,name,label,min,max,get,set)      {name,argHash(name),label,INT_FIELD,min,max,NULL, \
+                                                          [](void* o)->long {return ((cls*)o)->get;},[](void* o, long v){((cls*)o)->set;},NULL,NULL}
+#define CONFIG_CHAR(cls,name,label,choices,get,set)     {name,argHash(name),label,CHAR_FIELD,0,0,choices, \
+                                                          [](void* o)->long {return ((cls*)o)->get;},[](void* o, long v){((cls*)o)->set;},NULL,NULL}
+#define CONFIG_OFFSET(cls,name,label,min,max,get,set)   {name,argHash(name),label,OFFSET_FIELD,min,max,NULL, \
+                                                          [](void* o)->long {return ((cls*)o)->get;},[](void* o, long v){((cls*)o)->set;},NULL,NULL}
+
+extern const char config_displayName[];
+extern const char sensor_name_label[];
+extern const char control_name_label[];
+
+class ConfigSchema;
+extern const ConfigSchema displayName_schema;          // Display name only, for devices without a field table (obj is the UPnPObject)
+
+/** ConfigSchema is the generic configuration engine for a device's field table. From the one table it renders the
+ *  configuration form inputs, the getConfiguration XML or JSON document, parses and validates setConfiguration 
+ *  arguments in a single pass, and serializes the values to a compact binary image for flash. A device declares
+ *  its table and a schema in its .cpp, and its configuration handlers reduce to:
+ *      const ConfigSchema Thermometer_schema(Thermometer_fields,2);
+ *      if( Thermometer_schema.parse(svr,this) > 0 ) entityTag()->touchConfig();   // handleSetConfiguration
+ *      Thermometer_schema.send(svr,this);                  // handleGetConfiguration
+ *  Configuration that is not a flat list of values (OutletTimer intervals) is handled by the device, through the
+ *  ArgFunction passed to parse().
+ *
+ *  Serialized image (little-endian): signature u32, then per field a u32 (INT, CHAR, OFFSET) or a length byte and
+ *  that many characters (TEXT). signature() changes whenever field names or types do, so an image written by another
+ *  firmware layout is rejected by deserialize(). An image may be followed by other data; deserialize() returns its length.
+ */
+class ConfigSchema {
+  public:
+    constexpr ConfigSchema(const ConfigField* fields, int numFields) : _fields(fields), _numFields(numFields) {}
+
+    int              numFields() const                             {return _numFields;}
+    ConfigField      field(int i) const;                                                  // RAM copy of the PROGMEM field
+    int              indexOf(uint32_t hash) const;
+
+/**
+ *   Form inputs: formatField() writes the label and input for field i (value overrides the current value of a
+ *   numeric field); formatFields() writes every field each followed by a line break; formatForm() is the form head
+ *   (action path), the fields, and the Submit/Cancel buttons (cancel path). Devices that add content to the form
+ *   write the head, fields, and tail themselves.
+ */
+    int              formatField(char buffer[], int size, int pos, void* obj, int i) const;
+    int              formatField(char buffer[], int size, int pos, void* obj, int i, long value) const;
+    int              formatFields(char buffer[], int size, int pos, void* obj) const;
+    int              formatForm(char buffer[], int size, int pos, void* obj, const char* action, const char* cancel) const;
+    static int       formatFormHead(char buffer[], int size, int pos, const char* action);
+    static int       formatFormTail(char buffer[], int size, int pos, const char* cancel);
+
+/**
+ *   Configuration document, <config><name>value</name>...</config> or {"name":value,...}
+ */
+    int              formatXML(char buffer[], int size, int pos, void* obj) const;
+    int              formatJSON(char buffer[], int size, int pos, void* obj) const;
+    void             send(WebContext* svr, void* obj) const;                              // Negotiated XML or JSON, 406 for binary
+
+/**
+ *   Apply every valid argument of the request that names a field; arguments that do not name a field are passed
+ *   to other, if set. Returns the number of fields changed; parse(ArgView&) returns true if the field changed.
+ */
+    int              parse(WebContext* svr, void* obj, ArgFunction other = NULL) const;
+    boolean          parse(ArgView& a, void* obj) const;
+
+    uint32_t         signature() const;
+    int              serialize(uint8_t buffer[], int size, void* obj) const;              // Returns image length, 0 if it does not fit
+    int              deserialize(const uint8_t* data, int len, void* obj) const;      // Returns image length, 0 if it is not valid
+
+  private:
+    boolean          valid(const ConfigField& f, long value) const;
+    int              formatValue(char buffer[], int size, int pos, void* obj, const ConfigField& f, boolean json) const;
+
+    const ConfigField*   _fields;
+    int                  _numFields;
+};
+
+} // End of namespace lsc
+
+#endif
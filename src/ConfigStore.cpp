@@ -0,0 +1,217 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "ConfigStore.h"
+#include "ExtendedDevice.h"
+#include "SensorDevice.h"
+#include "Control.h"
+
+#define RECORD_MAGIC      0x4643         // "CF"
+#define RECORD_VERSION    1
+#define RECORD_HEADER     16             // Header bytes, see ConfigStore.h for the layout
+#define RECORD_CRC        12             // Offset of the CRC in the header
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+static void     put16(uint8_t* p, uint16_t v)  {p[0] = v; p[1] = v >> 8;}
+static void     put32(uint8_t* p, uint32_t v)  {put16(p,v); put16(p+2,v >> 16);}
+static uint16_t get16(const uint8_t* p)        {return p[0] | (p[1] << 8);}
+static uint32_t get32(const uint8_t* p)        {return get16(p) | ((uint32_t)get16(p+2) << 16);}
+
+ConfigStore::ConfigStore(const char* base, LogStorage* storage) : _base(base), _storage(storage) {
+  if( _storage == NULL ) _storage = FileStorage::defaultStorage();
+}
+
+void ConfigStore::path(int slot, char buffer[]) {snprintf(buffer,HISTORY_PATH_SIZE,"%s.%d",_base,slot);}
+
+/**
+ *  Read the header of slot, returns false if the file is missing or is not a record of this version
+ */
+boolean ConfigStore::readHeader(int slot, uint32_t& seq, uint32_t& len) {
+  char    p[HISTORY_PATH_SIZE];
+  uint8_t header[RECORD_HEADER];
+  path(slot,p);
+  if( _storage->read(p,0,header,RECORD_HEADER) != RECORD_HEADER ) return false;
+  if( (get16(header) != RECORD_MAGIC) || (header[2] != RECORD_VERSION) ) return false;
+  seq = get32(header+4);
+  len = get32(header+8);
+  return (len <= CONFIG_STORE_SIZE - RECORD_HEADER);
+}
+
+/**
+ *  The newest record is read whole and checked before anything is applied. The configuration generation is taken
+ *  afterwards, so restoring does not count as a change to write back.
+ */
+boolean ConfigStore::restore(ExtendedDevice* root) {
+  uint32_t seq[2];
+  uint32_t len[2];
+  boolean  valid[2];
+  for( int i=0; i<2; i++ ) valid[i] = readHeader(i,seq[i],len[i]);
+  int newest = ((valid[0] && (!valid[1] || ((int32_t)(seq[0] - seq[1]) > 0)))?(0):(1));
+
+  boolean result = false;
+  uint8_t record[CONFIG_STORE_SIZE];
+  for( int i=0; (i<2) && !result; i++ ) {
+    int slot = ((i==0)?(newest):(1-newest));
+    if( !valid[slot] ) continue;
+    char p[HISTORY_PATH_SIZE];
+    path(slot,p);
+    int total = RECORD_HEADER + len[slot];
+    if( _storage->read(p,0,record,total) != total ) continue;
+    uint32_t crc = HistoryLog::crc32(record+RECORD_HEADER,len[slot]);
+    if( HistoryLog::crc32(record+RECORD_HEADER,len[slot],HistoryLog::crc32(record,RECORD_CRC)) != get32(record+RECORD_CRC) ) continue;
+    apply(root,record+RECORD_HEADER,len[slot]);
+    _slot   = slot;
+    _seq    = seq[slot];
+    _crc    = crc;
+    result  = true;
+  }
+  _generation = generation(root);
+  _dirty      = false;
+  return result;
+}
+
+/**
+ *  Each entry is applied to the device with its target; entries that do not match a device are skipped
+ */
+void ConfigStore::apply(ExtendedDevice* root, const uint8_t* payload, int len) {
+  int pos = 0;
+  while( pos + 3 <= len ) {
+    int tlen = payload[pos];
+    if( pos + 1 + tlen + 2 > len ) break;
+    const char* target = (const char*)(payload+pos+1);
+    int dlen = get16(payload+pos+1+tlen);
+    const uint8_t* data = payload+pos+3+tlen;
+    pos += 3 + tlen + dlen;
+    if( pos > len ) break;
+    for( int i=0; i<=root->numDevices(); i++ ) {
+      UPnPDevice* d = ((i==0)?((UPnPDevice*)root):(root->device(i-1)));
+      if( (d != NULL) && (strlen(d->getTarget()) == (size_t)tlen) && (strncmp(d->getTarget(),target,tlen) == 0) ) {
+        restoreConfig(d,data,dlen);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ *  Build a record for the root and each embedded device, returns the record length or 0 if it does not fit
+ */
+int ConfigStore::format(ExtendedDevice* root, uint8_t record[], int size) {
+  int pos = RECORD_HEADER;
+  for( int i=0; i<=root->numDevices(); i++ ) {
+    UPnPDevice* d = ((i==0)?((UPnPDevice*)root):(root->device(i-1)));
+    if( d == NULL ) continue;
+    int tlen = strlen(d->getTarget());
+    if( (tlen > 255) || (pos + 3 + tlen > size) ) return 0;
+    int n = saveConfig(d,record+pos+3+tlen,size-pos-3-tlen);
+    if( n <= 0 ) continue;
+    record[pos] = tlen;
+    memcpy(record+pos+1,d->getTarget(),tlen);
+    put16(record+pos+1+tlen,n);
+    pos += 3 + tlen + n;
+  }
+  put16(record,RECORD_MAGIC);
+  record[2] = RECORD_VERSION;
+  record[3] = 0;
+  put32(record+4,_seq+1);
+  put32(record+8,pos-RECORD_HEADER);
+  return pos;
+}
+
+/**
+ *  The older slot is replaced so the newest valid record survives a torn write. A payload with the same CRC as the
+ *  newest record is not written again.
+ */
+boolean ConfigStore::save(ExtendedDevice* root) {
+  uint8_t record[CONFIG_STORE_SIZE];
+  int total = format(root,record,CONFIG_STORE_SIZE);
+  if( total == 0 ) return false;
+  uint32_t crc = HistoryLog::crc32(record+RECORD_HEADER,total-RECORD_HEADER);
+  if( (_slot >= 0) && (crc == _crc) ) return true;
+  put32(record+RECORD_CRC,HistoryLog::crc32(record+RECORD_HEADER,total-RECORD_HEADER,HistoryLog::crc32(record,RECORD_CRC)));
+
+  int  slot = ((_slot<0)?(0):(1-_slot));
+  char p[HISTORY_PATH_SIZE];
+  path(slot,p);
+  _storage->remove(p);
+  if( !_storage->append(p,record,total) ) return false;
+  _slot = slot;
+  _seq++;
+  _crc  = crc;
+  _writes++;
+  return true;
+}
+
+void ConfigStore::doDevice(ExtendedDevice* root) {
+  unsigned long now = millis();
+  if( (now - _lastPoll) < CONFIG_STORE_POLL ) return;
+  _lastPoll = now;
+  uint32_t g = generation(root);
+  if( g != _generation ) {
+    _generation = g;
+    _changed    = now;
+    _dirty      = true;
+  }
+  if( !_dirty || ((now - _changed) < CONFIG_STORE_DEBOUNCE) ) return;
+  if( (_lastWrite != 0) && ((now - _lastWrite) < CONFIG_STORE_INTERVAL) ) return;
+  _lastWrite = now;
+  if( save(root) ) _dirty = false;
+}
+
+/**
+ *  Sum of the configuration generations of the tree; any setConfiguration changes it
+ */
+uint32_t ConfigStore::generation(ExtendedDevice* root) {
+  uint32_t result = root->entityTag()->config();
+  for( int i=0; i<root->numDevices(); i++ ) {
+    UPnPDevice* d = root->device(i);
+    uint32_t    g = 0;
+    if( (d != NULL) && ExtendedDevice::configGeneration(d,g) ) result += g;
+  }
+  return result;
+}
+
+int ConfigStore::saveConfig(UPnPDevice* d, uint8_t buffer[], int size) {
+  Sensor*         s = (Sensor*)d->as(Sensor::classType());
+  Control*        c = (Control*)d->as(Control::classType());
+  ExtendedDevice* e = (ExtendedDevice*)d->as(ExtendedDevice::classType());
+  if( s != NULL ) return s->saveConfig(buffer,size);
+  if( c != NULL ) return c->saveConfig(buffer,size);
+  if( e != NULL ) return e->saveConfig(buffer,size);
+  return 0;
+}
+
+int ConfigStore::restoreConfig(UPnPDevice* d, const uint8_t* data, int len) {
+  Sensor*         s = (Sensor*)d->as(Sensor::classType());
+  Control*        c = (Control*)d->as(Control::classType());
+  ExtendedDevice* e = (ExtendedDevice*)d->as(ExtendedDevice::classType());
+  if( s != NULL ) return s->restoreConfig(data,len);
+  if( c != NULL ) return c->restoreConfig(data,len);
+  if( e != NULL ) return e->restoreConfig(data,len);
+  return 0;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,114 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <UPnPLib.h>
+#include "HistoryLog.h"
+
+/**
+ *   A record holds the configuration of the whole device tree and is built on the stack, so CONFIG_STORE_SIZE bounds
+ *   both the record and the stack used by a write. A change is written once configuration has been quiet for
+ *   CONFIG_STORE_DEBOUNCE ms, and at most once every CONFIG_STORE_INTERVAL ms, so a burst of form submissions or
+ *   mode toggles costs one flash write.
+ */
+#ifndef CONFIG_STORE_SIZE
+#define CONFIG_STORE_SIZE       1024
+#endif
+#ifndef CONFIG_STORE_DEBOUNCE
+#define CONFIG_STORE_DEBOUNCE   5000
+#endif
+#ifndef CONFIG_STORE_INTERVAL
+#define CONFIG_STORE_INTERVAL   60000
+#endif
+#define CONFIG_STORE_POLL       1000               // ms between checks of the configuration generation
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+class ExtendedDevice;
+
+/** ConfigStore keeps the configuration of an ExtendedDevice and its embedded devices in flash, keyed by device target.
+ *
+ *  Record layout (little-endian):
+ *      magic u16, version u8, flags u8, sequence u32, payload length u32, CRC32 u32 (over the header before it and
+ *      the payload), payload
+ *  The payload is one entry per device: target length u8, target, image length u16, image. Images are written by
+ *  saveConfig() and applied by restoreConfig() on Sensor, Control and ExtendedDevice (see ConfigSchema for the default).
+ *
+ *  Records are double-buffered in files <base>.0 and <base>.1: a write replaces the older file, so a write torn by
+ *  power loss leaves the previous record intact. restore() reads both headers, then the newest record in one read,
+ *  falling back to the other file if its CRC fails. Entries for targets that are no longer present, and images written
+ *  by another firmware layout, are skipped.
+ *
+ *  Changes are found by polling the configuration generation (EntityTag) of every device from doDevice(), so no
+ *  setter has to know about the store. A payload with the same CRC as the newest record is not written again.
+ *
+ *  Usage (LittleFS must be mounted by the sketch first):
+ *      ConfigStore store("/config");
+ *      root.configStore(&store);          // Restored in root.setup(), before handlers are registered
+ */
+class ConfigStore {
+  public:
+    ConfigStore(const char* base, LogStorage* storage = NULL);
+    virtual ~ConfigStore() {}
+
+    boolean          restore(ExtendedDevice* root);               // Apply the newest valid record, returns false if there is none
+    boolean          save(ExtendedDevice* root);                  // Write a record now (if configuration differs from the last one)
+    void             doDevice(ExtendedDevice* root);              // Write debounced configuration changes
+    uint32_t         sequence()                {return _seq;}     // Sequence number of the newest record
+    uint32_t         writes()                  {return _writes;}  // Records written since boot
+
+  protected:
+    void             path(int slot, char buffer[]);
+    boolean          readHeader(int slot, uint32_t& seq, uint32_t& len);
+    int              format(ExtendedDevice* root, uint8_t record[], int size);
+    void             apply(ExtendedDevice* root, const uint8_t* payload, int len);
+
+    static uint32_t  generation(ExtendedDevice* root);
+    static int       saveConfig(UPnPDevice* d, uint8_t buffer[], int size);
+    static int       restoreConfig(UPnPDevice* d, const uint8_t* data, int len);
+
+    const char*      _base;
+    LogStorage*      _storage;
+    int              _slot        = -1;                 // File holding the newest record, -1 if there is none
+    uint32_t         _seq         = 0;
+    uint32_t         _crc         = 0;                  // CRC of the newest record payload
+    uint32_t         _generation  = 0;                  // Configuration generation at the last poll
+    boolean          _dirty       = false;
+    unsigned long    _changed     = 0;                  // millis() of the last change
+    unsigned long    _lastWrite   = 0;
+    unsigned long    _lastPoll    = 0;
+    uint32_t         _writes      = 0;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(ConfigStore);
+};
+
+} // End of namespace lsc
+
+#endif
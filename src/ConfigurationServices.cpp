@@ -21,8 +21,11 @@
  */
 
 #include "ConfigurationServices.h"
+#include "HandlerMetrics.h"
+#include "PathTable.h"
 
 const char config_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><config><displayName>%s</displayName></config>";
+const char config_json[]      PROGMEM = "{\"displayName\":";
 const char config_form[]      PROGMEM = "<form action=\"%s\"><div align=\"center\">"
                                                    "<label for=\"displayName\">Control Name &nbsp &nbsp</label>"
                                                    "<input type=\"text\" placeholder=\"%s\" name=\"displayName\"><br><br>"
@@ -54,13 +57,12 @@ SetConfiguration::SetConfiguration(const char* target) : UPnPService(target) {
  *  Default handler takes DISPLAYNAME from the argument list and sets it on the parent UPnPDevice.
  */
 void SetConfiguration::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
+  QueryArgs args(svr);
   UPnPObject* p = getParent();
   UPnPDevice* d = ((p!=NULL)?(p->asDevice()):(NULL));
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
-     if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( (arg.length() > 0) && (p != NULL ) ) p->setDisplayName(arg.c_str());}
+  for( int i=0; i<args.count(); i++) {
+     ArgView a = args.arg(i);
+     if( a.hash() == argHash("DISPLAYNAME") ) {if( !a.empty() && (p != NULL ) ) p->setDisplayName(a.value());}
   }
   if( d != NULL ) d->display(svr);    
 }
@@ -98,7 +100,8 @@ void SetConfiguration::setup(WebContext* svr) {
    UPnPService::setup(svr);
    char pathBuffer[100];
    formPath(pathBuffer,100);
-   svr->on(pathBuffer,[this](WebContext* svr){this->_formHandler(svr);});  
+   const char* path = PathTable::shared()->intern(pathBuffer);
+   svr->on(path,HandlerMetrics::timed(path,[this](WebContext* svr){this->_formHandler(svr);}));  
 }
 
 void SetConfiguration::formPath(char buffer[], size_t bufferSize) {
@@ -120,9 +123,19 @@ void GetConfiguration::handleGetConfiguration(WebContext* svr) {
   char buffer[1000];
   size_t bufferSize = sizeof(buffer);
   int size = bufferSize;
-  if( p != NULL ) snprintf_P(buffer,size,config_template,p->getDisplayName());
-  else snprintf_P(buffer,size,config_template,getDisplayName());                     // Service should always have a parent so this should not happen
-  svr->send(200, "text/xml", buffer);
+  ContentFormat format = contentFormat(svr);
+  if( format == BINARY_FORMAT ) {
+    svr->send(406,"text/plain","Not Acceptable");
+    return;
+  }
+  const char* name = ((p != NULL)?(p->getDisplayName()):(getDisplayName()));         // Service should always have a parent so this should not happen
+  if( format == JSON_FORMAT ) {
+    int pos = formatBuffer_P(buffer,size,0,config_json);
+    pos = formatJSONString(buffer,size,pos,name);
+    formatBuffer_P(buffer,size,pos,PSTR("}"));
+  }
+  else snprintf_P(buffer,size,config_template,name);
+  svr->send(200, contentType(format), buffer);
 }
 
 } // End of namespace lsc
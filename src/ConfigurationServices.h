@@ -24,6 +24,8 @@
 #define CONFIGURATION_H
 
 #include <UPnPLib.h>
+#include "ContentFormat.h"
+#include "QueryArgs.h"
 #include <Timer.h>
 
 /** Leelanau Software Company namespace 
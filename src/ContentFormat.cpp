@@ -0,0 +1,129 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#include "ContentFormat.h"
+#include "HandlerMetrics.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+ContentFormat contentFormat(WebContext* svr) {
+  int numArgs = svr->argCount();
+  for( int i=0; i<numArgs; i++ ) {
+     if( svr->argName(i).equalsIgnoreCase("FORMAT") ) {
+        const String& arg = svr->arg(i);
+        if( arg.equalsIgnoreCase("JSON") ) return JSON_FORMAT;
+        if( arg.equalsIgnoreCase("BINARY") ) return BINARY_FORMAT;
+        return XML_FORMAT;
+     }
+  }
+  if( svr->hasHeader("Accept") ) {
+     const String& accept = svr->header("Accept");
+     if( accept.indexOf("application/json") >= 0 ) return JSON_FORMAT;
+     if( accept.indexOf("application/octet-stream") >= 0 ) return BINARY_FORMAT;
+  }
+  return XML_FORMAT;
+}
+
+const char* contentType(ContentFormat format) {
+  if( format == JSON_FORMAT ) return "application/json";
+  if( format == BINARY_FORMAT ) return "application/octet-stream";
+  return "text/xml";
+}
+
+void collectDeviceHeaders(WebContext* svr) {
+  const char* headers[] = {"Accept","CALLBACK","SID","TIMEOUT","NT","If-None-Match"};
+  svr->collectHeaders(headers,6);
+}
+
+int formatJSONString(char buffer[], int size, int pos, const char* s) {
+  if( pos >= size-1 ) return pos;
+  buffer[pos++] = '"';
+  for( ; *s != '\0'; s++ ) {
+    uint8_t c = *s;
+    int     n = (((c == '"') || (c == '\\'))?(2):((c < 0x20)?(6):(1)));
+    if( pos + n >= size-1 ) {
+      buffer[pos] = '\0';
+      return size;
+    }
+    if( n == 1 ) buffer[pos++] = c;
+    else if( n == 2 ) {
+      buffer[pos++] = '\\';
+      buffer[pos++] = c;
+    }
+    else pos += snprintf(buffer+pos,7,"\\u%04x",c);
+  }
+  buffer[pos++] = '"';
+  buffer[pos]   = '\0';
+  return pos;
+}
+
+int formatXMLString(char buffer[], int size, int pos, const char* s) {
+  if( pos >= size-1 ) return pos;
+  for( ; *s != '\0'; s++ ) {
+    const char* entity = NULL;
+    switch( *s ) {
+      case '&':  entity = "&amp;";  break;
+      case '<':  entity = "&lt;";   break;
+      case '>':  entity = "&gt;";   break;
+      case '"':  entity = "&quot;"; break;
+      case '\'': entity = "&apos;"; break;
+    }
+    int n = ((entity != NULL)?(strlen(entity)):(1));
+    if( pos + n >= size-1 ) {
+      buffer[pos] = '\0';
+      return size;
+    }
+    if( entity == NULL ) buffer[pos++] = *s;
+    else {
+      memcpy(buffer+pos,entity,n);
+      pos += n;
+    }
+  }
+  buffer[pos] = '\0';
+  return pos;
+}
+
+BinaryRecord::BinaryRecord(RecordType type) {
+  put8(BINARY_SCHEMA_VERSION);
+  put8(type);
+  put16(0);
+}
+
+/**
+ *  Fill in the payload length and send. The body is binary, so it is sent with an explicit content length rather
+ *  than as a C string.
+ */
+void BinaryRecord::send(WebContext* svr, int code) {
+  uint16_t payload = _len - BINARY_HEADER_SIZE;
+  _buffer[2] = payload & 0xFF;
+  _buffer[3] = payload >> 8;
+  svr->setContentLength(_len);
+  svr->send(code,contentType(BINARY_FORMAT),"");
+  svr->sendContent((const char*)_buffer,_len);
+  HandlerMetrics::shared()->sent(_len);
+}
+
+} // End of namespace lsc
@@ -0,0 +1,119 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#ifndef CONTENT_FORMAT_H
+#define CONTENT_FORMAT_H
+
+#include <UPnPLib.h>
+
+/**
+ *   Binary records start with a 4 byte header: schema version (u8), record type (u8), payload length (u16).
+ *   All fields are little-endian and fixed size, so a collector can overlay a packed struct on the response.
+ *   Version is incremented whenever a payload layout changes.
+ */
+#define BINARY_SCHEMA_VERSION  1
+#define BINARY_HEADER_SIZE     4
+#define BINARY_RECORD_SIZE     32
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef enum ContentFormat {
+  XML_FORMAT,
+  JSON_FORMAT,
+  BINARY_FORMAT
+} ContentFormat;
+
+/**
+ *   Binary payload layouts (after the header):
+ *     TEMPHUM_RECORD       := i16 temperature (0.01 C), u16 humidity (0.01 %), u32 sample age (ms)
+ *     DATETIME_RECORD      := u16 year, u8 month, u8 day, u8 hour, u8 minute, u8 second, u8 reserved, i16 timezone (minutes)
+ *     SOILMOISTURE_RECORD  := u16 soil moisture (0.01 %), u16 filtered reading, u16 dry reading, u16 wet reading
+ */
+typedef enum RecordType {
+  TEMPHUM_RECORD      = 1,
+  DATETIME_RECORD     = 2,
+  SOILMOISTURE_RECORD = 3
+} RecordType;
+
+/**
+ *   Response format requested by the client: the FORMAT argument (XML, JSON, or BINARY) if present, otherwise the
+ *   Accept header (application/json or application/octet-stream), otherwise XML. The Accept header is only visible
+ *   if the server collects it, see collectDeviceHeaders().
+ */
+ContentFormat  contentFormat(WebContext* svr);
+const char*    contentType(ContentFormat format);
+
+/**
+ *   The web server only keeps request headers it was told to collect, and each call replaces the previous list, so
+ *   every header used by the library is collected here. Called from ExtendedDevice::setup() and EventService::setup();
+ *   a sketch using a plain RootDevice should call it after setup.
+ */
+void           collectDeviceHeaders(WebContext* svr);
+
+/**
+ *   Append s as a quoted JSON string, escaping '"', '\\' and control characters. User text (display names) must go
+ *   through this rather than a "%s" template. Like formatBuffer_P(), returns a position of at least size-1 when
+ *   the string does not fit.
+ */
+int            formatJSONString(char buffer[], int size, int pos, const char* s);
+
+/**
+ *   Append s as XML text or the value of a quoted attribute (quotes not included), escaping '&', '<', '>', '"' and
+ *   '\'' as entities. Returns a position of at least size-1 when the string does not fit.
+ */
+int            formatXMLString(char buffer[], int size, int pos, const char* s);
+
+/**
+ *   Fixed size, little-endian binary record
+ *   Usage:
+ *      BinaryRecord r(TEMPHUM_RECORD);
+ *      r.put16(...);
+ *      r.send(svr);
+ */
+class BinaryRecord {
+  public:
+    BinaryRecord(RecordType type);
+    virtual ~BinaryRecord() {}
+
+    void           put8(uint8_t v)           {if( _len < BINARY_RECORD_SIZE ) _buffer[_len++] = v;}
+    void           put16(uint16_t v)         {put8(v & 0xFF); put8(v >> 8);}
+    void           put32(uint32_t v)         {put16(v & 0xFFFF); put16(v >> 16);}
+    void           send(WebContext* svr, int code = 200);
+    int            length()                  {return _len;}
+
+  private:
+    uint8_t        _buffer[BINARY_RECORD_SIZE];
+    int            _len = 0;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(BinaryRecord);
+};
+
+} // End of namespace lsc
+
+#endif
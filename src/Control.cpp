@@ -23,6 +23,10 @@
 #include "Control.h"
 
 namespace lsc {
+
+const char inline_head[]   PROGMEM = "<div class=\"control\" id=\"%s\" data-base=\"%s/\">";
+const char inline_tail[]   PROGMEM = "</div>";
+
 /**
  *  Static initialization for RTT and UPnP device type
  */
@@ -31,17 +35,17 @@ INITIALIZE_DEVICE_TYPES(Control,LeelanauSoftware-com,Control,1.0.0);
 Control::Control() : UPnPDevice("control") {
   addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services for configuration
   setDisplayName("Control");
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
 }
 
 Control::Control(const char* target) : UPnPDevice(target) {
   addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services for configuration
   setDisplayName("Control");
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
 }
 
 /**
@@ -49,55 +53,111 @@ Control::Control(const char* target) : UPnPDevice(target) {
  */
 int Control::formatRootContent(char buffer[], int size, int pos) {
   pos = formatBuffer_P(buffer,size,pos,html_L3_title,getDisplayName());
-  char pathBuff[100];
-  contentPath(pathBuff,100);
-  pos = formatBuffer_P(buffer,size,pos,iframe_html,pathBuff,frameHeight(),frameWidth());
+  pos = formatBuffer_P(buffer,size,pos,iframe_html,_contentPath,frameHeight(),frameWidth());
   return pos;     
 }
+/**
+ *  Inline root content is the miniture (L3) title and formatContent() inside a fragment named for the device target. 
+ *  Content links are written relative to displayControl ("./setState..."), so they are rebased on the device path to 
+ *  resolve the same way from the root page.
+ */
+int Control::formatInlineContent(char buffer[], int size, int pos) {
+  pos = formatBuffer_P(buffer,size,pos,html_L3_title,getDisplayName());
+  pos = formatBuffer_P(buffer,size,pos,inline_head,getTarget(),_paths.device);
+  int start = pos;
+  pos = formatContent(buffer,size,pos);
+  if( pos >= size-1 ) return pos;
+  pos = rebase(buffer,size,start,pos,_paths.device);
+  if( pos >= size-1 ) return pos;
+  pos = formatBuffer_P(buffer,size,pos,inline_tail);
+  return pos;
+}
+
+/**
+ *  Replace the '.' of every "./ in buffer[start,pos) with base, working back from the end so the buffer is only 
+ *  traversed once. Returns the new write position, or size if the result does not fit.
+ */
+int Control::rebase(char buffer[], int size, int start, int pos, const char* base) {
+  int len = strlen(base);
+  int n   = 0;
+  for( int i=start+1; i<pos-1; i++ ) {if( (buffer[i] == '.') && (buffer[i-1] == '"') && (buffer[i+1] == '/') ) n++;}
+  if( n == 0 ) return pos;
+  int end = pos + n*(len-1);
+  if( end >= size-1 ) return size;
+
+  buffer[end] = '\0';
+  int  dst  = end;
+  char next = '\0';                                        // Character following src, before it could be overwritten
+  for( int src=pos-1; src>=start; src-- ) {
+    char c = buffer[src];
+    if( (c == '.') && (next == '/') && (src > start) && (buffer[src-1] == '"') ) {
+      dst -= len;
+      memcpy(buffer+dst,base,len);
+    }
+    else buffer[--dst] = c;
+    next = c;
+  }
+  return end;
+}
+
 /**
  *  Display iFrame with title decoration
  */
+/**
+ *  Configuration generation only changes if a display name was applied
+ */
+void Control::handleSetConfiguration(WebContext* svr) {
+  if( displayName_schema.parse(svr,(UPnPObject*)this) > 0 ) entityTag()->touchConfig();
+  display(svr);
+}
+
 void Control::display(WebContext* svr) {
-  char buffer[500];
-  int size = sizeof(buffer);
-  int pos = formatHeader(buffer,size,getDisplayName());
-  char pathBuff[100];
-  contentPath(pathBuff,100);
+  HandlerScope scope(this);
+  if( _entityTag.notModified(svr,'d') ) return;
+  ChunkedWriter w(svr);
+  w.header(getDisplayName());
   
 /**
  *   iFrame display takes url, height, and width as arguments
  */
-  pos = formatBuffer_P(buffer,size,pos,iframe_html,pathBuff,frameHeight(),frameWidth());
+  w.printf_P(iframe_html,_contentPath,frameHeight(),frameWidth());
 
 /** 
  *  Add a Config Button to the Control display
  */
-  setConfigurationSvc()->formPath(pathBuff,100);
-  pos = formatBuffer_P(buffer,size,pos,config_button,pathBuff,"Configure"); 
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.printf_P(config_button,_paths.form,"Configure"); 
+  w.tail();
 }
 
 /**
  *   Display iFrame content only, no title decoration
  */
 void Control::displayControl(WebContext* svr) {
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
-  int pos = 0;
-  pos = formatBuffer_P(buffer,size,pos,html_header);
-  pos = formatContent(buffer,size,pos);
-  pos = formatTail(buffer,size-pos,pos); 
-  svr->send(200,"text/html",buffer);
+  ChunkedWriter w(svr);
+  w.printf_P(html_header);
+  w.content(this);
+  if( controlScript() != NULL ) w.printf_P(controlScript());
+  w.tail(); 
 }
 
 void Control::setup(WebContext* svr) {
   UPnPDevice::setup(svr);
-  char pathBuff[100];
-  contentPath(pathBuff,100);
-  svr->on(pathBuff,[this](WebContext* svr){this->displayControl(svr);});
+  PathTable::shared()->paths(_paths,this,setConfigurationSvc());
+  _contentPath = PathTable::shared()->handlerPath(this,"displayControl");
+  FragmentCache::shared()->invalidate(this);
+  svr->on(_contentPath,HandlerMetrics::timed(_contentPath,[this](WebContext* svr){if( !this->entityTag()->notModified(svr,'c',this->stateGeneration()) ) this->displayControl(svr);}));
 }
 
 void Control::contentPath(char buffer[], size_t size) {handlerPath(buffer,size,"displayControl");}
 
+int Control::saveConfig(uint8_t buffer[], int size) {
+  const ConfigSchema* schema = configSchema();
+  return ((schema != NULL)?(schema->serialize(buffer,size,this)):(displayName_schema.serialize(buffer,size,(UPnPObject*)this)));
+}
+
+int Control::restoreConfig(const uint8_t* data, int len) {
+  const ConfigSchema* schema = configSchema();
+  return ((schema != NULL)?(schema->deserialize(data,len,this)):(displayName_schema.deserialize(data,len,(UPnPObject*)this)));
+}
+
 } // End of namespace lsc
@@ -25,6 +25,14 @@
 
 #include <UPnPLib.h>
 #include "ConfigurationServices.h"
+#include "ChunkedWriter.h"
+#include "EntityTag.h"
+#include "FragmentCache.h"
+#include "PathTable.h"
+#include "ConfigSchema.h"
+#include "HandlerMetrics.h"
+#include "LoopProfiler.h"
+#include "TraceBuffer.h"
 
 /** Leelanau Software Company namespace 
 *  
@@ -47,6 +55,7 @@ namespace lsc {
  *     1. formatContent should provide content for device display from the device target, and can be more complex than content displayed from the RootDevice
  *     2. formatIFrameContent should provide content for device display from the root target, can be simpler than display content from the display target
  *     3. formatRootContent inserts an iFrame into the RootDevice display buffer, target of the iFrame ultimately calls formatIFrameContent
+ *     4. formatInlineContent is used instead of formatRootContent on a composite root page (see ExtendedDevice::inlineControls())
  */
 class Control : public UPnPDevice  {
     public:
@@ -59,6 +68,11 @@ class Control : public UPnPDevice  {
 *   at setup()
 */
       void               contentPath(char buffer[], size_t size);
+      const char*        contentPath()                             {return _contentPath;}               // Interned at setup()
+      const DevicePaths& paths()                                   {return _paths;}                     // Interned at setup(), see PathTable
+      virtual const ConfigSchema* configSchema()                   {return NULL;}                       // Field table of the configuration, if any
+      virtual int        saveConfig(uint8_t buffer[], int size);                                        // Configuration image for ConfigStore, see Sensor
+      virtual int        restoreConfig(const uint8_t* data, int len);
 
 /** 
  *  Controls should implement the following methods for display of their Sensor reading:
@@ -88,12 +102,14 @@ class Control : public UPnPDevice  {
  *                                                Control's constructor.
  */
       int                formatRootContent(char buffer[], int size, int pos);       // Inserts iFrame into RootDeviceDisplay
+      int                formatInlineContent(char buffer[], int size, int pos);     // Inserts formatContent() into RootDeviceDisplay
+      virtual PGM_P      controlScript()    {return NULL;}                          // PROGMEM script appended once to a page showing this Control
       virtual int        frameHeight()      {return 75;}
       virtual int        frameWidth()       {return 300;}
       
       SetConfiguration*  setConfigurationSvc()                     {return &_setConfiguration;}                        // Return setConfigutation Service
       GetConfiguration*  getConfigurationSvc()                     {return &_getConfiguration;}                        // Return getConfigutation Service
-      virtual void       handleSetConfiguration(WebContext* svr)   {_setConfiguration.handleSetConfiguration(svr);}    // Default form (submit) handler for set configuration
+      virtual void       handleSetConfiguration(WebContext* svr);                                                      // Default form (submit) handler sets the display name
       virtual void       handleGetConfiguration(WebContext* svr)   {_getConfiguration.handleGetConfiguration(svr);}    // Default HTTP handler for get configuration
       virtual void       configForm(WebContext* svr)               {_setConfiguration.configForm(svr);}                // Default form display for set configuration
       void               setup(WebContext* svr);
@@ -105,6 +121,15 @@ class Control : public UPnPDevice  {
       virtual void       displayControl(WebContext* svr);
       void               display(WebContext* svr);
 
+/**
+ *   Generation counters for conditional requests: display(), the displayControl endpoint, and getConfiguration answer 
+ *   304 when the client already has the current version. Configuration generation is bumped by handleSetConfiguration()
+ *   when it applies a field; Controls bump entityTag()->touchState() (or override stateGeneration()) when their 
+ *   displayed state changes.
+ */
+      EntityTag*         entityTag()                               {return &_entityTag;}
+      virtual uint32_t   stateGeneration()                         {return _entityTag.state();}
+
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
  *     private: static const ClassType  _classType;             
@@ -124,9 +149,15 @@ class Control : public UPnPDevice  {
  */
      DEFINE_EXCLUSIONS(Control);         
 
+      protected:
+      static int         rebase(char buffer[], int size, int start, int pos, const char* base);
+
       private:
       GetConfiguration     _getConfiguration;
       SetConfiguration     _setConfiguration;
+      EntityTag            _entityTag;
+      DevicePaths          _paths;
+      const char*          _contentPath = "";
 };
 
 } // End of namespace lsc
@@ -35,6 +35,23 @@
 #include "RelayControl.h"
 #include "Hydrometer.h"
 #include "ExtendedDevice.h"
+#include "ChunkedWriter.h"
+#include "DiscoveryCache.h"
+#include "DiscoveryTable.h"
+#include "SensorHistory.h"
+#include "HistoryLog.h"
+#include "WeeklySchedule.h"
+#include "EventServices.h"
+#include "ContentFormat.h"
+#include "EntityTag.h"
+#include "FragmentCache.h"
+#include "PathTable.h"
+#include "QueryArgs.h"
+#include "ConfigSchema.h"
+#include "ConfigStore.h"
+#include "HandlerMetrics.h"
+#include "LoopProfiler.h"
+#include "TraceBuffer.h"
 
 using namespace lsc;
 
@@ -0,0 +1,166 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "DiscoveryCache.h"
+#include <UPnPBuffer.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char Discovery_Search[]         PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                                "HOST: 239.255.255.250:1900\r\n"
+                                                "MAN: \"ssdp:discover\"\r\n"
+                                                "MX: 2\r\n"
+                                                "ST: upnp:rootdevice\r\n"
+                                                "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                                "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+const char Discovery_Stats[]          PROGMEM = "<discovery size=\"%d\" peak=\"%u\" searches=\"%lu\" replies=\"%lu\" duplicates=\"%lu\" notifies=\"%lu\" "
+                                                "rejected=\"%lu\" truncated=\"%lu\" evictions=\"%lu\" searchReplies=\"%u\" firstReply=\"%lu\" lastReply=\"%lu\"/>";
+
+#define SSDP_BUFFER_SIZE      1000
+
+DiscoveryCache::DiscoveryCache() {
+  refresh(DISCOVERY_REFRESH);
+  _timer.setHandler([this]{this->timerCallback();});
+}
+
+/**
+ *  The UDP sockets can only be opened once there is a network interface. In background mode begin() is retried from
+ *  doDevice() and sends the first search; on demand it is called by search().
+ */
+boolean DiscoveryCache::begin() {
+  if( !_started && ((uint32_t)WiFi.localIP() != 0) ) {
+    _started = (_udp.begin(DISCOVERY_PORT) == 1);
+    if( _started && isBackground() ) {
+#ifdef ESP8266
+      if( _passive ) _notify.beginMulticast(WiFi.localIP(),IPAddress(239,255,255,250),1900);
+#else
+      if( _passive ) _notify.beginMulticast(IPAddress(239,255,255,250),1900);
+#endif
+      search();
+      _timer.start();
+    }
+  }
+  return _started;
+}
+
+/**
+ *  Close the reply socket of an on demand search
+ */
+void DiscoveryCache::end() {
+  _udp.stop();
+  _started = false;
+}
+
+void DiscoveryCache::search() {
+  if( !_started && (isBackground() || !begin()) ) return;
+  char msg[sizeof(Discovery_Search)];
+  strncpy_P(msg,Discovery_Search,sizeof(msg));
+  _udp.beginPacket(IPAddress(239,255,255,250),1900);
+  _udp.write((const uint8_t*)msg,strlen(msg));
+  _udp.endPacket();
+  _needSearch = false;
+  _table.searched(millis());
+}
+
+/**
+ *  The cache needs a search if it was last searched more than refresh() seconds ago, or DISCOVERY_MIN_SEARCH seconds
+ *  ago if it is empty. Expired entries are dropped first.
+ */
+boolean DiscoveryCache::isStale() {
+  _table.expire(millis());
+  unsigned long interval = ((isEmpty())?(DISCOVERY_MIN_SEARCH*1000UL):((unsigned long)_timer.setPointMillis()));
+  return (stats().searches == 0) || ((millis() - _table.lastSearch()) > interval);
+}
+
+void DiscoveryCache::doDevice() {
+  if( !isBackground() ) {
+    if( !_started ) return;
+    readReplies();
+    if( (millis() - _table.lastSearch()) > DISCOVERY_REPLY_WINDOW ) end();
+    return;
+  }
+  if( !begin() ) return;
+  _timer.doDevice();
+  readReplies();
+  if( _passive ) {
+    readNotify();
+    if( _needSearch && ((millis() - _table.lastSearch()) > DISCOVERY_MIN_SEARCH*1000UL) ) search();
+  }
+}
+
+/**
+ *  Read at most DISCOVERY_MAX_PACKETS search replies so a burst of replies is spread across loop iterations. Parsing
+ *  is done by the table; only the display name header, defined by UPnPLib, is read here.
+ */
+void DiscoveryCache::readReplies() {
+  for( int n=0; (n<DISCOVERY_MAX_PACKETS) && (_udp.parsePacket() > 0); n++ ) {
+    char buffer[SSDP_BUFFER_SIZE];
+    int len = _udp.read(buffer,SSDP_BUFFER_SIZE-1);
+    if( len <= 0 ) continue;
+    if( len == SSDP_BUFFER_SIZE-1 ) _table.stats().truncated++;
+    buffer[len] = '\0';
+
+    UPnPBuffer b(buffer);
+    char name[DISCOVERY_NAME_SIZE];
+    _table.reply(buffer,(b.displayName(name,DISCOVERY_NAME_SIZE)?(name):(NULL)),millis());
+  }
+}
+
+/**
+ *  Track NOTIFY announcements (see DiscoveryTable::notify()); an alive from an unknown device without a display
+ *  name requests a search to learn the name.
+ */
+void DiscoveryCache::readNotify() {
+  for( int n=0; (n<DISCOVERY_MAX_PACKETS) && (_notify.parsePacket() > 0); n++ ) {
+    char buffer[SSDP_BUFFER_SIZE];
+    int len = _notify.read(buffer,SSDP_BUFFER_SIZE-1);
+    if( len <= 0 ) continue;
+    if( len == SSDP_BUFFER_SIZE-1 ) _table.stats().truncated++;
+    buffer[len] = '\0';
+
+    UPnPBuffer b(buffer);
+    char name[DISCOVERY_NAME_SIZE];
+    if( _table.notify(buffer,(b.displayName(name,DISCOVERY_NAME_SIZE)?(name):(NULL)),millis()) ) _needSearch = true;
+  }
+}
+
+int DiscoveryCache::formatStats(char buffer[], int size, int pos) {
+  const DiscoveryStats& s = stats();
+  return formatBuffer_P(buffer,size,pos,Discovery_Stats,_table.size(),s.peak,(unsigned long)s.searches,(unsigned long)s.replies,
+                        (unsigned long)s.duplicates,(unsigned long)s.notifies,(unsigned long)s.rejected,
+                        (unsigned long)s.truncated,(unsigned long)s.evictions,s.searchReplies,s.firstReply,s.lastReply);
+}
+
+/**
+ *  Background mode only. In passive mode announcements keep the cache current, so only search when it is cold.
+ */
+void DiscoveryCache::timerCallback() {
+  _table.expire(millis());
+  if( !_passive || isEmpty() ) search();
+  _timer.reset();
+  _timer.start();
+}
+
+} // End of namespace lsc
@@ -0,0 +1,117 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef DISCOVERY_CACHE_H
+#define DISCOVERY_CACHE_H
+
+#include <WiFiUdp.h>
+#include <UPnPLib.h>
+#include <Timer.h>
+#include "DiscoveryTable.h"
+
+/**
+ *   Search refresh interval (in seconds), local port for search replies, and how long (in ms) the reply socket of an
+ *   on demand search stays open (MX plus margin)
+ */
+#define DISCOVERY_REFRESH        60
+#define DISCOVERY_PORT           1901
+#define DISCOVERY_REPLY_WINDOW   4000
+
+/**
+ *   Minimum interval (in seconds) between searches triggered by passive listening
+ */
+#define DISCOVERY_MIN_SEARCH     10
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/** DiscoveryCache keeps a table of RootDevices on the local network without blocking the loop. An SSDP M-SEARCH
+ *  for upnp:rootdevice is multicast and replies are read, a few at a time, from doDevice(). HTTP handlers render
+ *  from the cache and never wait on the network.
+ *  Entries are kept in a DiscoveryTable and expire by the CACHE-CONTROL max-age of the reply. When the cache is full
+ *  the least recently seen entry is replaced.
+ *
+ *  By default searches are on demand: a handler calls search() when isStale(), the reply socket is opened for the
+ *  search and closed again DISCOVERY_REPLY_WINDOW ms later, so an idle device sends no multicast traffic and holds
+ *  no socket. In background mode (HubDevice) the socket stays open and an M-SEARCH is sent every refresh() seconds.
+ *
+ *  In passive mode, which implies background mode, the cache also joins the SSDP multicast group and tracks ssdp:alive and ssdp:byebye NOTIFY
+ *  announcements for upnp:rootdevice, so multicast traffic follows device churn rather than page views. An active
+ *  M-SEARCH is only sent when the cache is cold (empty), or when an announcement arrives from a device whose display 
+ *  name is not yet known. Note that the SSDP server on the same device also listens on port 1900, so the network 
+ *  stack must allow the port to be shared (SO_REUSE).
+ *  Usage:
+ *     DiscoveryCache   _discovery;
+ *     void doDevice()  {_discovery.doDevice();}
+ *     for( int i=0; i<_discovery.size(); i++ ) {const DiscoveryEntry* e = _discovery.entry(i); ...}
+ */
+class DiscoveryCache {
+  public:
+    DiscoveryCache();
+    virtual ~DiscoveryCache() {}
+
+    void                   doDevice();                                      // Read pending replies and run the refresh Timer
+    void                   search();                                        // Send an M-SEARCH now, replies arrive through doDevice()
+    boolean                isStale();                                       // Not searched within refresh() seconds
+
+    int                    refresh()                 {return _timer.setPointMillis()/1000;}
+    void                   refresh(int secs)         {if( secs > 0 ) _timer.set(secs*1000);}
+
+    int                    size()                    {return _table.size();}
+    const DiscoveryEntry*  entry(int i)              {return _table.entry(i);}
+    boolean                isEmpty()                 {return _table.isEmpty();}
+
+    void                   background(boolean flag)  {_background = flag;}                // Search every refresh() seconds, must be set prior to doDevice()
+    boolean                isBackground()            {return _background || _passive;}
+    void                   passive(boolean flag)     {_passive = flag;}                   // Track NOTIFY announcements, must be set prior to doDevice()
+    boolean                isPassive()               {return _passive;}
+
+    const DiscoveryStats&  stats()                   {return _table.stats();}
+    int                    formatStats(char buffer[], int size, int pos);                 // <discovery .../> element for a snapshot
+
+  protected:
+    boolean                begin();
+    void                   end();
+    void                   readReplies();
+    void                   readNotify();
+    void                   timerCallback();
+
+    WiFiUDP                _udp;
+    WiFiUDP                _notify;
+    Timer                  _timer;
+    boolean                _started    = false;
+    boolean                _background = false;
+    boolean                _passive    = false;
+    boolean                _needSearch = false;
+    DiscoveryTable         _table;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(DiscoveryCache);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,204 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "DiscoveryTable.h"
+#include <stdlib.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char Discovery_Reply[]          PROGMEM = "HTTP/1.1 200";
+const char Discovery_Location[]       PROGMEM = "LOCATION";
+const char Discovery_USN[]            PROGMEM = "USN";
+const char Discovery_Notify[]         PROGMEM = "NOTIFY";
+const char Discovery_NT[]             PROGMEM = "NT";
+const char Discovery_NTS[]            PROGMEM = "NTS";
+const char Discovery_CacheControl[]   PROGMEM = "CACHE-CONTROL";
+const char Discovery_RootDevice[]     PROGMEM = "upnp:rootdevice";
+const char Discovery_Alive[]          PROGMEM = "ssdp:alive";
+const char Discovery_Byebye[]         PROGMEM = "ssdp:byebye";
+
+void DiscoveryTable::searched(unsigned long now) {
+  _lastSearch = now;
+  _stats.searches++;
+  _stats.searchReplies = 0;
+  _stats.firstReply    = 0;
+  _stats.lastReply     = 0;
+}
+
+/**
+ *  A search reply needs a display name and USN; LOCATION defaults to "/"
+ */
+boolean DiscoveryTable::reply(const char* packet, const char* name, unsigned long now) {
+  char usn[DISCOVERY_USN_SIZE];
+  char loc[DISCOVERY_LOCATION_SIZE];
+  if( (strncmp_P(packet,Discovery_Reply,strlen_P(Discovery_Reply)) != 0) || (name == NULL) || !headerValue(packet,Discovery_USN,usn,DISCOVERY_USN_SIZE) ) {
+    _stats.rejected++;
+    return false;
+  }
+  if( !headerValue(packet,Discovery_Location,loc,DISCOVERY_LOCATION_SIZE) ) strcpy(loc,"/");
+  replied(usn,now);
+  update(usn,loc,name,maxAge(packet),now);
+  return true;
+}
+
+/**
+ *  Track NOTIFY announcements for upnp:rootdevice. ssdp:byebye removes the entry, ssdp:alive refreshes it. An 
+ *  alive from an unknown device without a display name is recorded under its LOCATION, and true is returned so
+ *  the cache searches to learn the name.
+ */
+boolean DiscoveryTable::notify(const char* packet, const char* name, unsigned long now) {
+  char nt[32];
+  char nts[16];
+  char usn[DISCOVERY_USN_SIZE];
+  if( strncmp_P(packet,Discovery_Notify,strlen_P(Discovery_Notify)) != 0 ) return false;
+  if( !headerValue(packet,Discovery_NT,nt,32) || (strcmp_P(nt,Discovery_RootDevice) != 0) ) return false;
+  if( !headerValue(packet,Discovery_NTS,nts,16) ) return false;
+  if( !headerValue(packet,Discovery_USN,usn,DISCOVERY_USN_SIZE) ) {_stats.rejected++; return false;}
+
+  _stats.notifies++;
+  if( strcmp_P(nts,Discovery_Byebye) == 0 ) remove(indexOf(usn));
+  else if( strcmp_P(nts,Discovery_Alive) == 0 ) {
+    char loc[DISCOVERY_LOCATION_SIZE];
+    if( !headerValue(packet,Discovery_Location,loc,DISCOVERY_LOCATION_SIZE) ) strcpy(loc,"/");
+    if( name != NULL ) update(usn,loc,name,maxAge(packet),now);
+    else {
+      int i = indexOf(usn);
+      if( i >= 0 ) update(usn,loc,_entries[i].name,maxAge(packet),now);
+      else {
+        update(usn,loc,loc,maxAge(packet),now);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ *  Headers start a line after the start line, as NAME: value, with optional white space around the value
+ */
+boolean DiscoveryTable::headerValue(const char* packet, PGM_P name, char value[], int size) {
+  int len = strlen_P(name);
+  for( const char* p=strchr(packet,'\n'); p != NULL; p=strchr(p,'\n') ) {
+    p++;
+    if( (strncasecmp_P(p,name,len) != 0) || (p[len] != ':') ) continue;
+    const char* v = p + len + 1;
+    while( (*v == ' ') || (*v == '\t') ) v++;
+    int n = 0;
+    while( (v[n] != '\0') && (v[n] != '\r') && (v[n] != '\n') ) n++;
+    while( (n > 0) && ((v[n-1] == ' ') || (v[n-1] == '\t')) ) n--;
+    if( n > size-1 ) n = size-1;
+    memcpy(value,v,n);
+    value[n] = '\0';
+    return true;
+  }
+  return false;
+}
+
+/**
+ *  CACHE-CONTROL: max-age=seconds, returned in milliseconds
+ */
+unsigned long DiscoveryTable::maxAge(const char* packet) {
+  unsigned long result = DISCOVERY_MAX_AGE;
+  char value[32];
+  if( headerValue(packet,Discovery_CacheControl,value,32) ) {
+    const char* p = strstr(value,"max-age");
+    if( p != NULL ) {
+      p = strchr(p,'=');
+      if( p != NULL ) {
+        long secs = atol(p+1);
+        if( secs > 0 ) result = secs;
+      }
+    }
+  }
+  return result*1000UL;
+}
+
+/**
+ *  A device that was already seen since the search was sent is a duplicate (SSDP replies are UDP and commonly
+ *  repeated)
+ */
+void DiscoveryTable::replied(const char* usn, unsigned long now) {
+  unsigned long elapsed = now - _lastSearch;
+  int i = indexOf(usn);
+  if( (i >= 0) && ((_entries[i].lastSeen - _lastSearch) <= elapsed) ) {
+    _stats.duplicates++;
+    return;
+  }
+  _stats.replies++;
+  _stats.searchReplies++;
+  if( _stats.searchReplies == 1 ) _stats.firstReply = elapsed;
+  _stats.lastReply = elapsed;
+}
+
+int DiscoveryTable::indexOf(const char* usn) {
+  for( int i=0; i<_size; i++ ) {if( strcmp(_entries[i].usn,usn) == 0 ) return i;}
+  return -1;
+}
+
+/**
+ *  Insert or refresh the entry for usn. If the table is full, the least recently seen entry is replaced.
+ */
+void DiscoveryTable::update(const char* usn, const char* location, const char* name, unsigned long maxAge, unsigned long now) {
+  int index = indexOf(usn);
+  if( index < 0 ) {
+    if( _size < DISCOVERY_CACHE_SIZE ) {
+      index = _size++;
+      if( _size > _stats.peak ) _stats.peak = _size;
+    }
+    else {
+      _stats.evictions++;
+      index = 0;
+      for( int i=1; i<_size; i++ ) {if( _entries[i].lastSeen < _entries[index].lastSeen ) index = i;}
+    }
+    strncpy(_entries[index].usn,usn,DISCOVERY_USN_SIZE-1);
+    _entries[index].usn[DISCOVERY_USN_SIZE-1] = '\0';
+  }
+  DiscoveryEntry& e = _entries[index];
+  if( e.location != location ) {
+    strncpy(e.location,location,DISCOVERY_LOCATION_SIZE-1);
+    e.location[DISCOVERY_LOCATION_SIZE-1] = '\0';
+  }
+  if( e.name != name ) {
+    strncpy(e.name,name,DISCOVERY_NAME_SIZE-1);
+    e.name[DISCOVERY_NAME_SIZE-1] = '\0';
+  }
+  e.lastSeen = now;
+  e.maxAge   = maxAge;
+}
+
+void DiscoveryTable::expire(unsigned long now) {
+  for( int i=_size-1; i>=0; i-- ) {if( (now - _entries[i].lastSeen) > _entries[i].maxAge ) remove(i);}
+}
+
+/**
+ *  Remove entry i, preserving the order of the remaining entries
+ */
+void DiscoveryTable::remove(int i) {
+  if( (i < 0) || (i >= _size) ) return;
+  for( int j=i; j<_size-1; j++ ) _entries[j] = _entries[j+1];
+  _size--;
+}
+
+} // End of namespace lsc
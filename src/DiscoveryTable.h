@@ -0,0 +1,152 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef DISCOVERY_TABLE_H
+#define DISCOVERY_TABLE_H
+
+/**
+ *   DiscoveryTable only depends on the Arduino core for its types, so it can also be compiled on a host
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+typedef bool boolean;
+#ifndef PROGMEM
+#define PROGMEM
+#define PGM_P          const char*
+#endif
+#define strlen_P       strlen
+#define strcmp_P       strcmp
+#define strncmp_P      strncmp
+#define strncasecmp_P  strncasecmp
+#endif
+
+/**
+ *   Cache dimensions; entries are fixed size so RAM use is DISCOVERY_CACHE_SIZE*sizeof(DiscoveryEntry)
+ */
+#ifndef DISCOVERY_CACHE_SIZE
+#define DISCOVERY_CACHE_SIZE     24
+#endif
+#define DISCOVERY_USN_SIZE       80
+#define DISCOVERY_LOCATION_SIZE  96
+#define DISCOVERY_NAME_SIZE      32
+
+/**
+ *   Entry lifetime (in seconds) when a reply or announcement has no CACHE-CONTROL max-age
+ */
+#define DISCOVERY_MAX_AGE        1800
+
+/**
+ *   Maximum number of packets read from a socket on a single DiscoveryCache::doDevice()
+ */
+#ifndef DISCOVERY_MAX_PACKETS
+#define DISCOVERY_MAX_PACKETS    4
+#endif
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct DiscoveryEntry {
+  char            usn[DISCOVERY_USN_SIZE];                // Unique Service Name of the RootDevice
+  char            location[DISCOVERY_LOCATION_SIZE];      // LOCATION header, or "/" if not present
+  char            name[DISCOVERY_NAME_SIZE];              // Display name
+  unsigned long   lastSeen;                               // millis() of the last reply or announcement
+  unsigned long   maxAge;                                 // CACHE-CONTROL max-age in milliseconds
+} DiscoveryEntry;
+
+/**
+ *   Discovery counters since boot, and timing of the most recent search. Reply times are milliseconds after the
+ *   M-SEARCH was sent, so firstReply and lastReply give time to first entry and time to complete for the MX window.
+ */
+typedef struct DiscoveryStats {
+  uint32_t        searches;                               // M-SEARCH requests sent
+  uint32_t        replies;                                // Search replies accepted into the cache
+  uint32_t        duplicates;                             // Replies from a device that already replied to the same search
+  uint32_t        notifies;                               // NOTIFY announcements accepted (passive mode)
+  uint32_t        rejected;                               // Packets that were not a reply/announcement or lacked headers
+  uint32_t        truncated;                              // Packets longer than the read buffer
+  uint32_t        evictions;                              // Entries replaced because the cache was full
+  uint16_t        searchReplies;                          // Replies to the most recent search
+  uint16_t        peak;                                   // Most entries held at once
+  unsigned long   firstReply;                             // ms from the most recent search to its first reply, 0 if none
+  unsigned long   lastReply;                              // ms from the most recent search to its latest reply
+} DiscoveryStats;
+
+/** DiscoveryTable is the bookkeeping of a DiscoveryCache: SSDP packet parsing, the entries, reply and duplicate
+ *  accounting, expiry and eviction. It has no network code, and time (millis() on a device) is passed in, so a
+ *  simulated fleet can drive it on a host. Entries expire by their max-age; when the table is full the least
+ *  recently seen entry is replaced.
+ *  The display name header belongs to UPnPLib, so the caller extracts it (UPnPBuffer::displayName()) and passes
+ *  it with the packet, NULL if there is none. Usage, for each M-SEARCH sent and each packet read:
+ *     table.searched(millis());
+ *     table.reply(packet,name,millis());
+ *     if( table.notify(packet,name,millis()) ) ... search to learn the display name
+ */
+class DiscoveryTable {
+  public:
+    DiscoveryTable() {}
+    virtual ~DiscoveryTable() {}
+
+    void                   searched(unsigned long now);                     // An M-SEARCH was sent, reset the per search stats
+    boolean                reply(const char* packet, const char* name, unsigned long now);    // Search reply, returns true if accepted
+    boolean                notify(const char* packet, const char* name, unsigned long now);   // NOTIFY, returns true if a search is needed
+    void                   replied(const char* usn, unsigned long now);     // Count a search reply, call before update()
+    void                   update(const char* usn, const char* location, const char* name, unsigned long maxAge, unsigned long now);
+    void                   expire(unsigned long now);                       // Drop entries whose max-age has elapsed
+    void                   remove(int i);
+    int                    indexOf(const char* usn);
+
+    int                    size()                    {return _size;}
+    const DiscoveryEntry*  entry(int i)              {return (((i>=0)&&(i<_size))?(&_entries[i]):(NULL));}
+    boolean                isEmpty()                 {return (_size == 0);}
+    unsigned long          lastSearch()              {return _lastSearch;}
+    DiscoveryStats&        stats()                   {return _stats;}     // Truncated packets are counted by the cache
+
+/**
+ *   SSDP header value following the start line, matched case-insensitively and trimmed. maxAge() is the CACHE-CONTROL
+ *   max-age in milliseconds, DISCOVERY_MAX_AGE seconds if there is none.
+ */
+    static boolean         headerValue(const char* packet, PGM_P name, char value[], int size);
+    static unsigned long   maxAge(const char* packet);
+
+  protected:
+    unsigned long          _lastSearch = 0;
+    int                    _size       = 0;
+    DiscoveryEntry         _entries[DISCOVERY_CACHE_SIZE];
+    DiscoveryStats         _stats      = {};
+
+/**
+ *   Copy construction and assignment are not allowed (UPnPLib, and so DEFINE_EXCLUSIONS, is not available on a host)
+ */
+    DiscoveryTable(const DiscoveryTable&)            = delete;
+    DiscoveryTable& operator=(const DiscoveryTable&) = delete;
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "EntityTag.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char entity_tag[]  PROGMEM = "\"%08lx-%lx-%lx%c\"";
+
+uint32_t EntityTag::bootId() {
+  static uint32_t id = 0;
+  if( id == 0 ) id = ((uint32_t)random(0x10000) << 16) | (uint32_t)random(0x10000) | 1;
+  return id;
+}
+
+int EntityTag::format(char buffer[], int size, char variant, uint32_t state) {
+  return snprintf_P(buffer,size,entity_tag,(unsigned long)bootId(),(unsigned long)_config,(unsigned long)state,variant);
+}
+
+/**
+ *  If-None-Match is "*" or a list of tags, possibly weak (W/"..."); the tag is quoted so a substring match is exact
+ */
+boolean EntityTag::notModified(WebContext* svr, char variant, uint32_t state) {
+  char tag[48];
+  format(tag,48,variant,state);
+  svr->sendHeader("ETag",tag);
+  svr->sendHeader("Cache-Control","no-cache");
+  if( !svr->hasHeader("If-None-Match") ) return false;
+  const String& match = svr->header("If-None-Match");
+  if( !match.equals("*") && (match.indexOf(tag) < 0) ) return false;
+  svr->send(304,"text/plain","");
+  return true;
+}
+
+} // End of namespace lsc
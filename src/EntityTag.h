@@ -0,0 +1,73 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef ENTITY_TAG_H
+#define ENTITY_TAG_H
+
+#include <UPnPLib.h>
+#include "ContentFormat.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/** EntityTag keeps the generation counters of a device and answers conditional requests from them. The config
+ *  generation is bumped when configuration is set, the state generation when readings or relay state change. A tag is
+ *      "boot-config-state" followed by a variant character (the representation: page, control frame, XML, JSON...)
+ *  where boot is chosen at random on startup, so tags from before a restart never match.
+ *  Usage, in a request handler:
+ *      if( entityTag()->notModified(svr,'d',stateGeneration()) ) return;
+ *      ... render as usual, the ETag header is already set
+ */
+class EntityTag {
+  public:
+    EntityTag() {}
+
+    void             touchConfig()                  {_config++;}
+    void             touchState()                   {_state++;}
+    uint32_t         config()                       {return _config;}
+    uint32_t         state()                        {return _state;}
+
+/**
+ *   Set the ETag and Cache-Control: no-cache headers for the response; if the request's If-None-Match already has
+ *   the tag, send 304 and return true. The If-None-Match header must be collected, see collectDeviceHeaders().
+ */
+    boolean          notModified(WebContext* svr, char variant, uint32_t state = 0);
+    int              format(char buffer[], int size, char variant, uint32_t state = 0);
+
+    static char      variant(ContentFormat format)  {return ((format==JSON_FORMAT)?('j'):((format==BINARY_FORMAT)?('b'):('x')));}
+    static uint32_t  bootId();
+
+  private:
+    uint32_t         _config = 0;
+    uint32_t         _state  = 0;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(EntityTag);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,366 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#include "EventServices.h"
+#include "ContentFormat.h"
+#include "HandlerMetrics.h"
+#include "QueryArgs.h"
+#include <WiFiClient.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char event_notify[]             PROGMEM = "NOTIFY %s HTTP/1.1\r\n"
+                                                "HOST: %s:%d\r\n"
+                                                "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+                                                "NT: upnp:event\r\n"
+                                                "NTS: upnp:propchange\r\n"
+                                                "SID: %s\r\n"
+                                                "SEQ: %lu\r\n"
+                                                "CONTENT-LENGTH: %d\r\n"
+                                                "CONNECTION: close\r\n\r\n";
+const char event_propertyset_head[]   PROGMEM = "<?xml version=\"1.0\"?><e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\">";
+const char event_property[]           PROGMEM = "<e:property><%s>%s</%s></e:property>";
+const char event_propertyset_tail[]   PROGMEM = "</e:propertyset>";
+const char event_variable[]           PROGMEM = "<%s>%s</%s>";
+const char event_subscription[]       PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><subscription><sid>%s</sid><timeout>%lu</timeout></subscription>";
+const char event_sid[]                PROGMEM = "uuid:%04lx%04lx-%04lx-%04lx-%04lx-%04lx%04lx%04lx";
+const char event_timeout[]            PROGMEM = "Second-%lu";
+const char event_json[]               PROGMEM = "%s\"%s\":\"%s\"";
+const char event_stream_head[]        PROGMEM = "HTTP/1.1 200 OK\r\n"
+                                                "Content-Type: text/event-stream\r\n"
+                                                "Cache-Control: no-cache\r\n"
+                                                "Connection: keep-alive\r\n\r\n"
+                                                "retry: 5000\n";
+const char event_stream_data[]        PROGMEM = "data: {";
+const char event_stream_tail[]        PROGMEM = "}\n\n";
+const char event_stream_keepalive[]   PROGMEM = ":\n\n";
+
+/**
+ *  Static RTT initialization
+ */
+INITIALIZE_SERVICE_TYPES(EventService,LeelanauSoftware-com,events,1.0.0);
+
+EventService::EventService() : UPnPService("events") {setDisplayName("Events");}
+EventService::EventService(const char* target) : UPnPService(target) {setDisplayName("Events");}
+
+/**
+ *  Subscription headers are only available if the server collects them
+ */
+void EventService::setup(WebContext* svr) {
+  UPnPService::setup(svr);
+  collectDeviceHeaders(svr);
+}
+
+/**
+ *  Arguments take precedence over the GENA headers. Values are copied into fixed buffers; a value too long for its
+ *  buffer is truncated and then fails validation, since no callback URL or SID fills the buffer.
+ */
+void EventService::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
+  uint32_t action                          = 0;
+  char     callback[EVENT_CALLBACK_SIZE+2] = "";
+  char     sid[EVENT_SID_SIZE+1]           = "";
+  char     timeoutStr[32]                  = "";
+  QueryArgs args(svr);
+  for( int i=0; i<args.count(); i++ ) {
+    ArgView a = args.arg(i);
+    switch( a.hash() ) {
+      case argHash("ACTION"):   action = argHash(a.value()); break;
+      case argHash("CALLBACK"): copyValue(callback,sizeof(callback),a.value()); break;
+      case argHash("SID"):      copyValue(sid,sizeof(sid),a.value()); break;
+      case argHash("TIMEOUT"):  copyValue(timeoutStr,sizeof(timeoutStr),a.value()); break;
+    }
+  }
+  if( (*callback == '\0') && svr->hasHeader("CALLBACK") )  copyValue(callback,sizeof(callback),svr->header("CALLBACK").c_str());
+  if( (*sid == '\0') && svr->hasHeader("SID") )            copyValue(sid,sizeof(sid),svr->header("SID").c_str());
+  if( (*timeoutStr == '\0') && svr->hasHeader("TIMEOUT") ) copyValue(timeoutStr,sizeof(timeoutStr),svr->header("TIMEOUT").c_str());
+
+  if( (action == argHash("STREAM")) || ((action == 0) && (strstr(svr->header("Accept").c_str(),"text/event-stream") != NULL)) ) {
+    stream(svr);
+    return;
+  }
+  boolean classify = (action == 0);
+  if( (action == argHash("UNSUBSCRIBE")) || (classify && (*callback == '\0') && (*sid != '\0') && (*timeoutStr == '\0')) ) unsubscribe(svr,sid);
+  else if( (action == argHash("RENEW")) || (classify && (*callback == '\0') && (*sid != '\0')) ) renew(svr,sid,timeoutStr);
+  else if( *callback != '\0' ) subscribe(svr,callback,timeoutStr);
+  else svr->send(412,"text/plain","Precondition Failed");
+}
+
+/**
+ *  Only the first URL of CALLBACK is used. The initial event (SEQ 0) with every variable is sent from the next doDevice().
+ */
+void EventService::subscribe(WebContext* svr, const char* callback, const char* timeoutStr) {
+  const char* start = strchr(callback,'<');
+  const char* end   = ((start != NULL)?(strchr(start,'>')):(NULL));
+  if( end != NULL ) start++;
+  else {
+    start = callback;
+    end   = callback + strlen(callback);
+  }
+  int len = end - start;
+  if( (strncmp(start,"http://",7) != 0) || (len >= EVENT_CALLBACK_SIZE) ) {
+    svr->send(412,"text/plain","Precondition Failed");
+    return;
+  }
+  if( _numSubscribers >= EVENT_MAX_SUBSCRIBERS ) {
+    svr->send(503,"text/plain","Service Unavailable");
+    return;
+  }
+
+  EventSubscription& s = _subscribers[_numSubscribers++];
+  snprintf_P(s.sid,EVENT_SID_SIZE,event_sid,random(0x10000),random(0x10000),random(0x10000),(random(0x1000)|0x4000),
+             (random(0x4000)|0x8000),random(0x10000),random(0x10000),random(0x10000));
+  memcpy(s.callback,start,len);
+  s.callback[len] = '\0';
+  s.renewed  = millis();
+  s.timeout  = timeout(timeoutStr);
+  s.lastSent = 0;
+  s.seq      = 0;
+  s.failures = 0;
+  s.pending  = true;
+  respond(svr,s);
+}
+
+void EventService::renew(WebContext* svr, const char* sid, const char* timeoutStr) {
+  int i = indexOf(sid);
+  if( i < 0 ) {
+    svr->send(412,"text/plain","Precondition Failed");
+    return;
+  }
+  _subscribers[i].renewed = millis();
+  _subscribers[i].timeout = timeout(timeoutStr);
+  respond(svr,_subscribers[i]);
+}
+
+void EventService::unsubscribe(WebContext* svr, const char* sid) {
+  int i = indexOf(sid);
+  if( i < 0 ) {
+    svr->send(412,"text/plain","Precondition Failed");
+    return;
+  }
+  remove(i);
+  svr->send(200,"text/plain","");
+}
+
+/**
+ *  Take over the client connection: the response header and the first event are written directly, and the client is
+ *  kept after the handler returns so doDevice() can write to it.
+ */
+void EventService::stream(WebContext* svr) {
+  if( _numStreams >= EVENT_MAX_STREAMS ) {
+    _streams[0].stop();
+    removeStream(0);
+  }
+  WiFiClient& c = _streams[_numStreams++];
+  c = svr->client();
+  c.setNoDelay(true);
+  char buffer[256];
+  int pos = formatBuffer_P(buffer,256,0,event_stream_head);
+  pos = formatBuffer_P(buffer,256,pos,event_stream_data);
+  pos = formatJSON(buffer,256,pos);
+  pos = formatBuffer_P(buffer,256,pos,event_stream_tail);
+  if( c.write((const uint8_t*)buffer,pos) != (size_t)pos ) removeStream(_numStreams-1);
+  _lastStream = millis();
+}
+
+void EventService::removeStream(int i) {
+  if( (i < 0) || (i >= _numStreams) ) return;
+  for( int j=i; j<_numStreams-1; j++ ) _streams[j] = _streams[j+1];
+  _streams[--_numStreams] = WiFiClient();
+}
+
+/**
+ *  Write changed variables, or a keep-alive comment when nothing has changed for EVENT_KEEPALIVE ms, to every stream.
+ *  Streams that are disconnected or fail to take the whole event are closed; the browser reconnects on its own.
+ */
+void EventService::writeStreams(unsigned long current) {
+  char buffer[256];
+  int  pos = 0;
+  if( _changed != 0 ) {
+    pos = formatBuffer_P(buffer,256,pos,event_stream_data);
+    pos = formatJSON(buffer,256,pos,_changed);
+    pos = formatBuffer_P(buffer,256,pos,event_stream_tail);
+  }
+  else if( (current - _lastStream) >= EVENT_KEEPALIVE ) pos = formatBuffer_P(buffer,256,pos,event_stream_keepalive);
+  else return;
+
+  _changed    = 0;
+  _lastStream = current;
+  for( int i=_numStreams-1; i>=0; i-- ) {
+    if( !_streams[i].connected() || (_streams[i].write((const uint8_t*)buffer,pos) != (size_t)pos) ) {
+      _streams[i].stop();
+      removeStream(i);
+    }
+  }
+}
+
+void EventService::respond(WebContext* svr, EventSubscription& s) {
+  char value[32];
+  snprintf_P(value,32,event_timeout,s.timeout/1000);
+  svr->sendHeader("SID",s.sid);
+  svr->sendHeader("TIMEOUT",value);
+  char buffer[160];
+  snprintf_P(buffer,160,event_subscription,s.sid,s.timeout/1000);
+  svr->send(200,"text/xml",buffer);
+}
+
+/**
+ *  TIMEOUT is Second-n, Second-infinite, or (as an argument) n. Returned in milliseconds.
+ */
+unsigned long EventService::timeout(const char* s) {
+  unsigned long secs  = EVENT_TIMEOUT;
+  const char*   value = strchr(s,'-');
+  long          n     = 0;
+  value = ((value != NULL)?(value+1):(s));
+  if( strcasecmp(value,"infinite") == 0 ) secs = EVENT_MAX_TIMEOUT;
+  else if( QueryArgs::parseInt(value,n) && (n > 0) ) secs = n;
+  if( secs > EVENT_MAX_TIMEOUT ) secs = EVENT_MAX_TIMEOUT;
+  return secs*1000UL;
+}
+
+int EventService::indexOf(const char* sid) {
+  for( int i=0; i<_numSubscribers; i++ ) {if( strcmp(sid,_subscribers[i].sid) == 0 ) return i;}
+  return -1;
+}
+
+/**
+ *  Copy a request value, truncated to size
+ */
+void EventService::copyValue(char buffer[], int size, const char* value) {
+  strncpy(buffer,value,size-1);
+  buffer[size-1] = '\0';
+}
+
+void EventService::remove(int i) {
+  if( (i < 0) || (i >= _numSubscribers) ) return;
+  for( int j=i; j<_numSubscribers-1; j++ ) _subscribers[j] = _subscribers[j+1];
+  _numSubscribers--;
+}
+
+boolean EventService::set(const char* name, const char* value) {
+  int i = 0;
+  for( ; (i<_numVariables) && (strcmp(_variables[i].name,name) != 0); i++ );
+  if( i == _numVariables ) {
+    if( _numVariables >= EVENT_MAX_VARIABLES ) return false;
+    _variables[_numVariables++] = {name,""};
+  }
+  else if( strncmp(_variables[i].value,value,EVENT_VALUE_SIZE-1) == 0 ) return false;
+
+  strncpy(_variables[i].value,value,EVENT_VALUE_SIZE-1);
+  _variables[i].value[EVENT_VALUE_SIZE-1] = '\0';
+  for( int j=0; j<_numSubscribers; j++ ) _subscribers[j].pending = true;
+  _changed |= (1 << i);
+  _changes++;
+  return true;
+}
+
+const char* EventService::get(const char* name) {
+  for( int i=0; i<_numVariables; i++ ) {if( strcmp(_variables[i].name,name) == 0 ) return _variables[i].value;}
+  return NULL;
+}
+
+int EventService::formatVariables(char buffer[], int size, int pos) {
+  for( int i=0; i<_numVariables; i++ ) pos = formatBuffer_P(buffer,size,pos,event_variable,_variables[i].name,_variables[i].value,_variables[i].name);
+  return pos;
+}
+
+int EventService::formatJSON(char buffer[], int size, int pos, uint8_t mask) {
+  const char* separator = "";
+  for( int i=0; i<_numVariables; i++ ) {
+    if( (mask & (1 << i)) == 0 ) continue;
+    pos = formatBuffer_P(buffer,size,pos,event_json,separator,_variables[i].name,_variables[i].value);
+    separator = ",";
+  }
+  return pos;
+}
+
+/**
+ *  Write open streams, expire subscriptions, then send at most one NOTIFY, visiting subscribers round-robin
+ */
+void EventService::doDevice() {
+  unsigned long current = millis();
+  if( _numStreams > 0 ) writeStreams(current);
+  else _changed = 0;
+  for( int i=_numSubscribers-1; i>=0; i-- ) {if( (current - _subscribers[i].renewed) > _subscribers[i].timeout ) remove(i);}
+
+  for( int n=0; n<_numSubscribers; n++ ) {
+    if( _next >= _numSubscribers ) _next = 0;
+    EventSubscription& s = _subscribers[_next++];
+    if( !s.pending || ((s.seq > 0) && ((current - s.lastSent) < _moderation)) ) continue;
+    s.pending  = false;
+    s.lastSent = current;
+    if( notify(s) ) {
+      s.seq      = ((s.seq == 0xFFFFFFFF)?(1):(s.seq+1));
+      s.failures = 0;
+    }
+    else if( ++s.failures >= EVENT_MAX_FAILURES ) remove(_next-1);
+    else s.pending = true;
+    return;
+  }
+}
+
+/**
+ *  Send the property set to the subscriber's callback URL, http://host[:port][/path]. The response is not read.
+ */
+boolean EventService::notify(EventSubscription& s) {
+  const char* p     = s.callback + 7;
+  const char* slash = strchr(p,'/');
+  const char* end   = ((slash != NULL)?(slash):(p+strlen(p)));
+  const char* colon = (const char*)memchr(p,':',end-p);
+  int         len   = ((colon != NULL)?(colon):(end)) - p;
+  if( (len <= 0) || (len >= 64) ) return false;
+  char host[64];
+  memcpy(host,p,len);
+  host[len] = '\0';
+  int         port  = ((colon != NULL)?(atoi(colon+1)):(80));
+  const char* path  = ((slash != NULL)?(slash):("/"));
+
+  char body[512];
+  int  pos = formatBuffer_P(body,512,0,event_propertyset_head);
+  for( int i=0; i<_numVariables; i++ ) pos = formatBuffer_P(body,512,pos,event_property,_variables[i].name,_variables[i].value,_variables[i].name);
+  pos = formatBuffer_P(body,512,pos,event_propertyset_tail);
+  char head[384];
+  int  n = snprintf_P(head,384,event_notify,path,host,port,s.sid,(unsigned long)s.seq,pos);
+
+/**
+ *  Stream::setTimeout() is in ms on ESP8266, where connect() uses it. The arduino-esp32 WiFiClient::setTimeout() takes
+ *  seconds, so there the connect timeout is passed in ms and writes get the nearest whole second.
+ */
+  WiFiClient client;
+#ifdef ESP32
+  client.setTimeout((EVENT_CONNECT_TIMEOUT+999)/1000);
+  if( !client.connect(host,port,EVENT_CONNECT_TIMEOUT) ) return false;
+#else
+  client.setTimeout(EVENT_CONNECT_TIMEOUT);
+  if( !client.connect(host,port) ) return false;
+#endif
+  client.write((const uint8_t*)head,n);
+  client.write((const uint8_t*)body,pos);
+  client.stop();
+  return true;
+}
+
+} // End of namespace lsc
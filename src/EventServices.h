@@ -0,0 +1,175 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#ifndef EVENTSERVICES_H
+#define EVENTSERVICES_H
+
+#include <UPnPLib.h>
+#include <WiFiClient.h>
+
+/**
+ *   Table dimensions. RAM is about EVENT_MAX_SUBSCRIBERS*(EVENT_SID_SIZE + EVENT_CALLBACK_SIZE + 24) +
+ *   EVENT_MAX_VARIABLES*(EVENT_VALUE_SIZE + 4) bytes per EventService.
+ */
+#ifndef EVENT_MAX_SUBSCRIBERS
+#define EVENT_MAX_SUBSCRIBERS   4
+#endif
+#define EVENT_MAX_VARIABLES     4
+#define EVENT_VALUE_SIZE        16
+#define EVENT_SID_SIZE          48
+#define EVENT_CALLBACK_SIZE     96
+
+/**
+ *   Subscription timeout (in seconds) when none is requested, and the maximum granted. Connect timeout (in ms) bounds
+ *   how long doDevice() can block on an unreachable subscriber, which is dropped after EVENT_MAX_FAILURES attempts.
+ */
+#define EVENT_TIMEOUT           1800
+#define EVENT_MAX_TIMEOUT       86400
+#define EVENT_CONNECT_TIMEOUT   250
+#define EVENT_MAX_FAILURES      3
+
+/**
+ *   Open event streams (Server-Sent Events) per EventService, and the interval (in ms) of the keep-alive comment that 
+ *   detects streams whose page has gone away.
+ */
+#ifndef EVENT_MAX_STREAMS
+#define EVENT_MAX_STREAMS       2
+#endif
+#define EVENT_KEEPALIVE         15000
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct EventVariable {
+  const char*     name;                                   // Element name in the property set
+  char            value[EVENT_VALUE_SIZE];
+} EventVariable;
+
+typedef struct EventSubscription {
+  char            sid[EVENT_SID_SIZE];                    // uuid:... returned to the subscriber
+  char            callback[EVENT_CALLBACK_SIZE];          // First URL of the CALLBACK header, without < >
+  unsigned long   renewed;                                // millis() of the subscribe or last renewal
+  unsigned long   timeout;                                // Subscription lifetime in milliseconds
+  unsigned long   lastSent;                               // millis() of the last NOTIFY
+  uint32_t        seq;                                    // Event key, 0 for the initial event
+  uint8_t         failures;
+  boolean         pending;                                // A NOTIFY is due
+} EventSubscription;
+
+/** EventService adds GENA-style eventing to a device. The device publishes state variables with set(), and every 
+ *  subscriber receives a NOTIFY with the full property set when a value changes. NOTIFYs are sent from doDevice(), 
+ *  at most one per call, so HTTP handlers never wait on subscribers. moderation() sets the minimum interval between 
+ *  NOTIFYs to a subscriber; changes in between are coalesced into the next one. Publishing values at display 
+ *  resolution (for example "%.1f") keeps sensor noise from generating events.
+ *
+ *  Subscription is by request to the service path. Since the web server may not route the SUBSCRIBE and UNSUBSCRIBE
+ *  methods, the request is classified by headers (or the equivalent arguments):
+ *     CALLBACK: <http://host:port/path>  [TIMEOUT: Second-n]     := Subscribe, responds with SID and TIMEOUT
+ *     SID: uuid:...  TIMEOUT: Second-n                           := Renew
+ *     SID: uuid:...                                              := Unsubscribe
+ *  The argument ACTION=SUBSCRIBE|RENEW|UNSUBSCRIBE overrides the classification.
+ *
+ *  A request with Accept: text/event-stream (or ACTION=STREAM), as sent by a browser EventSource, is held open as a 
+ *  Server-Sent Events stream instead. The first event carries every variable as a JSON object, and each following event
+ *  only the variables changed since the last one, for example: data: {"state":"ON"}. Streams are written from doDevice()
+ *  without moderation; when all EVENT_MAX_STREAMS are in use the oldest is closed.
+ *  Usage:
+ *     EventService  _events;
+ *     addService(&_events);
+ *     _events.set("state","ON");
+ *     void doDevice() {_events.doDevice();}
+ */
+class EventService : public UPnPService {
+  public:
+    EventService();
+    EventService(const char* target);
+    virtual ~EventService() {}
+
+    void               handleRequest(WebContext* svr);
+    void               setup(WebContext* svr);
+    void               doDevice();                                              // Expire subscriptions and send one pending NOTIFY
+
+    boolean            set(const char* name, const char* value);               // Publish a value, returns true if it changed
+    const char*        get(const char* name);                                   // Current value of name, or NULL
+
+    void               moderation(unsigned long ms)   {_moderation = ms;}       // Minimum milliseconds between NOTIFYs
+    unsigned long      moderation()                   {return _moderation;}
+    int                numSubscribers()               {return _numSubscribers;}
+    int                numVariables()                 {return _numVariables;}
+    const EventVariable* variable(int i)              {return (((i>=0)&&(i<_numVariables))?(&_variables[i]):(NULL));}
+    int                formatVariables(char buffer[], int size, int pos);      // Append <name>value</name> for every variable
+    int                formatJSON(char buffer[], int size, int pos, uint8_t mask = 0xFF);  // Append "name":"value" pairs for variables in mask
+    int                numStreams()                   {return _numStreams;}
+    uint32_t           changes()                      {return _changes;}        // Number of value changes, a generation counter
+
+/**
+ *   Macros to define the following Runtime and UPnP Type Info:
+ *     private: static const ClassType  _classType;
+ *     public:  static const ClassType* classType();
+ *     public:  virtual void*           as(const ClassType* t);
+ *     public:  virtual boolean         isClassType( const ClassType* t);
+ *     private: static const char*      _upnpType;
+ *     public:  static const char*      upnpType()
+ *     public:  virtual const char*     getType()
+ *     public:  virtual boolean         isType(const char* t)
+ */
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+  protected:
+    void               subscribe(WebContext* svr, const char* callback, const char* timeout);
+    void               renew(WebContext* svr, const char* sid, const char* timeout);
+    void               unsubscribe(WebContext* svr, const char* sid);
+    void               respond(WebContext* svr, EventSubscription& s);
+    boolean            notify(EventSubscription& s);
+    void               remove(int i);
+    void               stream(WebContext* svr);
+    void               writeStreams(unsigned long current);
+    void               removeStream(int i);
+    int                indexOf(const char* sid);
+    static unsigned long timeout(const char* s);
+    static void        copyValue(char buffer[], int size, const char* value);
+
+    EventVariable      _variables[EVENT_MAX_VARIABLES];
+    int                _numVariables   = 0;
+    EventSubscription  _subscribers[EVENT_MAX_SUBSCRIBERS];
+    int                _numSubscribers = 0;
+    int                _next           = 0;                  // Round-robin position for doDevice()
+    unsigned long      _moderation     = 0;
+    WiFiClient         _streams[EVENT_MAX_STREAMS];
+    int                _numStreams     = 0;
+    uint8_t            _changed        = 0;                  // Bit i is set when variable i changed since the last stream event
+    uint32_t           _changes        = 0;
+    unsigned long      _lastStream     = 0;                  // millis() of the last stream write
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(EventService);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -21,16 +21,12 @@
  */
 
 #include "ExtendedDevice.h"
+#include "SensorDevice.h"
+#include "RelayControl.h"
+#include "ConfigStore.h"
 
 namespace lsc {
 
-const char SSDP_Search[]                  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
-                                                    "HOST: 239.255.255.250:1900\r\n"
-                                                    "MAN: ssdp:discover\r\n"
-                                                    "ST: upnp:rootdevice\r\n"
-                                                    "ST.LEELANAUSOFTWARE.COM: \r\n"
-                                                    "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
-const char LocationHeader[]               PROGMEM = "LOCATION";
 const char nearby_title[]                 PROGMEM = "<H1 align=\"center\"> Devices Near %s </H1><br><br>";
 
 const char ExtendedDevice_config_form[]      PROGMEM = "<form action=\"%s\"><div align=\"center\">"                                                      // Form Path
@@ -41,156 +37,291 @@ const char ExtendedDevice_config_form[]      PROGMEM = "<form action=\"%s\"><div
       "</div></form><br><br>";
 
 const char brk_html[]                   PROGMEM = "<br>";   
-#define SSDP_BUFFER_SIZE 1000
-#define DESC_HEADER_SIZE 150
+const char searching_html[]             PROGMEM = "<p align=\"center\">Searching...</p>";
+
+const char snapshot_head[]              PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><snapshot name=\"";
+const char snapshot_uptime[]            PROGMEM = "\" uptime=\"%lu\">";
+const char snapshot_device[]            PROGMEM = "<device name=\"";
+const char snapshot_type[]              PROGMEM = "\" type=\"";
+const char snapshot_path[]              PROGMEM = "\" path=\"";
+const char snapshot_attribute_end[]     PROGMEM = "\">";
+const char snapshot_device_tail[]       PROGMEM = "</device>";
+const char snapshot_tail[]              PROGMEM = "</snapshot>";
 
 /**
  *  Static RTT initialization
  */
  INITIALIZE_DEVICE_TYPES(ExtendedDevice,LeelanauSoftware-com,ExtendedDevice,1.0.1);
+ INITIALIZE_SERVICE_TYPES(GetSnapshot,LeelanauSoftware-com,getSnapshot,1.0.0);
 
 ExtendedDevice::ExtendedDevice() : RootDevice("root") {
-  addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services for configuration
+  addServices(getConfigurationSvc(),setConfigurationSvc(),getSnapshotSvc(),getMetricsSvc(),getLoopProfileSvc(),getTraceSvc());   // Add services for configuration, state snapshot, profiling and trace
   setDisplayName("Extended Device");
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
+  getSnapshotSvc()->setHttpHandler(HandlerMetrics::timed(getSnapshotSvc(),[this](WebContext* svr){this->snapshot(svr);}));
 }
 
 ExtendedDevice::ExtendedDevice(const char* target) : RootDevice(target) {
-  addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services for configuration
+  addServices(getConfigurationSvc(),setConfigurationSvc(),getSnapshotSvc(),getMetricsSvc(),getLoopProfileSvc(),getTraceSvc());   // Add services for configuration, state snapshot, profiling and trace
   setDisplayName("Extended Device");
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
+  getSnapshotSvc()->setHttpHandler(HandlerMetrics::timed(getSnapshotSvc(),[this](WebContext* svr){this->snapshot(svr);}));
 }
 
-void ExtendedDevice::display(WebContext* svr) {
+/**
+ *  Configuration generation only changes if a display name was applied
+ */
+void ExtendedDevice::handleSetConfiguration(WebContext* svr) {
+  if( displayName_schema.parse(svr,(UPnPObject*)this) > 0 ) entityTag()->touchConfig();
+  display(svr);
+}
 
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
+void ExtendedDevice::display(WebContext* svr) {
+  HandlerScope scope(this);
+  ChunkedWriter w(svr);
 
 /** Add HTML Header and Title with Display Name
  */
-  int pos = formatHeader(buffer,size,getDisplayName());
+  w.header(getDisplayName());
 
 /** Add a button for each embedded device
  *  
  */
-  pos = formatContent(buffer,size,pos);
+  streamContent(w);
 
 /** Add a Config button 
  */
-  char pathBuff[100];
-  setConfigurationSvc()->formPath(pathBuff,100);
-  pos = formatBuffer_P(buffer,size,pos,brk_html);
-  pos = formatBuffer_P(buffer,size,pos,config_button,pathBuff,"Configure");
+  w.printf_P(brk_html);
+  w.printf_P(config_button,_paths.form,"Configure");
 
 /** Add the HTML tail
  */ 
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.tail();
 }
 
 void ExtendedDevice::displayRoot(WebContext* svr) {
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
+  HandlerScope scope("/");
+  ChunkedWriter w(svr);
 
 /** Add HTML Header and Title with Display Name
  */
-  int pos = formatHeader(buffer,size,getDisplayName());
+  w.header(getDisplayName());
 
 /** Add Content 
  */
-  pos = formatRootContent(buffer,size,pos);
+  streamRootContent(w);
 
 /** Add a Nearby Devices button that will display all nearby RootDevices as buttons
  */
-  char pathBuff[100];
-  handlerPath(pathBuff,100,"nearbyDevices");
-  pos = formatBuffer_P(buffer,size,pos,app_button,pathBuff,"Nearby Devices");
+  w.printf_P(app_button,_nearbyPath,"Nearby Devices");
   
 /** Add the HTML tail
  */ 
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.tail();
+}
+
+/**
+ *  Embedded device content is written one device at a time so that only a single device has to fit in the
+ *  ChunkedWriter buffer.
+ */
+void ExtendedDevice::streamContent(ChunkedWriter& w) {
+  for( int i=0; i<numDevices(); i++ ) {
+    UPnPDevice* d = device(i);
+    if( d == NULL ) continue;
+    FormatFunction button = [d](char buffer[], int size, int pos) {
+      return formatBuffer_P(buffer,size,pos,app_button,devicePath(d),d->getDisplayName());
+    };
+    uint32_t generation = 0;
+    if( configGeneration(d,generation) ) FragmentCache::shared()->write(w,d,BUTTON_FRAGMENT,generation,button);
+    else w.write(button);
+  }
+}
+
+/**
+ *  Device buttons and Control root content only change with configuration (display name) or device paths
+ */
+boolean ExtendedDevice::configGeneration(UPnPDevice* d, uint32_t& generation) {
+  Sensor*         s = (Sensor*)d->as(Sensor::classType());
+  Control*        c = (Control*)d->as(Control::classType());
+  ExtendedDevice* e = (ExtendedDevice*)d->as(ExtendedDevice::classType());
+  if( s != NULL )      generation = s->entityTag()->config();
+  else if( c != NULL ) generation = c->entityTag()->config();
+  else if( e != NULL ) generation = e->entityTag()->config();
+  else return false;
+  return true;
+}
+
+/**
+ *  Sensors, Controls, and ExtendedDevices intern their path at setup(); any other device is interned on first use.
+ */
+const char* ExtendedDevice::devicePath(UPnPDevice* d) {
+  Sensor*         s = (Sensor*)d->as(Sensor::classType());
+  Control*        c = (Control*)d->as(Control::classType());
+  ExtendedDevice* e = (ExtendedDevice*)d->as(ExtendedDevice::classType());
+  if( (s != NULL) && (*s->paths().device != '\0') ) return s->paths().device;
+  if( (c != NULL) && (*c->paths().device != '\0') ) return c->paths().device;
+  if( (e != NULL) && (*e->paths().device != '\0') ) return e->paths().device;
+  return PathTable::shared()->path(d);
+}
+
+/**
+ *  On a composite root page each distinct Control script is written once, after all of the content it binds to
+ */
+void ExtendedDevice::streamRootContent(ChunkedWriter& w) {
+  PGM_P scripts[4];
+  int   numScripts = 0;
+  for( int i=0; i<numDevices(); i++ ) {
+    UPnPDevice* d = device(i);
+    Control*    c = ((d != NULL)?((Control*)d->as(Control::classType())):(NULL));
+    if( c == NULL ) {
+      w.rootContent(d);
+      continue;
+    }
+    if( !_inlineControls ) {
+      FragmentCache::shared()->write(w,c,ROOT_FRAGMENT,c->entityTag()->config(),[c](char buffer[], int size, int pos) {return c->formatRootContent(buffer,size,pos);});
+      continue;
+    }
+    w.write([c](char buffer[], int size, int pos) {return c->formatInlineContent(buffer,size,pos);});
+    PGM_P s = c->controlScript();
+    int   j = 0;
+    for( ; (j<numScripts) && (scripts[j] != s); j++ );
+    if( (s != NULL) && (j == numScripts) && (numScripts < 4) ) scripts[numScripts++] = s;
+  }
+  for( int j=0; j<numScripts; j++ ) w.printf_P(scripts[j]);
+}
+
+/**
+ *  A button for each RootDevice in the discovery cache. If an on demand cache is stale a search is sent, so the next
+ *  page load has fresh content; the current content is rendered without waiting. A background cache (HubDevice)
+ *  searches on its own timer, so page views never send an M-SEARCH.
+ */
+void ExtendedDevice::streamDiscovered(ChunkedWriter& w) {
+  if( !_discovery.isBackground() && _discovery.isStale() ) {
+    _discovery.search();
+    if( _discovery.isEmpty() ) w.printf_P(searching_html);
+  }
+  for( int i=0; i<_discovery.size(); i++ ) {
+    const DiscoveryEntry* e = _discovery.entry(i);
+    w.printf_P(app_button,e->location,e->name);
+  }
+}
+
+/**
+ *  Embedded devices are run as in RootDevice::doDevice(), each in its own LoopScope. A loop iteration is counted from
+ *  here to the next call.
+ */
+void ExtendedDevice::doDevice() {
+  LoopProfiler::shared()->loop();
+  for( int i=0; i<numDevices(); i++ ) {
+    UPnPDevice* d = device(i);
+    if( d == NULL ) continue;
+    LoopScope scope(d);
+    d->doDevice();
+  }
+  {
+    LoopScope scope(this,"discovery");
+    _discovery.doDevice();
+  }
+  if( _configStore != NULL ) {
+    LoopScope scope(this,"configStore");
+    _configStore->doDevice(this);
+  }
+}
+
+int ExtendedDevice::saveConfig(uint8_t buffer[], int size) {return displayName_schema.serialize(buffer,size,(UPnPObject*)this);}
+int ExtendedDevice::restoreConfig(const uint8_t* data, int len) {return displayName_schema.deserialize(data,len,(UPnPObject*)this);}
+
+/**
+ *  One pass over the embedded devices, each formatted directly into the ChunkedWriter buffer. Display names are user
+ *  text, so attributes are escaped with formatXMLString().
+ */
+void ExtendedDevice::snapshot(WebContext* svr) {
+  ChunkedWriter w(svr,"text/xml");
+  w.write([this](char buffer[], int size, int pos) {
+    pos = formatBuffer_P(buffer,size,pos,snapshot_head);
+    pos = formatXMLString(buffer,size,pos,getDisplayName());
+    return formatBuffer_P(buffer,size,pos,snapshot_uptime,millis()/1000);
+  });
+  for( int i=0; i<numDevices(); i++ ) {
+    UPnPDevice* d = device(i);
+    if( d == NULL ) continue;
+    w.write([d](char buffer[], int size, int pos) {
+      pos = formatBuffer_P(buffer,size,pos,snapshot_device);
+      pos = formatXMLString(buffer,size,pos,d->getDisplayName());
+      pos = formatBuffer_P(buffer,size,pos,snapshot_type);
+      pos = formatXMLString(buffer,size,pos,d->getType());
+      pos = formatBuffer_P(buffer,size,pos,snapshot_path);
+      pos = formatXMLString(buffer,size,pos,devicePath(d));
+      return formatBuffer_P(buffer,size,pos,snapshot_attribute_end);
+    });
+    Sensor*       s = (Sensor*)d->as(Sensor::classType());
+    RelayControl* r = (RelayControl*)d->as(RelayControl::classType());
+    if( s != NULL ) w.write([s](char buffer[], int size, int pos){return s->formatSnapshot(buffer,size,pos);});
+    else if( r != NULL ) w.write([r](char buffer[], int size, int pos){return r->formatSnapshot(buffer,size,pos);});
+    w.printf_P(snapshot_device_tail);
+  }
+  w.write([this](char buffer[], int size, int pos){return _discovery.formatStats(buffer,size,pos);});
+  w.printf_P(snapshot_tail);
 }
 
 void ExtendedDevice::nearbyDevices(WebContext* svr) {
-  
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
+  ChunkedWriter w(svr);
 
   IPAddress remote = svr->client().remoteIP();
   String ssidStr;
-  IPAddress ifc;
-  if(SSDP::isSoftAPIP(remote)) {
-    ssidStr = WiFi.softAPSSID();
-    ifc = WiFi.softAPIP();
-  }
-  else {
-    ssidStr = WiFi.SSID();
-    ifc = WiFi.localIP();
-  }
+  if(SSDP::isSoftAPIP(remote)) ssidStr = WiFi.softAPSSID();
+  else ssidStr = WiFi.SSID();
 
 /** Add HTML Title with Display Name
  */
   char nearbyTitle[50];
   snprintf(nearbyTitle,50,"Devices on %s",ssidStr.c_str());
-  int pos = formatHeader(buffer,size,nearbyTitle);
+  w.header(nearbyTitle);
 
-/** Search Subnet for nearby RootDevices
- *  
+/** Nearby RootDevices are rendered from the discovery cache, which searches on demand when it is stale
  */
-  char* buff = buffer;
-  int timeout = 3000;
-  SSDP::searchRequest("upnp:rootdevice",([buff,size,&pos](UPnPBuffer* b){
-       char name[32];
-       if( b->displayName(name,32) ) {
-           char loc[64];
-           if( b->headerValue_P(LocationHeader,loc,64) ) pos = formatBuffer_P(buff,size,pos,app_button,loc,name);                 
-       }  
-    }),ifc,timeout);
+  streamDiscovered(w);
    
 /** Add the HTML tail
  */ 
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.tail();
 }
 
 void ExtendedDevice::configForm(WebContext* svr) {
-  char buffer[1500];
-  int size = sizeof(buffer);
+  ChunkedWriter w(svr);
   
 /**
  *    Config Form HTML Start with Title
  */
   char title[50];
   snprintf(title,50,"Set %s Configuration",getDisplayName());
-  int pos = formatHeader(buffer,size,title);
+  w.header(title);
 
 /**
- *  Config Form Content
+ *  Config Form Content, rendered once per configuration
  */
-  char pathBuff[100];
-  getPath(pathBuff,100);
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100);
-  pos = formatBuffer_P(buffer,size,pos,ExtendedDevice_config_form,svcPath,getDisplayName(),pathBuff);
+  FragmentCache::shared()->write(w,this,FORM_FRAGMENT,_entityTag.config(),[this](char buffer[], int size, int pos) {
+    return formatBuffer_P(buffer,size,pos,ExtendedDevice_config_form,_paths.action,getDisplayName(),_paths.device);
+  });
 
 /**
  *  Config Form HTML Tail
  */
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);   
+  w.tail();
 }
 
 void ExtendedDevice::setup(WebContext* svr) {
+  if( _configStore != NULL ) _configStore->restore(this);
   RootDevice::setup(svr);
-  char pathBuffer[100];  
-  handlerPath(pathBuffer,100,"nearbyDevices");
-  svr->on(pathBuffer,[this](WebContext* svr){this->nearbyDevices(svr);});
-  pathBuffer[0] = '\0';
+  collectDeviceHeaders(svr);
+  PathTable::shared()->paths(_paths,this,setConfigurationSvc());
+  _nearbyPath = PathTable::shared()->handlerPath(this,"nearbyDevices");
+  FragmentCache::shared()->invalidate(this);
+  svr->on(_nearbyPath,HandlerMetrics::timed(_nearbyPath,[this](WebContext* svr){this->nearbyDevices(svr);}));
 }
 
 } // End of namespace lsc
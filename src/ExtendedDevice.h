@@ -27,11 +27,36 @@
 #include <WiFiUdp.h>
 #include <UPnPLib.h>
 #include "ConfigurationServices.h"
+#include "ChunkedWriter.h"
+#include "DiscoveryCache.h"
+#include "Control.h"
+#include "FragmentCache.h"
+#include "PathTable.h"
+#include "HandlerMetrics.h"
+#include "LoopProfiler.h"
+#include "TraceBuffer.h"
 
 /** Leelanau Software Company namespace 
 *  
 */
 namespace lsc {
+
+class ConfigStore;
+
+class GetSnapshot : public UPnPService {
+  public:
+    GetSnapshot() :  UPnPService("getSnapshot") {setDisplayName("Get Snapshot");};
+    GetSnapshot(const char* target) : UPnPService(target) {setDisplayName("Get Snapshot");};
+    virtual ~GetSnapshot() {}
+
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(GetSnapshot);         
+};
   
 /** ExtendedDevice is a Configurable RootDevice that provides SSDP Search capability for UPnPDevices on the
  *  same local network. Default configuration for ExtendedDevice allows for getting and setting display name.
@@ -54,6 +79,7 @@ class ExtendedDevice : public RootDevice {
       void               display(WebContext* svr);
       void               displayRoot(WebContext* svr);
       void               setup(WebContext* svr);
+      void               doDevice();
 
 /**
  *  Subclasses of ExtendedDevice with complex configutation should provide implementation for the following virtual methods:
@@ -77,15 +103,64 @@ class ExtendedDevice : public RootDevice {
  */
       SetConfiguration*  setConfigurationSvc()                     {return &_setConfiguration;}                        // Return setConfigutation Service
       GetConfiguration*  getConfigurationSvc()                     {return &_getConfiguration;}                        // Return getConfigutation Service
-      virtual void       handleSetConfiguration(WebContext* svr)   {_setConfiguration.handleSetConfiguration(svr);}    // Default form (submit) handler for set configuration
+      virtual void       handleSetConfiguration(WebContext* svr);                                                      // Default form (submit) handler sets the display name
       virtual void       handleGetConfiguration(WebContext* svr)   {_getConfiguration.handleGetConfiguration(svr);}    // Default HTTP handler for get configuration
       virtual void       configForm(WebContext* svr);
 
 /**
- *    Use UPnP SSDP protocol to search for nearby RootDevices enabled with SSDP.
- *    Responds with a Web Page of RootDevice buttons
+ *    Display nearby RootDevices enabled with SSDP as a Web Page of RootDevice buttons. Devices are found by 
+ *    the discovery cache, which searches on demand when it is stale.
  */
       virtual void    nearbyDevices(WebContext* svr);
+      DiscoveryCache* discovery()                                  {return &_discovery;}
+      EntityTag*      entityTag()                                  {return &_entityTag;}        // Configuration generation for getConfiguration
+      const DevicePaths& paths()                                   {return _paths;}             // Interned at setup(), see PathTable
+      static boolean  configGeneration(UPnPDevice* d, uint32_t& generation);                    // Configuration generation of a Sensor, Control, or ExtendedDevice
+
+/**
+ *    Persistent configuration: when a ConfigStore is set, setup() restores the configuration of this device and its
+ *    embedded devices before any of them register handlers, and doDevice() writes changes back. saveConfig() and
+ *    restoreConfig() supply the image of this device (display name by default), see Sensor.
+ */
+      void            configStore(ConfigStore* store)              {_configStore = store;}
+      ConfigStore*    configStore()                                {return _configStore;}
+      virtual int     saveConfig(uint8_t buffer[], int size);
+      virtual int     restoreConfig(const uint8_t* data, int len);
+
+/**
+ *    Composite root page: when set, displayRoot() writes each Control's content inline (Control::formatInlineContent())
+ *    instead of an iFrame, so the root page is a single request. Each inlined Control with an event stream holds a 
+ *    connection open while the page is shown, which counts against the TCP connection limit of the device.
+ */
+      void            inlineControls(boolean flag)                 {_inlineControls = flag;}
+      boolean         inlineControls()                             {return _inlineControls;}
+
+/**
+ *    State of every embedded device in a single XML response, streamed from one walk of the device list:
+ *       <snapshot name="..." uptime="secs"><device name="..." type="..." path="...">readings</device>...</snapshot>
+ *    Readings are Sensor::formatSnapshot() (every Sensor reading) or RelayControl::formatSnapshot() (relay state, 
+ *    and mode for a SensorControlledRelay). The snapshot ends with DiscoveryCache::formatStats(). Served by getSnapshotSvc().
+ */
+      virtual void    snapshot(WebContext* svr);
+      GetSnapshot*    getSnapshotSvc()                             {return &_getSnapshot;}
+
+/**
+ *    Call count, latency histogram, and response size of every HTTP handler (see HandlerMetrics) in Prometheus text 
+ *    format. Served by getMetricsSvc().
+ */
+      GetMetrics*     getMetricsSvc()                              {return &_getMetrics;}
+
+/**
+ *    Time spent in each part of the main loop and the worst iterations over budget (see LoopProfiler). Served by
+ *    getLoopProfileSvc().
+ */
+      GetLoopProfile* getLoopProfileSvc()                          {return &_getLoopProfile;}
+
+/**
+ *    Trace records of relay and timer events (see TraceBuffer), formatted and removed as they are sent. Served by
+ *    getTraceSvc().
+ */
+      GetTrace*       getTraceSvc()                                {return &_getTrace;}
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
@@ -106,9 +181,30 @@ class ExtendedDevice : public RootDevice {
  */
       DEFINE_EXCLUSIONS(ExtendedDevice);         
 
+      protected:
+
+/**
+ *    Stream embedded device content (a button for each device) or root content through a ChunkedWriter
+ */
+      void               streamContent(ChunkedWriter& w);
+      void               streamRootContent(ChunkedWriter& w);
+      void               streamDiscovered(ChunkedWriter& w);
+      static const char* devicePath(UPnPDevice* d);                             // Interned path of an embedded device
+
+      DiscoveryCache       _discovery;
+      boolean              _inlineControls = false;
+      ConfigStore*         _configStore    = NULL;
+
       private:
       GetConfiguration     _getConfiguration;
       SetConfiguration     _setConfiguration;
+      GetSnapshot          _getSnapshot;
+      GetMetrics           _getMetrics;
+      GetLoopProfile       _getLoopProfile;
+      GetTrace             _getTrace;
+      EntityTag            _entityTag;
+      DevicePaths          _paths;
+      const char*          _nearbyPath = "";
 
 };
 
@@ -0,0 +1,114 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "FragmentCache.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+FragmentCache* FragmentCache::shared() {
+  static FragmentCache cache;
+  return &cache;
+}
+
+/**
+ *  A hit is copied into the writer. On a miss f formats into the writer as usual and, if the fragment fit, the bytes
+ *  it wrote are copied into the cache. ChunkedWriter may call the format function twice (see ChunkedWriter::write()), 
+ *  only a complete fragment is stored.
+ */
+void FragmentCache::write(ChunkedWriter& w, const void* owner, uint8_t id, uint32_t generation, FormatFunction f) {
+  int         length = 0;
+  const char* data   = get(owner,id,generation,length);
+  if( data != NULL ) {
+    w.write([data,length](char buffer[], int size, int pos) {
+      if( pos + length >= size-1 ) return size;
+      memcpy(buffer+pos,data,length);
+      buffer[pos+length] = '\0';
+      return pos+length;
+    });
+    return;
+  }
+  w.write([this,owner,id,generation,&f](char buffer[], int size, int pos) {
+    int end = f(buffer,size,pos);
+    if( (end > pos) && (end < size-1) ) put(owner,id,generation,buffer+pos,end-pos);
+    return end;
+  });
+}
+
+const char* FragmentCache::get(const void* owner, uint8_t id, uint32_t generation, int& length) {
+  int i = indexOf(owner,id);
+  if( (i < 0) || (_entries[i].generation != generation) ) {
+    _misses++;
+    return NULL;
+  }
+  _hits++;
+  _entries[i].lastUsed = ++_tick;
+  length = _entries[i].length;
+  return _pool + _entries[i].offset;
+}
+
+/**
+ *  Replace any fragment with the same owner and id, then evict least recently used fragments until the new one fits.
+ *  Fragments larger than the pool are not stored.
+ */
+boolean FragmentCache::put(const void* owner, uint8_t id, uint32_t generation, const char* data, int length) {
+  if( (length <= 0) || (length > FRAGMENT_CACHE_SIZE) ) return false;
+  remove(indexOf(owner,id));
+  while( (_numEntries > 0) && ((_numEntries >= FRAGMENT_CACHE_ENTRIES) || (_used + length > FRAGMENT_CACHE_SIZE)) ) {
+    int lru = 0;
+    for( int i=1; i<_numEntries; i++ ) {if( _entries[i].lastUsed < _entries[lru].lastUsed ) lru = i;}
+    remove(lru);
+  }
+  memcpy(_pool+_used,data,length);
+  _entries[_numEntries++] = {owner,generation,++_tick,(uint16_t)_used,(uint16_t)length,id};
+  _used += length;
+  return true;
+}
+
+void FragmentCache::invalidate(const void* owner) {
+  for( int i=_numEntries-1; i>=0; i-- ) {if( _entries[i].owner == owner ) remove(i);}
+}
+
+int FragmentCache::indexOf(const void* owner, uint8_t id) {
+  for( int i=0; i<_numEntries; i++ ) {if( (_entries[i].owner == owner) && (_entries[i].id == id) ) return i;}
+  return -1;
+}
+
+/**
+ *  Close the gap in the pool so free space is always at the end
+ */
+void FragmentCache::remove(int i) {
+  if( (i < 0) || (i >= _numEntries) ) return;
+  int offset = _entries[i].offset;
+  int length = _entries[i].length;
+  memmove(_pool+offset,_pool+offset+length,_used-offset-length);
+  _used -= length;
+  for( int j=i; j<_numEntries-1; j++ ) {
+    _entries[j] = _entries[j+1];
+    _entries[j].offset -= length;
+  }
+  _numEntries--;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,115 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef FRAGMENT_CACHE_H
+#define FRAGMENT_CACHE_H
+
+#include <UPnPLib.h>
+#include "ChunkedWriter.h"
+
+/**
+ *   Byte budget and number of entries of the shared fragment cache. RAM is about 
+ *   FRAGMENT_CACHE_SIZE + 16*FRAGMENT_CACHE_ENTRIES bytes.
+ */
+#ifndef FRAGMENT_CACHE_SIZE
+#define FRAGMENT_CACHE_SIZE     3072
+#endif
+#ifndef FRAGMENT_CACHE_ENTRIES
+#define FRAGMENT_CACHE_ENTRIES  24
+#endif
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *   Fragment identifiers are per owner. Rows of a repeated form section use FORM_ROW_FRAGMENT + row.
+ */
+typedef enum FragmentId {
+  FORM_FRAGMENT      = 1,                 // Configuration form, or the part of it before any live value
+  FORM_TAIL_FRAGMENT = 2,                 // Configuration form after the live value(s)
+  BUTTON_FRAGMENT    = 3,                 // Device button on the root device list
+  ROOT_FRAGMENT      = 4,                 // Root content of a Control (title and iFrame)
+  FORM_ROW_FRAGMENT  = 16
+} FragmentId;
+
+typedef struct FragmentEntry {
+  const void*     owner;                  // Device the fragment belongs to
+  uint32_t        generation;             // Configuration generation the fragment was rendered at
+  uint32_t        lastUsed;               // Tick of the last hit, for LRU eviction
+  uint16_t        offset;                 // Position in the pool
+  uint16_t        length;
+  uint8_t         id;
+} FragmentEntry;
+
+/** FragmentCache keeps rendered page fragments that only depend on device configuration and paths (form markup, 
+ *  placeholders, action and cancel paths, device buttons) so repeat requests copy them instead of formatting 
+ *  PROGMEM templates and walking the device tree for paths. Fragments are keyed by owner, id and the owner's 
+ *  configuration generation (see EntityTag), so a configuration change makes old fragments unreachable; they age 
+ *  out through LRU eviction when the fixed pool is full. invalidate() drops an owner's fragments when its paths 
+ *  may have changed, which devices do from setup().
+ *  One cache, shared(), serves every device so the budget is fixed for the sketch.
+ *  Usage:
+ *      FragmentCache::shared()->write(w,this,FORM_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+ *        ...format the static part...
+ *        return pos;
+ *      });
+ */
+class FragmentCache {
+  public:
+    FragmentCache() {}
+
+    void              write(ChunkedWriter& w, const void* owner, uint8_t id, uint32_t generation, FormatFunction f);
+    const char*       get(const void* owner, uint8_t id, uint32_t generation, int& length);
+    boolean           put(const void* owner, uint8_t id, uint32_t generation, const char* data, int length);
+    void              invalidate(const void* owner);
+    void              clear()                    {_numEntries = 0; _used = 0;}
+
+    int               used()                     {return _used;}
+    int               numEntries()               {return _numEntries;}
+    uint32_t          hits()                     {return _hits;}
+    uint32_t          misses()                   {return _misses;}
+
+    static FragmentCache* shared();
+
+  private:
+    int               indexOf(const void* owner, uint8_t id);
+    void              remove(int i);
+
+    char              _pool[FRAGMENT_CACHE_SIZE];
+    FragmentEntry     _entries[FRAGMENT_CACHE_ENTRIES];      // In pool order
+    int               _numEntries = 0;
+    int               _used       = 0;
+    uint32_t          _tick       = 0;
+    uint32_t          _hits       = 0;
+    uint32_t          _misses     = 0;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(FragmentCache);
+};
+
+} // End of namespace lsc
+
+#endif
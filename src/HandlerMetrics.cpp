@@ -0,0 +1,132 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HandlerMetrics.h"
+#include "ChunkedWriter.h"
+#include "PathTable.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char metrics_duration_head[]  PROGMEM = "# HELP devicelib_handler_duration_seconds Time spent in HTTP handlers\n"
+                                              "# TYPE devicelib_handler_duration_seconds histogram\n";
+const char metrics_bucket[]         PROGMEM = "devicelib_handler_duration_seconds_bucket{path=\"%s\",le=\"%.3f\"} %lu\n";
+const char metrics_bucket_inf[]     PROGMEM = "devicelib_handler_duration_seconds_bucket{path=\"%s\",le=\"+Inf\"} %lu\n"
+                                              "devicelib_handler_duration_seconds_sum{path=\"%s\"} %.6f\n"
+                                              "devicelib_handler_duration_seconds_count{path=\"%s\"} %lu\n";
+const char metrics_bytes_head[]     PROGMEM = "# HELP devicelib_handler_response_bytes_total Response bytes sent by HTTP handlers\n"
+                                              "# TYPE devicelib_handler_response_bytes_total counter\n";
+const char metrics_bytes[]          PROGMEM = "devicelib_handler_response_bytes_total{path=\"%s\"} %lu\n";
+const char metrics_overflow[]       PROGMEM = "# HELP devicelib_handler_overflow_total Requests to handlers beyond the metrics table\n"
+                                              "# TYPE devicelib_handler_overflow_total counter\n"
+                                              "devicelib_handler_overflow_total %lu\n";
+
+/**
+ *  Static RTT initialization
+ */
+INITIALIZE_SERVICE_TYPES(GetMetrics,LeelanauSoftware-com,getMetrics,1.0.0);
+
+HandlerMetrics* HandlerMetrics::shared() {
+  static HandlerMetrics metrics;
+  return &metrics;
+}
+
+HandlerFunction HandlerMetrics::timed(const char* path, HandlerFunction f) {
+  return [path,f](WebContext* svr){HandlerScope scope(path); f(svr);};
+}
+
+HandlerFunction HandlerMetrics::timed(UPnPObject* obj, HandlerFunction f) {
+  return [obj,f](WebContext* svr){HandlerScope scope(obj); f(svr);};
+}
+
+/**
+ *  Entries are found by key with a linear search of the (small) table; an object key is interned to its path when
+ *  its entry is created
+ */
+void HandlerMetrics::record(const void* key, const char* path, UPnPObject* obj, uint32_t micros, uint32_t bytes) {
+  int i = 0;
+  for( ; (i<_size) && (_stats[i].key != key); i++ );
+  if( i == _size ) {
+    if( _size == METRICS_HANDLERS ) {
+      _overflow++;
+      return;
+    }
+    HandlerStats& s = _stats[_size++];
+    memset(&s,0,sizeof(HandlerStats));
+    s.key  = key;
+    s.path = ((path != NULL)?(path):(PathTable::shared()->path(obj)));
+  }
+  HandlerStats& s = _stats[i];
+  uint32_t ms = micros/1000;
+  int b = 0;
+  for( ; (b<METRICS_BUCKETS-1) && (ms >= (1UL << b)); b++ );
+  s.buckets[b]++;
+  s.count++;
+  s.bytes  += bytes;
+  s.micros += micros;
+}
+
+/**
+ *  Buckets are kept per range and made cumulative on output, as Prometheus expects
+ */
+void HandlerMetrics::send(WebContext* svr) {
+  ChunkedWriter w(svr,"text/plain; version=0.0.4");
+  w.printf_P(metrics_duration_head);
+  for( int i=0; i<_size; i++ ) {
+    const HandlerStats& s = _stats[i];
+    unsigned long total = 0;
+    for( int b=0; b<METRICS_BUCKETS-1; b++ ) {
+      total += s.buckets[b];
+      w.printf_P(metrics_bucket,s.path,(1UL << b)/1000.0,total);
+    }
+    w.printf_P(metrics_bucket_inf,s.path,(unsigned long)s.count,s.path,s.micros/1000000.0,s.path,(unsigned long)s.count);
+  }
+  w.printf_P(metrics_bytes_head);
+  for( int i=0; i<_size; i++ ) w.printf_P(metrics_bytes,_stats[i].path,(unsigned long)_stats[i].bytes);
+  w.printf_P(metrics_overflow,(unsigned long)_overflow);
+}
+
+void HandlerScope::begin() {
+  HandlerMetrics* m = HandlerMetrics::shared();
+  _outer = (m->_depth++ == 0);
+  if( _outer ) {
+    m->_bytes = 0;
+    _start    = micros();
+  }
+}
+
+HandlerScope::~HandlerScope() {
+  HandlerMetrics* m = HandlerMetrics::shared();
+  m->_depth--;
+  if( _outer ) m->record(_key,_path,_obj,micros() - _start,m->_bytes);
+}
+
+GetMetrics::GetMetrics() : UPnPService("getMetrics") {setDisplayName("Get Metrics");}
+
+void GetMetrics::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
+  HandlerMetrics::shared()->send(svr);
+}
+
+} // End of namespace lsc
@@ -0,0 +1,147 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef HANDLER_METRICS_H
+#define HANDLER_METRICS_H
+
+#include <UPnPLib.h>
+
+/**
+ *   Number of handlers tracked, and of latency buckets. Bucket i counts requests taking less than 2^i ms, the last
+ *   bucket everything slower. RAM is about METRICS_HANDLERS*(24 + 4*METRICS_BUCKETS) bytes.
+ */
+#ifndef METRICS_HANDLERS
+#define METRICS_HANDLERS   32
+#endif
+#define METRICS_BUCKETS    12
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct HandlerStats {
+  const void*     key;                                    // Handler path (svr->on), or the service or device object
+  const char*     path;                                   // Interned path for output
+  uint32_t        count;
+  uint32_t        bytes;                                  // Response bytes sent through ChunkedWriter or BinaryRecord
+  uint64_t        micros;                                 // Total time in the handler
+  uint32_t        buckets[METRICS_BUCKETS];
+} HandlerStats;
+
+/** HandlerMetrics records call count, latency histogram, and response size per HTTP handler in a fixed table.
+ *  A handler is measured by a HandlerScope for the duration of the request. Only the outermost scope records, so a
+ *  handler that renders through another (setConfiguration answering with display()) is counted once. Handlers
+ *  registered by this library are wrapped with timed(); services that override handleRequest() and device pages
+ *  open a HandlerScope themselves. Once the table is full, further handlers are counted in overflow() only.
+ *
+ *  The GetMetrics service dumps the table in Prometheus text format:
+ *      devicelib_handler_duration_seconds_bucket{path="/root/thermometer",le="0.001"} 0
+ *      ...
+ *      devicelib_handler_response_bytes_total{path="/root/thermometer"} 41234
+ *  Usage:
+ *      svr->on(_dryPath,HandlerMetrics::timed(_dryPath,[this](WebContext* svr){this->acquireDry(svr);}));
+ *      void GetTempHum::handleRequest(WebContext* svr) {HandlerScope scope(this); ...}
+ */
+class HandlerMetrics {
+  public:
+    HandlerMetrics() {}
+
+    void                    record(const void* key, const char* path, UPnPObject* obj, uint32_t micros, uint32_t bytes);
+    void                    sent(size_t bytes)             {if( _depth > 0 ) _bytes += bytes;}       // Response bytes of the current request
+    void                    send(WebContext* svr);                                                   // Prometheus text exposition
+
+    int                     size()                         {return _size;}
+    const HandlerStats*     stats(int i)                   {return (((i>=0)&&(i<_size))?(&_stats[i]):(NULL));}
+    uint32_t                overflow()                     {return _overflow;}
+
+    static HandlerFunction  timed(const char* path, HandlerFunction f);
+    static HandlerFunction  timed(UPnPObject* obj, HandlerFunction f);
+    static HandlerMetrics*  shared();
+
+  private:
+    friend class HandlerScope;
+    int                     _depth     = 0;                  // Open HandlerScopes
+    uint32_t                _bytes     = 0;                  // Bytes sent by the current request
+    int                     _size      = 0;
+    uint32_t                _overflow  = 0;
+    HandlerStats            _stats[METRICS_HANDLERS];
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(HandlerMetrics);
+};
+
+/**
+ *   Measures a request from construction to destruction. A path key must be a string that outlives the scope
+ *   (interned or literal); an object key is resolved to its path the first time it is recorded.
+ */
+class HandlerScope {
+  public:
+    HandlerScope(const char* path)   : _key(path), _path(path) {begin();}
+    HandlerScope(UPnPObject* obj)    : _key(obj), _obj(obj)    {begin();}
+    ~HandlerScope();
+
+  private:
+    void            begin();
+
+    const void*     _key;
+    const char*     _path   = NULL;
+    UPnPObject*     _obj    = NULL;
+    unsigned long   _start  = 0;
+    boolean         _outer  = false;
+};
+
+/**
+ *   GetMetrics is a UPnPService returning HandlerMetrics::shared() in Prometheus text format (text/plain; version=0.0.4)
+ */
+class GetMetrics : public UPnPService {
+  public:
+    GetMetrics();
+    virtual ~GetMetrics() {}
+
+    void handleRequest(WebContext* svr);
+
+/**
+ *   Macros to define the following Runtime and UPnP Type Info:
+ *     private: static const ClassType  _classType;
+ *     public:  static const ClassType* classType();
+ *     public:  virtual void*           as(const ClassType* t);
+ *     public:  virtual boolean         isClassType( const ClassType* t);
+ *     private: static const char*      _upnpType;
+ *     public:  static const char*      upnpType()
+ *     public:  virtual const char*     getType()
+ *     public:  virtual boolean         isType(const char* t)
+ */
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(GetMetrics);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,365 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HistoryLog.h"
+#include <stdio.h>
+#if defined(ESP8266) || defined(ESP32)
+#include <LittleFS.h>
+#endif
+
+#define SEGMENT_MAGIC     0x4C53         // "SL"
+#define SEGMENT_HEADER    20             // Header bytes, see HistoryLog.h for the layout
+#define SEGMENT_CRC       4
+#define SAMPLE_MAX        10             // Two varints of at most 5 bytes
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#if defined(ESP8266) || defined(ESP32)
+/**
+ *  LittleFS must be mounted (LittleFS.begin()) by the sketch. Files are opened per operation so nothing is held open
+ *  between segment writes.
+ */
+boolean FileStorage::append(const char* path, const uint8_t* data, size_t len) {
+  File f = LittleFS.open(path,"a");
+  if( !f ) return false;
+  size_t n = f.write(data,len);
+  f.close();
+  return (n == len);
+}
+
+long FileStorage::size(const char* path) {
+  if( !LittleFS.exists(path) ) return -1;
+  File f = LittleFS.open(path,"r");
+  if( !f ) return -1;
+  long result = f.size();
+  f.close();
+  return result;
+}
+
+int FileStorage::read(const char* path, size_t offset, uint8_t* data, size_t len) {
+  File f = LittleFS.open(path,"r");
+  if( !f ) return -1;
+  int n = (f.seek(offset)?(f.read(data,len)):(-1));
+  f.close();
+  return n;
+}
+
+boolean FileStorage::remove(const char* path) {return LittleFS.remove(path);}
+#else
+boolean FileStorage::append(const char* path, const uint8_t* data, size_t len) {
+  FILE* f = fopen(path,"ab");
+  if( f == NULL ) return false;
+  size_t n = fwrite(data,1,len,f);
+  fclose(f);
+  return (n == len);
+}
+
+long FileStorage::size(const char* path) {
+  FILE* f = fopen(path,"rb");
+  if( f == NULL ) return -1;
+  fseek(f,0,SEEK_END);
+  long result = ftell(f);
+  fclose(f);
+  return result;
+}
+
+int FileStorage::read(const char* path, size_t offset, uint8_t* data, size_t len) {
+  FILE* f = fopen(path,"rb");
+  if( f == NULL ) return -1;
+  int n = ((fseek(f,offset,SEEK_SET)==0)?((int)fread(data,1,len,f)):(-1));
+  fclose(f);
+  return n;
+}
+
+boolean FileStorage::remove(const char* path) {return (::remove(path) == 0);}
+#endif
+
+FileStorage* FileStorage::defaultStorage() {
+  static FileStorage storage;
+  return &storage;
+}
+
+HistoryLog::HistoryLog(const char* base, LogStorage* storage) : _base(base), _storage(storage) {
+  if( _storage == NULL ) _storage = FileStorage::defaultStorage();
+}
+
+void HistoryLog::path(int file, char buffer[]) {snprintf(buffer,HISTORY_PATH_SIZE,"%s.%d",_base,file);}
+
+/**
+ *  Read and validate the segment header at offset in file
+ */
+boolean HistoryLog::readHeader(int file, size_t offset, uint8_t header[]) {
+  char p[HISTORY_PATH_SIZE];
+  path(file,p);
+  if( _storage->read(p,offset,header,SEGMENT_HEADER) != SEGMENT_HEADER ) return false;
+  return ((get16(header) == SEGMENT_MAGIC) && (get16(header+2) <= HISTORY_SEGMENT_SIZE-SEGMENT_HEADER-SEGMENT_CRC));
+}
+
+/**
+ *  Only the newest file is scanned, and only its segment headers are read except for the last two segments, which
+ *  are decoded to recover the last sample time. If the newest file has no segment passing CRC, origin is recovered
+ *  from the file before it.
+ */
+boolean HistoryLog::begin() {
+  uint8_t  header[SEGMENT_HEADER];
+  uint32_t first[HISTORY_FILES];
+  int      newest   = -1;
+  int      previous = -1;
+  _file   = 0;
+  _seq    = 0;
+  _len    = 0;
+  _origin = 0;
+  for( int i=0; i<HISTORY_FILES; i++ ) {
+    if( !readHeader(i,0,header) ) continue;
+    first[i] = get32(header+8);
+    if( (newest < 0) || (first[i] >= first[newest]) ) {
+      previous = newest;
+      newest   = i;
+    }
+    else if( (previous < 0) || (first[i] >= first[previous]) ) previous = i;
+  }
+  if( newest < 0 ) return true;
+
+  long    size = 0;
+  size_t  end  = 0;
+  boolean torn = false;
+  _file = newest;
+  if( !recover(newest,size,end,torn) && (previous >= 0) ) {
+    long    s;
+    size_t  e;
+    boolean t;
+    recover(previous,s,e,t);
+  }
+
+/**
+ *  Anything past the last complete segment, or a last segment failing CRC, is a torn write; start a new file so 
+ *  later segments stay reachable
+ */
+  if( ((long)end != size) || torn ) {
+    char p[HISTORY_PATH_SIZE];
+    _file = (_file+1)%HISTORY_FILES;
+    path(_file,p);
+    _storage->remove(p);
+  }
+  return true;
+}
+
+/**
+ *  Scan the segment headers of file for complete segments, advancing the sequence number past them. end is the offset
+ *  following the last complete segment. Origin is taken from the last complete segment, or the one before it if the
+ *  last fails CRC, which sets torn. Returns true if origin was recovered.
+ */
+boolean HistoryLog::recover(int file, long& size, size_t& end, boolean& torn) {
+  uint8_t segment[HISTORY_SEGMENT_SIZE];
+  char    p[HISTORY_PATH_SIZE];
+  path(file,p);
+  size          = _storage->size(p);
+  size_t offset = 0;
+  size_t last[2];
+  int    complete = 0;
+  while( ((long)(offset+SEGMENT_HEADER+SEGMENT_CRC) <= size) && readHeader(file,offset,segment) ) {
+    size_t total = SEGMENT_HEADER + get16(segment+2) + SEGMENT_CRC;
+    if( (long)(offset+total) > size ) break;
+    if( get32(segment+8) >= _seq ) _seq = get32(segment+8) + 1;
+    last[1] = last[0];
+    last[0] = offset;
+    complete++;
+    offset += total;
+  }
+  end  = offset;
+  torn = false;
+  for( int i=0; (i<2) && (i<complete); i++ ) {
+    if( !readHeader(file,last[i],segment) ) continue;
+    int total = SEGMENT_HEADER + get16(segment+2) + SEGMENT_CRC;
+    if( (_storage->read(p,last[i],segment,total) == total) && (crc32(segment,total-SEGMENT_CRC) == get32(segment+total-SEGMENT_CRC)) ) {
+      decode(segment,0,0xFFFFFFFF,[this](uint32_t time, float){this->_origin = time + 1;});
+      return true;
+    }
+    torn = true;
+  }
+  return false;
+}
+
+void HistoryLog::startSegment(uint32_t time, float value) {
+  put16(_segment,SEGMENT_MAGIC);
+  put16(_segment+2,0);
+  put16(_segment+4,1);
+  put16(_segment+6,0);
+  put32(_segment+8,_seq);
+  put32(_segment+12,time);
+  put32(_segment+16,floatBits(value));
+  _len       = SEGMENT_HEADER;
+  _count     = 1;
+  _lastTime  = time;
+  _lastDelta = 0;
+  _lastBits  = floatBits(value);
+}
+
+void HistoryLog::append(uint32_t time, float value) {
+  if( (_len > 0) && ((_len+SAMPLE_MAX+SEGMENT_CRC > HISTORY_SEGMENT_SIZE) || (_count == 0xFFFF)) ) flush();
+  if( _len == 0 ) {
+    startSegment(time,value);
+    return;
+  }
+
+  int32_t  delta = (int32_t)(time - _lastTime);
+  int32_t  dod   = delta - _lastDelta;
+  uint32_t bits  = floatBits(value);
+  _len += putVarint(_segment+_len,(((uint32_t)dod) << 1) ^ ((uint32_t)(dod >> 31)));
+  _len += putVarint(_segment+_len,bits ^ _lastBits);
+  _count++;
+  _lastTime  = time;
+  _lastDelta = delta;
+  _lastBits  = bits;
+  put16(_segment+2,_len-SEGMENT_HEADER);
+  put16(_segment+4,_count);
+  if( (time - get32(_segment+12)) >= HISTORY_FLUSH_INTERVAL ) flush();
+}
+
+/**
+ *  Seal the open segment with its CRC and append it with a single write. When the current file would exceed
+ *  HISTORY_FILE_SIZE the next file in the ring is truncated and becomes current.
+ */
+void HistoryLog::flush() {
+  if( _len == 0 ) return;
+  put32(_segment+8,_seq);
+  put32(_segment+_len,crc32(_segment,_len));
+  size_t total = _len + SEGMENT_CRC;
+
+  char p[HISTORY_PATH_SIZE];
+  path(_file,p);
+  long size = _storage->size(p);
+  if( (size > 0) && ((size_t)size + total > HISTORY_FILE_SIZE) ) {
+    _file = (_file+1)%HISTORY_FILES;
+    path(_file,p);
+    _storage->remove(p);
+  }
+  _storage->append(p,_segment,total);
+  _seq++;
+  _len = 0;
+}
+
+/**
+ *  Stream samples oldest first: files in sequence order, then the open segment
+ */
+int HistoryLog::read(uint32_t from, uint32_t to, SampleFunction f) {
+  uint8_t  header[SEGMENT_HEADER];
+  int      files[HISTORY_FILES];
+  uint32_t seqs[HISTORY_FILES];
+  int      numFiles = 0;
+  for( int i=0; i<HISTORY_FILES; i++ ) {
+    if( !readHeader(i,0,header) ) continue;
+    int j = numFiles++;
+    for( ; (j>0) && (seqs[j-1] > get32(header+8)); j-- ) {files[j] = files[j-1]; seqs[j] = seqs[j-1];}
+    files[j] = i;
+    seqs[j]  = get32(header+8);
+  }
+
+  int result = 0;
+  for( int i=0; i<numFiles; i++ ) result += readFile(files[i],from,to,f);
+  if( _len > 0 ) result += decode(_segment,from,to,f);
+  return result;
+}
+
+int HistoryLog::readFile(int file, uint32_t from, uint32_t to, SampleFunction f) {
+  uint8_t segment[HISTORY_SEGMENT_SIZE];
+  char    p[HISTORY_PATH_SIZE];
+  path(file,p);
+  long   size   = _storage->size(p);
+  size_t offset = 0;
+  int    result = 0;
+  while( ((long)(offset+SEGMENT_HEADER+SEGMENT_CRC) <= size) && readHeader(file,offset,segment) ) {
+    int total = SEGMENT_HEADER + get16(segment+2) + SEGMENT_CRC;
+    if( _storage->read(p,offset,segment,total) != total ) break;
+    if( crc32(segment,total-SEGMENT_CRC) == get32(segment+total-SEGMENT_CRC) ) result += decode(segment,from,to,f);
+    offset += total;
+  }
+  return result;
+}
+
+int HistoryLog::decode(const uint8_t* segment, uint32_t from, uint32_t to, SampleFunction f) {
+  const uint8_t* p     = segment + SEGMENT_HEADER;
+  const uint8_t* end   = p + get16(segment+2);
+  uint16_t       count = get16(segment+4);
+  uint32_t       time  = get32(segment+12);
+  uint32_t       bits  = get32(segment+16);
+  int32_t        delta = 0;
+  int            result = 0;
+  for( uint16_t i=0; i<count; i++ ) {
+    if( i > 0 ) {
+      uint32_t zz, x;
+      int n = getVarint(p,end,zz);
+      if( n == 0 ) break;
+      p += n;
+      n = getVarint(p,end,x);
+      if( n == 0 ) break;
+      p += n;
+      delta += (int32_t)((zz >> 1) ^ (0 - (zz & 1)));
+      time  += delta;
+      bits  ^= x;
+    }
+    if( (time >= from) && (time <= to) ) {
+      f(time,bitsFloat(bits));
+      result++;
+    }
+  }
+  return result;
+}
+
+int HistoryLog::putVarint(uint8_t* p, uint32_t v) {
+  int n = 0;
+  while( v >= 0x80 ) {
+    p[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+/**
+ *  Returns the number of bytes consumed, or 0 if the varint is truncated
+ */
+int HistoryLog::getVarint(const uint8_t* p, const uint8_t* end, uint32_t& v) {
+  v = 0;
+  for( int n=0; (n<5) && (p+n<end); n++ ) {
+    v |= ((uint32_t)(p[n] & 0x7F)) << (7*n);
+    if( (p[n] & 0x80) == 0 ) return n+1;
+  }
+  return 0;
+}
+
+/**
+ *  CRC-32 (IEEE 802.3), bitwise to avoid a 1K table
+ */
+uint32_t HistoryLog::crc32(const uint8_t* data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  for( size_t i=0; i<len; i++ ) {
+    crc ^= data[i];
+    for( int k=0; k<8; k++ ) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+} // End of namespace lsc
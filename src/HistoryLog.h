@@ -0,0 +1,172 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+/**
+ *   HistoryLog only depends on the Arduino core for LittleFS, so it can also be compiled on a host against stdio
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+typedef bool boolean;
+#endif
+#include <functional>
+
+/**
+ *   A segment is the unit of write: samples are compressed into a RAM segment of HISTORY_SEGMENT_SIZE bytes
+ *   (a flash page) and written with a single append when it is full. Segments are appended to HISTORY_FILES
+ *   files used as a ring, each at most HISTORY_FILE_SIZE bytes, so the log occupies at most
+ *   HISTORY_FILES*HISTORY_FILE_SIZE bytes of flash (256K with the defaults).
+ */
+#ifndef HISTORY_SEGMENT_SIZE
+#define HISTORY_SEGMENT_SIZE   256
+#endif
+#ifndef HISTORY_FILE_SIZE
+#define HISTORY_FILE_SIZE      65536
+#endif
+#ifndef HISTORY_FILES
+#define HISTORY_FILES          4
+#endif
+
+/**
+ *   A partial segment is also written once it spans HISTORY_FLUSH_INTERVAL seconds of log time, so a reboot loses
+ *   at most that much history. At one sample a minute this is one flash write per 15 minutes.
+ */
+#ifndef HISTORY_FLUSH_INTERVAL
+#define HISTORY_FLUSH_INTERVAL 900
+#endif
+#define HISTORY_PATH_SIZE      32
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef std::function<void(uint32_t,float)> SampleFunction;
+
+/**
+ *   Minimal append-only file interface used by HistoryLog. FileStorage implements it on LittleFS for ESP8266/ESP32
+ *   and on stdio elsewhere, so a HistoryLog can be exercised on Linux against plain files.
+ */
+class LogStorage {
+  public:
+    virtual ~LogStorage() {}
+    virtual boolean   append(const char* path, const uint8_t* data, size_t len) = 0;
+    virtual long      size(const char* path) = 0;                                        // Returns -1 if the file does not exist
+    virtual int       read(const char* path, size_t offset, uint8_t* data, size_t len) = 0;
+    virtual boolean   remove(const char* path) = 0;
+};
+
+class FileStorage : public LogStorage {
+  public:
+    boolean           append(const char* path, const uint8_t* data, size_t len);
+    long              size(const char* path);
+    int               read(const char* path, size_t offset, uint8_t* data, size_t len);
+    boolean           remove(const char* path);
+
+    static FileStorage* defaultStorage();
+};
+
+/** HistoryLog is an append-only, segment based, compressed log of (time, value) samples.
+ *
+ *  Segment layout (little-endian):
+ *      magic u16, payload length u16, sample count u16, flags u16, sequence u32, first time u32, first value u32,
+ *      payload, CRC32 u32 (over header and payload)
+ *  The first sample is stored in the header; each following sample is the zigzag varint of its delta-of-delta time
+ *  followed by the varint of its value bits XOR the previous value bits. Slowly changing readings at a fixed rate
+ *  take 2-4 bytes per sample.
+ *
+ *  Files are named <base>.0 .. <base>.(HISTORY_FILES-1). On begin() the first segment header of each file is read
+ *  to find the newest file, and only that file's segment headers are scanned to recover the next sequence number and
+ *  the time of the last sample (see origin()). A torn segment at the end of the newest file (cut short, or failing
+ *  CRC) moves appends to the next file. Reads stream one segment at a time through a HISTORY_SEGMENT_SIZE buffer; segments failing CRC are skipped.
+ *
+ *  Time is in seconds and is chosen by the caller. Because uptime restarts at 0, SensorHistory logs origin() + uptime,
+ *  which keeps log time monotonic across reboots (time while powered off is not counted).
+ *
+ *  Usage (LittleFS must be mounted by the sketch first):
+ *      HistoryLog tempLog("/temp");
+ *      tempLog.begin();
+ *      thermometer.history(0)->log(&tempLog);
+ */
+class HistoryLog {
+  public:
+    HistoryLog(const char* base, LogStorage* storage = NULL);
+    virtual ~HistoryLog() {}
+
+    boolean          begin();                                                   // Recover log state, call once at startup
+    uint32_t         origin()                  {return _origin;}                // Time following the last sample recovered by begin()
+    void             append(uint32_t time, float value);                        // Append a sample, written when the segment is full or old
+    void             flush();                                                   // Write the current (partial) segment now
+    int              read(uint32_t from, uint32_t to, SampleFunction f);        // Stream samples in [from,to], returns the number of samples
+    uint32_t         segments()                {return _seq;}                   // Number of segments written
+
+    static uint32_t  crc32(const uint8_t* data, size_t len, uint32_t crc = 0);  // CRC-32 (IEEE), chained through crc
+
+  protected:
+    void             path(int file, char buffer[]);
+    boolean          readHeader(int file, size_t offset, uint8_t header[]);
+    boolean          recover(int file, long& size, size_t& end, boolean& torn);
+    int              readFile(int file, uint32_t from, uint32_t to, SampleFunction f);
+    void             startSegment(uint32_t time, float value);
+    int              decode(const uint8_t* segment, uint32_t from, uint32_t to, SampleFunction f);
+
+    static int       putVarint(uint8_t* p, uint32_t v);
+    static int       getVarint(const uint8_t* p, const uint8_t* end, uint32_t& v);
+    static void      put16(uint8_t* p, uint16_t v)          {p[0] = v; p[1] = v >> 8;}
+    static void      put32(uint8_t* p, uint32_t v)          {put16(p,v); put16(p+2,v >> 16);}
+    static uint16_t  get16(const uint8_t* p)                {return p[0] | (p[1] << 8);}
+    static uint32_t  get32(const uint8_t* p)                {return get16(p) | ((uint32_t)get16(p+2) << 16);}
+    static uint32_t  floatBits(float f)                     {uint32_t b; memcpy(&b,&f,4); return b;}
+    static float     bitsFloat(uint32_t b)                  {float f; memcpy(&f,&b,4); return f;}
+
+    const char*      _base;
+    LogStorage*      _storage;
+    int              _file      = 0;                       // File currently appended to
+    uint32_t         _seq       = 0;                       // Sequence number of the next segment
+    uint32_t         _origin    = 0;
+
+/**
+ *   Segment under construction
+ */
+    uint8_t          _segment[HISTORY_SEGMENT_SIZE];
+    int              _len       = 0;                       // Bytes used in _segment, 0 if no segment is open
+    uint16_t         _count     = 0;
+    uint32_t         _lastTime  = 0;
+    int32_t          _lastDelta = 0;
+    uint32_t         _lastBits  = 0;
+
+/**
+ *   Copy construction and assignment are not allowed (UPnPLib, and so DEFINE_EXCLUSIONS, is not available on a host)
+ */
+    HistoryLog(const HistoryLog&)            = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+};
+
+} // End of namespace lsc
+
+#endif
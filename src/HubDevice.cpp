@@ -21,22 +21,11 @@
  */
  
 #include "HubDevice.h"
-#include <UPnPBuffer.h>
 
 namespace lsc {
 
-const char SSDP_RootSearch[]            PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
-                                                  "HOST: 239.255.255.250:1900\r\n"
-                                                  "MAN: ssdp:discover\r\n"
-                                                  "ST: upnp:rootdevice\r\n"
-                                                  "ST.LEELANAUSOFTWARE.COM: \r\n"
-                                                  "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
-const char LocationHeader[]             PROGMEM = "LOCATION";
 const char display_html[]               PROGMEM = "<H3 align=\"center\">Devices on %s</H3><br>";
 const char brk_html[]                   PROGMEM = "<br><brk>";   
-   
-#define SSDP_BUFFER_SIZE 1000
-#define DESC_HEADER_SIZE 150
 
 /**
  *  Static RTT initialization
@@ -46,47 +35,37 @@ INITIALIZE_DEVICE_TYPES(HubDevice,LeelanauSoftware-com,HubDevice,1.0.0);
 
 HubDevice::HubDevice() : ExtendedDevice("hub") {
   setDisplayName("Device Hub");
+  discovery()->background(true);
+  discovery()->passive(true);
 }
 
 HubDevice::HubDevice(const char* target) : ExtendedDevice(target) {
   setDisplayName("Device Hub");
+  discovery()->background(true);
+  discovery()->passive(true);
 }
 
 void HubDevice::displayRoot(WebContext* svr) {
-  
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
+  HandlerScope scope("/");
+  ChunkedWriter w(svr);
       
 /** Add HTML Header and Title with Display Name
  */
-  int pos = formatHeader(buffer,size,getDisplayName());
-  pos = formatBuffer_P(buffer,size,pos,display_html,WiFi.SSID().c_str());
+  w.header(getDisplayName());
+  w.printf_P(display_html,WiFi.SSID().c_str());
 
 /** 
- *  Search for nearby RootDevices. As each one is parsed (content filled into a UPnPBuffer), create a button with link
- *  to location of the RootDevice.
+ *  A button for each RootDevice in the discovery cache, with link to location of the RootDevice. The cache is
+ *  refreshed in the background from doDevice() so there is no wait on SSDP here.
  */
-  char* buff = buffer;
-  SSDP::searchRequest("upnp:rootdevice",([buff,size,&pos](UPnPBuffer* b){
-       char name[32];
-       if( b->displayName(name,32) ) {
-           char loc[128];
-/**
- *         If a LOCATION header is present on the Search Reply, copy it to the loc buffer then add an app_button with location.
- *         Otherwise add an app_button with "/" as location (which just redirects to the display).
- */
-           if( b->headerValue_P(LocationHeader,loc,128) ) pos = formatBuffer_P(buff,size,pos,app_button,loc,name);
-           else pos = formatBuffer_P(buff,size,pos,app_button,"/",name);     
-       }  
-    }),WiFi.localIP());
+  streamDiscovered(w);
 
-  pos = formatBuffer_P(buffer,size,pos,brk_html);
-  pos = formatRootContent(buffer,size,pos);
+  w.printf_P(brk_html);
+  streamRootContent(w);
 
 /** Add the HTML tail
  */ 
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.tail();
 }
 
 } // End of namespace lsc
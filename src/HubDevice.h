@@ -34,6 +34,8 @@ namespace lsc {
 /** HubDevice is a turnkey UPnPDevice that keeps track of other RootDevices on the local network.
  *
  *  The displayRoot() method, set on '/', will display all RootDevices as HTML buttons.
+ *  RootDevices are tracked passively from ssdp:alive and ssdp:byebye announcements and expire by their
+ *  CACHE-CONTROL max-age; an active search is only sent when the roster is cold (see DiscoveryCache).
  *  Configuration for HubDevice is that of ExtendedDevice
  *  
  */
@@ -27,27 +27,27 @@
 */
 namespace lsc {
 
-const char threshold_setting[] PROGMEM = "<div align=\"center\">Threshold Set To %d%%</div>";
-const char humidity_display[]  PROGMEM = "<div align=\"center\">Humidity is %.1f%%</div>";
+const char threshold_setting[] PROGMEM = "<div align=\"center\" data-ev=\"mode\" data-show=\"AUTOMATIC\"%s>Threshold Set To %d%%</div>";
+const char humidity_display[]  PROGMEM = "<div align=\"center\">Humidity is <span data-ev=\"humidity\">%.1f</span>%%</div>";
 
 /**
  *    Variable input to form is service action url, display name placeholder, threshold placeholder, cancel url
  */
-const char HumidityFan_config_form[]     PROGMEM = "<form action=\"%s\"><div align=\"center\">"
-                                         "<label for=\"displayName\">Sensor Name:</label>&emsp;"
-                                         "<input type=\"text\" placeholder=\"%s\" name=\"displayName\">&emsp;&emsp;&emsp;&emsp;&emsp;&emsp;&emsp;<br><br>"
-                                         "<label for=\"threshold\">Humidity Threshold:</label>&emsp;"
-                                         "<input type=\"text\" id=\"threshold\" placeholder=\"%d\" name=\"threshold\" pattern=\"[0-9]{2}\">&ensp;(between 0 and 99)<br><br>"
-                                         "<div align=\"center\">Humidity is %.1f%%</div><br>"
-                                         "<button class=\"fmButton\" type=\"submit\">Submit</button>&nbsp&nbsp"
-                                         "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button>" 
-                                         "</div></form>";
-                                      
-const char HumidityFan_config_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-                                                      "<config>"
-                                                         "<displayName>%s</displayName>"
-                                                         "<threshold>%d</threshold>"
-                                                      "</config>";
+/**
+ *   The form is split around the live humidity reading so the parts before and after it can be cached
+ */
+const char HumidityFan_config_humidity[] PROGMEM = "<div align=\"center\">Humidity is %.1f%%</div><br>";
+
+/**
+ *  Configuration: display name and humidity threshold (%)
+ */
+const char HumidityFan_threshold[]       PROGMEM = "threshold";
+const char HumidityFan_threshold_label[] PROGMEM = "Humidity Threshold";
+constexpr ConfigField HumidityFan_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(HumidityFan,sensor_name_label),
+  CONFIG_INT(HumidityFan,HumidityFan_threshold,HumidityFan_threshold_label,1,99,threshold(),threshold(v))
+};
+constexpr ConfigSchema HumidityFan_schema(HumidityFan_fields,sizeof(HumidityFan_fields)/sizeof(ConfigField));
 
 /**
  *  Static RTT and UPnP Type initialization
@@ -65,7 +65,7 @@ HumidityFan::HumidityFan(const char* target) : SensorControlledRelay(target) {
 int  HumidityFan::formatContent(char buffer[], int size, int pos) { 
   pos = SensorControlledRelay::formatContent(buffer,size,pos);
   pos =  formatBuffer_P(buffer,size,pos,humidity_display,humidity());
-  if( isAUTOMATIC() )  pos = formatBuffer_P(buffer,size,pos,threshold_setting,threshold()); 
+  pos = formatBuffer_P(buffer,size,pos,threshold_setting,((isAUTOMATIC())?(""):(" style=\"display:none\"")),threshold()); 
   return pos;     
 }
 
@@ -77,6 +77,9 @@ ControlState HumidityFan::sensorState() {
   ControlState result = lastSensorState();
   Thermometer* t = getThermometer();
   if ( t != NULL ) humidity(t->hum());
+  char value[16];
+  snprintf(value,16,"%.1f",humidity());
+  _events.set("humidity",value);
   float delta = humidity() - (float)threshold();
   if( delta > 0.5 ) result = ON;
   else if( delta < -0.5 ) result = OFF;
@@ -84,50 +87,39 @@ ControlState HumidityFan::sensorState() {
 }
 
 void HumidityFan::configForm(WebContext* svr) {
-  char buffer[1000];
-  int size = sizeof(buffer);
+  ChunkedWriter w(svr);
   
 /**
  *    Config Form HTML Start with Title
  */
-  int pos = formatHeader(buffer,size,"Control Configuration");
+  w.header("Control Configuration");
 
 /**
- *  Config Form Content
+ *  Config Form Content, static parts rendered once per configuration
  */ 
-  char pathBuff[100];
-  getPath(pathBuff,100);
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100);
-  pos = formatBuffer_P(buffer,size,pos,HumidityFan_config_form,svcPath,getDisplayName(),threshold(),humidity(),pathBuff);
+  FragmentCache* cache = FragmentCache::shared();
+  cache->write(w,this,FORM_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+    pos = ConfigSchema::formatFormHead(buffer,size,pos,paths().action);
+    return HumidityFan_schema.formatFields(buffer,size,pos,this);
+  });
+  w.printf_P(HumidityFan_config_humidity,humidity());
+  cache->write(w,this,FORM_TAIL_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+    return ConfigSchema::formatFormTail(buffer,size,pos,paths().device);
+  });
 
 /**
  *  Config Form HTML Tail
  */
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer); 
+  w.tail();
 }
 
 void HumidityFan::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
-     if( argName.equalsIgnoreCase("THRESHOLD") ) {
-        int t = (int) arg.toInt();
-        if( t > 0 ) threshold(t);
-     }
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
-  }
+  if( HumidityFan_schema.parse(svr,this) > 0 ) entityTag()->touchConfig();
   display(svr);  
 }
 
-void HumidityFan::handleGetConfiguration(WebContext* svr) {
-  char buffer[1000];
-  size_t bufferSize = sizeof(buffer);
-  int size = bufferSize;
-  snprintf_P(buffer,size,HumidityFan_config_template,getDisplayName(),threshold());
-  svr->send(200, "text/xml", buffer);     
-}
+void HumidityFan::handleGetConfiguration(WebContext* svr) {HumidityFan_schema.send(svr,this);}
+
+const ConfigSchema* HumidityFan::configSchema() {return &HumidityFan_schema;}
 
 } // End of namespace lsc
\ No newline at end of file
@@ -61,8 +61,8 @@ class HumidityFan : public SensorControlledRelay {
       void             threshold(int threshold)        {_threshold = ((threshold>0)?(threshold):(_threshold));}
 
 /**
- *    SensorControlledRelay will poll for Sensor state every 5 secs by default, which should not
- *    overwhelm the Thermometer.
+ *    SensorControlledRelay will poll for Sensor state every 5 secs by default; humidity is read from
+ *    the Thermometer's cached sample so the poll never waits on the DHT22.
  */
       virtual ControlState  sensorState();
 
@@ -87,6 +87,7 @@ class HumidityFan : public SensorControlledRelay {
       void             configForm(WebContext* svr);                 // Config form display
       void             handleSetConfiguration(WebContext* svr);     // HTTP handler for setConfiguration Service - set on configForm
       void             handleGetConfiguration(WebContext* svr);     // HTTP Handler for getConfiguration Service
+      const ConfigSchema* configSchema();                           // Display name and threshold
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
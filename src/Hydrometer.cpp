@@ -30,27 +30,24 @@ const char Hydrometer_template[]         PROGMEM = "<?xml version=\"1.0\" encodi
                                           "<Hydrometer>"
                                               "<soilMoisture>%f</soilMoisture>"
                                           "</Hydrometer>";
-const char Hydrometer_config_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-                                          "<config>"
-                                             "<displayName>%s</displayName>"
-                                             "<drySensor>%d</drySensor>"
-                                             "<wetSensor>%d</wetSensor>"
-                                          "</config>";
-const char Hydrometer_config_form[]      PROGMEM = "<form action=\"%s\">"                                                                                 // Service path
-            "<div align=\"center\">"
-              "<label for=\"displayName\">Sensor Name &nbsp &nbsp </label>"
-              "<input type=\"text\" placeholder=\"%s\" name=\"displayName\"><br><br><br>"                                                                 // Display name
-              "<H2>Calibration</H2><br>"
-              "<label for=\"drySensor\">Dry Sensor &nbsp &nbsp</label>"
-              "<input type=\"number\" name=\"drySensor\" min=\"0\" max=\"1000\" align=\"right\" style=\"width:3.1em\" maxlength=\"4\" value=\"%d\">"      // Air      
-              "&nbsp &nbsp &nbsp <a style=\"text-decoration:none\" href=\"%s\"><button class=\"fmButton\" type=\"button\">Acquire</button></a><br><br>"   // handler path
-              "<label for=\"wetSensor\">Wet Sensor &nbsp </label>"
-              "<input type=\"number\" name=\"wetSensor\" min=\"0\" max=\"1000\" align=\"right\" style=\"width:3.1em\" maxlength=\"4\" value=\"%d\">"      // Water
-              "&nbsp &nbsp &nbsp <a style=\"text-decoration:none\" href=\"%s\"><button class=\"fmButton\" type=\"button\">Acquire</button></a><br><br>"   // handler path
-              "<button class=\"fmButton\" type=\"submit\">Submit</button>&nbsp&nbsp"
-              "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button>"                                       // Cancel path
-            "</div></form>";
+const char Hydrometer_json[]             PROGMEM = "{\"soilMoisture\":%.2f}";
 
+/**
+ *  Configuration: display name and calibration boundaries. The form adds an Acquire button (handler path) after each
+ *  boundary and shows acquired values in place of the stored ones.
+ */
+const char Hydrometer_drySensor[]        PROGMEM = "drySensor";
+const char Hydrometer_drySensor_label[]  PROGMEM = "Dry Sensor";
+const char Hydrometer_wetSensor[]        PROGMEM = "wetSensor";
+const char Hydrometer_wetSensor_label[]  PROGMEM = "Wet Sensor";
+constexpr ConfigField Hydrometer_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(Hydrometer,sensor_name_label),
+  CONFIG_INT(Hydrometer,Hydrometer_drySensor,Hydrometer_drySensor_label,1,999,air(),air(v)),
+  CONFIG_INT(Hydrometer,Hydrometer_wetSensor,Hydrometer_wetSensor_label,1,999,water(),water(v))
+};
+constexpr ConfigSchema Hydrometer_schema(Hydrometer_fields,sizeof(Hydrometer_fields)/sizeof(ConfigField));
+const char Hydrometer_calibration[]      PROGMEM = "<br><br><br><H2>Calibration</H2><br>";
+const char Hydrometer_acquire[]          PROGMEM = "&nbsp &nbsp &nbsp <a style=\"text-decoration:none\" href=\"%s\"><button class=\"fmButton\" type=\"button\">Acquire</button></a><br><br>";
 
 /**
  *  Static RTT initialization
@@ -59,29 +56,48 @@ INITIALIZE_SERVICE_TYPES(GetSoilMoisture,LeelanauSoftware-com,getSoilMoisture,1.
 INITIALIZE_DEVICE_TYPES(Hydrometer,LeelanauSoftware-com,Hydrometer,1.0.0);
 
 GetSoilMoisture::GetSoilMoisture() : UPnPService("getSoilMoisture") {setDisplayName("Get Soil Moisture");};
+/**
+ *  Response format is negotiated, see contentFormat()
+ */
 void GetSoilMoisture::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
   Hydrometer* h = (Hydrometer*)GET_PARENT_AS(Hydrometer::classType());
   char buffer[256];
-  int result = 200;
-  if( h != NULL ) {
-    float m = h->soilMoisture();
-    snprintf_P(buffer,256,Hydrometer_template,m);
-  }
-  else {
-    result = 500;
+  if( h == NULL ) {
     snprintf_P(buffer,128,error_html,"Hydrometer");
+    svr->send(500,"text/html",buffer); 
+    return;
+  }
+
+  ContentFormat format = contentFormat(svr);
+  float m = h->soilMoisture();
+  if( format == BINARY_FORMAT ) {
+    BinaryRecord r(SOILMOISTURE_RECORD);
+    r.put16((uint16_t)lroundf(((m<0.0f)?(0.0f):(m))*100.0f));
+    r.put16(h->reading());
+    r.put16(h->air());
+    r.put16(h->water());
+    r.send(svr);
+    return;
   }
-  svr->send(200,"text/xml",buffer); 
+  snprintf_P(buffer,256,((format==JSON_FORMAT)?(Hydrometer_json):(Hydrometer_template)),m);
+  svr->send(200,contentType(format),buffer); 
 }
 
-Hydrometer::Hydrometer() : Sensor("hydrometer") {
-  addServices(&_getSoilMoisture);
+Hydrometer::Hydrometer() : Sensor("hydrometer"), _history("soilMoisture","%") {
+  addServices(&_getSoilMoisture,historySvc(),eventSvc());
+  _events.moderation(SENSOR_EVENT_MODERATION*1000UL);
   setDisplayName("Hydrometer");
+  _timer.set(HYD_SAMPLE_INTERVAL);
+  _timer.setHandler([this]{this->timerCallback();});
 }
 
-Hydrometer::Hydrometer(const char* target) : Sensor(target) {
-  addServices(&_getSoilMoisture);
+Hydrometer::Hydrometer(const char* target) : Sensor(target), _history("soilMoisture","%") {
+  addServices(&_getSoilMoisture,historySvc(),eventSvc());
+  _events.moderation(SENSOR_EVENT_MODERATION*1000UL);
   setDisplayName("Hydrometer");
+  _timer.set(HYD_SAMPLE_INTERVAL);
+  _timer.setHandler([this]{this->timerCallback();});
 }
 
 int Hydrometer::pin() {
@@ -95,21 +111,74 @@ void Hydrometer::pin(int p) {
 }
 
 int Hydrometer::formatContent(char buffer[], int size, int pos) {
-  int ar = analogRead(A0);
+  int ar = reading();
   float sm = soilMoisture(ar);
   pos = formatBuffer_P(buffer,size,pos,Hydrometer_body,sm,ar);  
   return pos;
 }
 
 int Hydrometer::formatRootContent(char buffer[], int size, int pos) {
-  float sm = soilMoisture(analogRead(A0));
+  float sm = soilMoisture(reading());
   pos = formatBuffer_P(buffer,size,pos,Hydrometer_root_body,sm);  
   return pos;
 }
 
 float Hydrometer::soilMoisture() {
-  int ar = analogRead(A0);
-  return soilMoisture(ar);
+  return soilMoisture(reading());
+}
+
+/**
+ *  Take one raw sample into the ring and fold the median of the ring into the EMA; every HYD_PUBLISH_SAMPLES
+ *  samples the filtered value is published
+ */
+void Hydrometer::sample() {
+  _samples[_next] = analogRead(_pin);
+  _next = (_next+1)%HYD_SAMPLES;
+  long m = ((long)median()) << HYD_EMA_FRACTION;
+  _ema += (m - _ema) >> HYD_EMA_SHIFT;
+  if( ++_count >= HYD_PUBLISH_SAMPLES ) {
+    _count = 0;
+    publish();
+  }
+}
+
+/**
+ *  Record the filtered soil moisture into history and publish it to event subscribers. The state generation (display
+ *  ETag) only changes when the published value does.
+ */
+void Hydrometer::publish() {
+  float sm = soilMoisture();
+  _history.record(sm);
+  char value[16];
+  snprintf(value,16,"%.0f",sm);
+  if( eventSvc()->set("soilMoisture",value) ) entityTag()->touchState();
+}
+
+/**
+ *  Fill the ring with a single reading so the filter starts out settled, and publish it
+ */
+void Hydrometer::initialize() {
+  int ar = analogRead(_pin);
+  for( int i=0; i<HYD_SAMPLES; i++ ) _samples[i] = ar;
+  _next  = 0;
+  _ema   = ((long)ar) << HYD_EMA_FRACTION;
+  _count = 0;
+  publish();
+}
+
+/**
+ *  Median of the ring by insertion sort of a copy; for an even number of samples it is the mean of the middle two
+ */
+int Hydrometer::median() {
+  int s[HYD_SAMPLES];
+  for( int i=0; i<HYD_SAMPLES; i++ ) {
+    int v = _samples[i];
+    int j = i;
+    for( ; (j>0) && (s[j-1]>v); j-- ) s[j] = s[j-1];
+    s[j] = v;
+  }
+  if( HYD_SAMPLES%2 == 0 ) return (s[HYD_SAMPLES/2-1] + s[HYD_SAMPLES/2])/2;
+  return s[HYD_SAMPLES/2];
 }
 
 float Hydrometer::soilMoisture(int ar) {
@@ -129,7 +198,7 @@ void Hydrometer::configForm(WebContext* svr) {
 }
 
 void Hydrometer::acquireDry(WebContext* svr) {
-  int ar = analogRead(A0);
+  int ar = reading();
   int dry = ((ar<0)?(0):((ar>1000)?(1000):(ar)));
   int wet = ((_acquireWet<0)?(water()):(_acquireWet));
   _acquireDry = dry;
@@ -138,7 +207,7 @@ void Hydrometer::acquireDry(WebContext* svr) {
 
 
 void Hydrometer::acquireWet(WebContext* svr) {
-  int ar = analogRead(A0);
+  int ar = reading();
   int dry = ((_acquireDry<0)?(air()):(_acquireDry));
   int wet = ((ar<0)?(0):((ar>1000)?(1000):(ar)));
   _acquireWet = wet;
@@ -154,72 +223,54 @@ void Hydrometer::displayForm(WebContext* svr, int dry, int wet) {
 /** wet and dry could have been set via prior invocation of this form using the acquire buttons.
  *  _acquireWet and _acquireDry must be reinitialized
  */
-  char buffer[1500];
-  int size = sizeof(buffer);
+  ChunkedWriter w(svr);
   
 /**
  *    Config Form HTML Start with Title
  */
-  int pos = formatHeader(buffer,size,"Set Configuration");
+  w.header("Set Configuration");
 
 /**
- *  Config Form Content
+ *  Config Form Content. The form with stored boundaries is rendered once per configuration, a form showing
+ *  acquired values is rendered each time.
  */
-
-  char dryPath[100];
-  handlerPath(dryPath,100,"acquireDry");
-  char wetPath[100];
-  handlerPath(wetPath,100,"acquireWet");
-  char pathBuff[100];
-  getPath(pathBuff,100);
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100);
-  pos = formatBuffer_P(buffer,size,pos,Hydrometer_config_form,svcPath,getDisplayName(),dry,dryPath,wet,wetPath,pathBuff);
+  FormatFunction form = [this,dry,wet](char buffer[], int size, int pos) {
+    pos = ConfigSchema::formatFormHead(buffer,size,pos,paths().action);
+    pos = Hydrometer_schema.formatField(buffer,size,pos,this,0);
+    pos = formatBuffer_P(buffer,size,pos,Hydrometer_calibration);
+    pos = Hydrometer_schema.formatField(buffer,size,pos,this,1,dry);
+    pos = formatBuffer_P(buffer,size,pos,Hydrometer_acquire,_dryPath);
+    pos = Hydrometer_schema.formatField(buffer,size,pos,this,2,wet);
+    pos = formatBuffer_P(buffer,size,pos,Hydrometer_acquire,_wetPath);
+    return ConfigSchema::formatFormTail(buffer,size,pos,paths().device);
+  };
+  if( (dry == air()) && (wet == water()) ) FragmentCache::shared()->write(w,this,FORM_FRAGMENT,entityTag()->config(),form);
+  else w.write(form);
 
 /**
  *  Config Form HTML Tail
  */
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer); 
+  w.tail();
 }
 
 void Hydrometer::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
-     if( argName.equalsIgnoreCase("DRYSENSOR") ) {
-        int val = (int) arg.toInt();
-        air(val);
-     }
-     else if( argName.equalsIgnoreCase("WETSENSOR") ) {
-        int val = (int) arg.toInt();
-        water(val);
-     }
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
-  }
+  if( Hydrometer_schema.parse(svr,this) > 0 ) entityTag()->touchConfig();
   display(svr);  
 }
 
-void Hydrometer::handleGetConfiguration(WebContext* svr) {
-  Serial.printf("Hydrometer::getConfiguration: getConfiguration starting...\n");
-  char buffer[1000];
-  size_t bufferSize = sizeof(buffer);
-  int size = bufferSize;
-  snprintf_P(buffer,size,Hydrometer_config_template,getDisplayName(),air(),water());
-  Serial.printf("Hydrometer::getConfiguration: getConfiguration sending response\n");
-  svr->send(200, "text/xml", buffer);     
-}
+void Hydrometer::handleGetConfiguration(WebContext* svr) {Hydrometer_schema.send(svr,this);}
+
+const ConfigSchema* Hydrometer::configSchema() {return &Hydrometer_schema;}
 
 void Hydrometer::setup(WebContext* svr) {
   Sensor::setup(svr);
-  char pathBuff[100];
-  handlerPath(pathBuff,100,"acquireDry");
-  svr->on(pathBuff,[this](WebContext* svr){this->acquireDry(svr);});
-  pathBuff[0] = '\0';
-  handlerPath(pathBuff,100,"acquireWet");
-  svr->on(pathBuff,[this](WebContext* svr){this->acquireWet(svr);});
+  _dryPath = PathTable::shared()->handlerPath(this,"acquireDry");
+  _wetPath = PathTable::shared()->handlerPath(this,"acquireWet");
+  svr->on(_dryPath,HandlerMetrics::timed(_dryPath,[this](WebContext* svr){this->acquireDry(svr);}));
+  svr->on(_wetPath,HandlerMetrics::timed(_wetPath,[this](WebContext* svr){this->acquireWet(svr);}));
   pinMode(_pin,INPUT);
+  initialize();
+  _timer.start();
 }
 
 } // End of namespace lsc
@@ -24,10 +24,23 @@
 #define HYDROMETER_H
 
 #include "SensorDevice.h"
+#include <Timer.h>
 
 #define ANALOG_WATER  400
 #define ANALOG_AIR    900
 
+/**
+ *   Acquisition pipeline: the analog pin is sampled every HYD_SAMPLE_INTERVAL milliseconds into a ring of 
+ *   HYD_SAMPLES raw readings. The median of the ring is smoothed by an exponential moving average with 
+ *   weight 1/2^HYD_EMA_SHIFT, kept in fixed point with HYD_EMA_FRACTION fractional bits. The filtered value is
+ *   recorded into history and published to subscribers every HYD_PUBLISH_SAMPLES samples (once a second).
+ */
+#define HYD_SAMPLE_INTERVAL  100
+#define HYD_SAMPLES          8
+#define HYD_EMA_SHIFT        2
+#define HYD_EMA_FRACTION     4
+#define HYD_PUBLISH_SAMPLES  10
+
 /** Leelanau Software Company namespace 
 *  
 */
@@ -58,6 +71,10 @@ class GetSoilMoisture : public UPnPService {
 
 /**
  *   Hydrometer is a Sensor that reads from the analog pin and computes soil moisture content.
+ *   The pin is oversampled from doDevice() and filtered (median, then EMA) in integer math. reading() returns the 
+ *   filtered value, which is used for display, the GetSoilMoisture service, and calibration (acquireDry/acquireWet), 
+ *   so none of these touch the ADC. Soil moisture is recorded into a history available from the GetHistory service, and
+ *   published to event subscribers as soilMoisture (1% resolution).
  */
 class Hydrometer : public Sensor {
   public:
@@ -67,17 +84,24 @@ class Hydrometer : public Sensor {
 
   float      soilMoisture();
   float      soilMoisture( int ar );
+  int        reading()     {return (_ema + (1<<(HYD_EMA_FRACTION-1))) >> HYD_EMA_FRACTION;}    // Filtered analog reading
   int        pin();
   int        water()       {return _water;}
   void       water( int w) {_water = (((w>0)&(w<1000))?(w):(_water));}
   int        air()         {return _air;}
   void       air( int a)   {_air = (((a>0)&(a<1000))?(a):(_air));}  
   void       pin(int p);
+
+  int             numHistories()  {return 1;}
+  SensorHistory*  history(int i)  {return ((i==0)?(&_history):(NULL));}
+  GetHistory*     historySvc()    {return &_getHistory;}
+  EventService*   eventSvc()      {return &_events;}
   
 /**
  *   Virtual Functions required for UPnPDevice
  */
   void       setup(WebContext* svr);
+  void       doDevice()    {_timer.doDevice(); _events.doDevice();}
   
 /**
  *   Virtual Functions required by Sensor, using default configuration
@@ -91,6 +115,7 @@ class Hydrometer : public Sensor {
    void      configForm(WebContext* svr);
    void      handleSetConfiguration(WebContext* svr);
    void      handleGetConfiguration(WebContext* svr);  
+   const ConfigSchema* configSchema();
    void      acquireWet(WebContext* svr);  
    void      acquireDry(WebContext* svr);  
  
@@ -115,6 +140,30 @@ class Hydrometer : public Sensor {
   int               _water = ANALOG_WATER;
   int               _acquireWet = -1;
   int               _acquireDry = -1;
+  const char*       _dryPath    = "";                // Interned at setup()
+  const char*       _wetPath    = "";
+
+/**
+ *   Acquisition pipeline state
+ */
+  Timer             _timer;
+  int               _samples[HYD_SAMPLES] = {0};
+  int               _next = 0;
+  long              _ema  = 0;                       // EMA of the median, scaled by 2^HYD_EMA_FRACTION
+  int               _count = 0;                      // Samples since the last publish()
+  SensorHistory     _history;
+  GetHistory        _getHistory;
+  EventService      _events;
+
+  void  sample();
+  void  publish();
+  void  initialize();
+  int   median();
+  void  timerCallback() {
+    sample();
+    _timer.reset();
+    _timer.start();
+  }
 
   void  displayForm(WebContext* svr, int acquireDry, int acquireWet );
 
@@ -0,0 +1,168 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "LoopProfiler.h"
+#include "ChunkedWriter.h"
+#include "PathTable.h"
+#include "QueryArgs.h"
+#include "HandlerMetrics.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char loop_profile_head[]   PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><loopProfile budget=\"%lu\" iterations=\"%lu\" stalls=\"%lu\" maxIteration=\"%lu\">";
+const char loop_profile_scope[]  PROGMEM = "<scope name=\"%s\" count=\"%lu\" mean=\"%lu\" max=\"%lu\" over=\"%lu\"/>";
+const char loop_profile_stall[]  PROGMEM = "<stall time=\"%lu\" duration=\"%lu\" culprit=\"%s\" culpritMicros=\"%lu\" detail=\"%s\" detailMicros=\"%lu\"/>";
+const char loop_profile_tail[]   PROGMEM = "</loopProfile>";
+
+/**
+ *  Static RTT initialization
+ */
+INITIALIZE_SERVICE_TYPES(GetLoopProfile,LeelanauSoftware-com,getLoopProfile,1.0.0);
+
+LoopProfiler* LoopProfiler::shared() {
+  static LoopProfiler profiler;
+  return &profiler;
+}
+
+/**
+ *  Close the previous iteration: count it, and keep it if it went over budget
+ */
+void LoopProfiler::loop() {
+  unsigned long now = micros();
+  if( _started ) {
+    uint32_t duration = now - _loopStart;
+    _iterations++;
+    if( duration > _maxIteration ) _maxIteration = duration;
+    if( duration > _budget ) {
+      _stalls++;
+      keep(duration);
+    }
+  }
+  _started       = true;
+  _loopStart     = now;
+  _culprit       = NULL;
+  _culpritMicros = 0;
+  _detail        = NULL;
+  _detailMicros  = 0;
+}
+
+/**
+ *  The worst LOOP_STALLS iterations are kept; a shorter stall replaces nothing once the table is full
+ */
+void LoopProfiler::keep(uint32_t duration) {
+  int i = _numStalls;
+  if( _numStalls < LOOP_STALLS ) _numStalls++;
+  else {
+    i = 0;
+    for( int j=1; j<LOOP_STALLS; j++ ) {if( _worst[j].duration < _worst[i].duration ) i = j;}
+    if( _worst[i].duration >= duration ) return;
+  }
+  LoopStall& s    = _worst[i];
+  s.time          = millis()/1000;
+  s.duration      = duration;
+  s.culprit       = ((_culprit != NULL)?(_culprit->name):(""));
+  s.culpritMicros = _culpritMicros;
+  s.detail        = ((_detail != NULL)?(_detail->name):(""));
+  s.detailMicros  = _detailMicros;
+}
+
+/**
+ *  Linear search by key and label. A device scope is named once, when its entry is created, from the interned device
+ *  path and label.
+ */
+LoopStats* LoopProfiler::entry(const void* key, UPnPObject* obj, const char* label) {
+  for( int i=0; i<_size; i++ ) {if( (_stats[i].key == key) && (_stats[i].label == label) ) return &_stats[i];}
+  if( _size == LOOP_PROFILE_SIZE ) return NULL;
+  LoopStats& e = _stats[_size++];
+  memset(&e,0,sizeof(LoopStats));
+  e.key   = key;
+  e.label = label;
+  e.name  = ((obj == NULL)?((const char*)key):(PathTable::shared()->path(obj)));
+  if( (obj != NULL) && (label != NULL) ) {
+    char buffer[PATH_MAX_LENGTH];
+    snprintf(buffer,PATH_MAX_LENGTH,"%s:%s",e.name,label);
+    e.name = PathTable::shared()->intern(buffer);
+  }
+  return &e;
+}
+
+void LoopProfiler::record(const void* key, UPnPObject* obj, const char* label, int depth, uint32_t micros) {
+  LoopStats* e = entry(key,obj,label);
+  if( e == NULL ) return;
+  e->count++;
+  e->micros += micros;
+  if( micros > e->max ) e->max = micros;
+  if( micros > _budget ) e->over++;
+  if( (depth == 0) && (micros > _culpritMicros) ) {
+    _culprit       = e;
+    _culpritMicros = micros;
+  }
+  else if( (depth > 0) && (micros > _detailMicros) ) {
+    _detail        = e;
+    _detailMicros  = micros;
+  }
+}
+
+void LoopProfiler::send(WebContext* svr) {
+  ChunkedWriter w(svr,"text/xml");
+  w.printf_P(loop_profile_head,(unsigned long)budget(),(unsigned long)_iterations,(unsigned long)_stalls,(unsigned long)_maxIteration);
+  for( int i=0; i<_size; i++ ) {
+    const LoopStats& e = _stats[i];
+    unsigned long mean = ((e.count>0)?((unsigned long)(e.micros/e.count)):(0));
+    w.printf_P(loop_profile_scope,e.name,(unsigned long)e.count,mean,(unsigned long)e.max,(unsigned long)e.over);
+  }
+  for( int i=0; i<_numStalls; i++ ) {
+    const LoopStall& s = _worst[i];
+    w.printf_P(loop_profile_stall,(unsigned long)s.time,(unsigned long)s.duration,s.culprit,(unsigned long)s.culpritMicros,s.detail,(unsigned long)s.detailMicros);
+  }
+  w.printf_P(loop_profile_tail);
+}
+
+void LoopScope::begin() {
+  _depth = LoopProfiler::shared()->_depth++;
+  _start = micros();
+}
+
+LoopScope::~LoopScope() {
+  uint32_t elapsed = micros() - _start;
+  LoopProfiler* p = LoopProfiler::shared();
+  p->_depth--;
+  p->record(_key,_obj,_label,_depth,elapsed);
+}
+
+GetLoopProfile::GetLoopProfile() : UPnPService("getLoopProfile") {setDisplayName("Get Loop Profile");}
+
+void GetLoopProfile::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
+  QueryArgs args(svr);
+  for( int i=0; i<args.count(); i++ ) {
+    ArgView a = args.arg(i);
+    long ms;
+    if( (a.hash() == argHash("BUDGET")) && a.toInt(ms) && (ms > 0) ) LoopProfiler::shared()->budget(ms);
+  }
+  LoopProfiler::shared()->send(svr);
+}
+
+} // End of namespace lsc
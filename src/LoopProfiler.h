@@ -0,0 +1,191 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <UPnPLib.h>
+
+/**
+ *   Number of timed scopes, number of worst stalls kept, and the default loop budget (in ms). RAM is about
+ *   LOOP_PROFILE_SIZE*32 + LOOP_STALLS*24 bytes.
+ */
+#ifndef LOOP_PROFILE_SIZE
+#define LOOP_PROFILE_SIZE    24
+#endif
+#ifndef LOOP_STALLS
+#define LOOP_STALLS          8
+#endif
+#ifndef LOOP_BUDGET
+#define LOOP_BUDGET          50
+#endif
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct LoopStats {
+  const void*     key;                                    // Scope name, or the device a scope belongs to
+  const char*     label;                                  // Part of the device (NULL for its doDevice())
+  const char*     name;                                   // Interned name for output
+  uint32_t        count;
+  uint32_t        max;                                    // Longest single call in microseconds
+  uint32_t        over;                                   // Calls longer than the budget
+  uint64_t        micros;                                 // Total time
+} LoopStats;
+
+typedef struct LoopStall {
+  uint32_t        time;                                   // Seconds since boot
+  uint32_t        duration;                               // Loop iteration in microseconds
+  const char*     culprit;                                // Slowest top level scope of the iteration
+  uint32_t        culpritMicros;
+  const char*     detail;                                 // Slowest nested scope of the iteration, if any
+  uint32_t        detailMicros;
+} LoopStall;
+
+/** LoopProfiler times the parts of the main loop in a fixed table and keeps the worst loop iterations that went over
+ *  budget, with the scope that took the most time in each. An iteration runs from one ExtendedDevice::doDevice() to
+ *  the next, so it includes whatever the sketch does in between.
+ *
+ *  ExtendedDevice times doDevice() of each embedded device, discovery, and the configuration store. Devices time
+ *  their own parts with a labeled scope (SensorControlledRelay Timer, SoftwareClock system clock). The sketch times
+ *  the web server and SSDP the same way:
+ *      void loop() {
+ *        root.doDevice();
+ *        {LoopScope scope("doSSDP"); ssdp.doSSDP();}
+ *        {LoopScope scope("handleClient"); ctx.handleClient();}
+ *      }
+ *  Scopes nest; a nested scope is included in the time of the scope around it. The GetLoopProfile service of
+ *  ExtendedDevice reports the table and the worst stalls as XML.
+ */
+class LoopProfiler {
+  public:
+    LoopProfiler() {}
+
+    void                    loop();                                     // Start of a loop iteration, called from ExtendedDevice::doDevice()
+    void                    record(const void* key, UPnPObject* obj, const char* label, int depth, uint32_t micros);
+
+    uint32_t                budget()                   {return _budget/1000;}
+    void                    budget(uint32_t ms)        {if( ms > 0 ) _budget = ms*1000;}
+    uint32_t                iterations()               {return _iterations;}
+    uint32_t                stalls()                   {return _stalls;}
+    uint32_t                maxIteration()             {return _maxIteration;}              // Microseconds
+
+    int                     size()                     {return _size;}
+    const LoopStats*        stats(int i)               {return (((i>=0)&&(i<_size))?(&_stats[i]):(NULL));}
+    int                     numStalls()                {return _numStalls;}
+    const LoopStall*        stall(int i)               {return (((i>=0)&&(i<_numStalls))?(&_worst[i]):(NULL));}
+
+    void                    send(WebContext* svr);
+    static LoopProfiler*    shared();
+
+  private:
+    friend class LoopScope;
+    LoopStats*              entry(const void* key, UPnPObject* obj, const char* label);
+    void                    keep(uint32_t duration);
+
+    uint32_t                _budget        = LOOP_BUDGET*1000UL;
+    unsigned long           _loopStart     = 0;
+    boolean                 _started       = false;
+    uint32_t                _iterations    = 0;
+    uint32_t                _stalls        = 0;
+    uint32_t                _maxIteration  = 0;
+    int                     _depth         = 0;
+
+/**
+ *   Slowest scopes of the current iteration
+ */
+    const LoopStats*        _culprit       = NULL;
+    uint32_t                _culpritMicros = 0;
+    const LoopStats*        _detail        = NULL;
+    uint32_t                _detailMicros  = 0;
+
+    int                     _size          = 0;
+    LoopStats               _stats[LOOP_PROFILE_SIZE];
+    int                     _numStalls     = 0;
+    LoopStall               _worst[LOOP_STALLS];
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(LoopProfiler);
+};
+
+/**
+ *   Times a part of the loop from construction to destruction. A name must outlive the profiler (a literal); a device
+ *   scope is named by the device path, followed by :label if there is one.
+ */
+class LoopScope {
+  public:
+    LoopScope(const char* name)                          : _key(name)                          {begin();}
+    LoopScope(UPnPObject* obj, const char* label = NULL) : _key(obj), _obj(obj), _label(label)  {begin();}
+    ~LoopScope();
+
+  private:
+    void            begin();
+
+    const void*     _key;
+    UPnPObject*     _obj    = NULL;
+    const char*     _label  = NULL;
+    int             _depth  = 0;
+    unsigned long   _start  = 0;
+};
+
+/**
+ *   GetLoopProfile is a UPnPService returning LoopProfiler::shared() as XML:
+ *      <loopProfile budget="ms" iterations="n" stalls="n" maxIteration="us">
+ *        <scope name="..." count="n" mean="us" max="us" over="n"/>...
+ *        <stall time="secs" duration="us" culprit="..." culpritMicros="us" detail="..." detailMicros="us"/>...
+ *      </loopProfile>
+ *   BUDGET=ms sets the budget.
+ */
+class GetLoopProfile : public UPnPService {
+  public:
+    GetLoopProfile();
+    virtual ~GetLoopProfile() {}
+
+    void handleRequest(WebContext* svr);
+
+/**
+ *   Macros to define the following Runtime and UPnP Type Info:
+ *     private: static const ClassType  _classType;
+ *     public:  static const ClassType* classType();
+ *     public:  virtual void*           as(const ClassType* t);
+ *     public:  virtual boolean         isClassType( const ClassType* t);
+ *     private: static const char*      _upnpType;
+ *     public:  static const char*      upnpType()
+ *     public:  virtual const char*     getType()
+ *     public:  virtual boolean         isType(const char* t)
+ */
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(GetLoopProfile);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -27,29 +27,40 @@
 */
 namespace lsc {
 
-const char next_on[]      PROGMEM = "<div align=\"center\">ON at %s</div>";
-const char next_off[]     PROGMEM = "<div align=\"center\">OFF at %s</div>";
+const char next_transition[]  PROGMEM = "<div align=\"center\" data-ev=\"mode\" data-show=\"AUTOMATIC\"%s>"
+                                       "<span data-ev=\"state\" data-t_on=\"OFF\" data-t_off=\"ON\">%s</span> at <span data-ev=\"next\">%s</span></div>";
 
 /**
- *    Variable input to form is service action url, display name placeholder, start time, end time, cancel url
- *    Form is in 3 sections, head, time, and buttons. The time section is variable based on the number of intervals
- *    Form head takes service action url and display name as char*
+ *    Configuration fields other than the intervals, which are parsed and rendered by OutletTimer
  */
-const char timer_config_form_head[]  PROGMEM = "<form action=\"%s\"><div align=\"center\">"
-                                        "<label for=\"displayName\">Sensor Name:</label>&emsp;"
-                                        "<input type=\"text\" placeholder=\"%s\" name=\"displayName\">&emsp;&emsp;&emsp;&emsp;&emsp;&emsp;&emsp;<br><br>";
+constexpr ConfigField OutletTimer_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(OutletTimer,sensor_name_label)
+};
+constexpr ConfigSchema OutletTimer_schema(OutletTimer_fields,sizeof(OutletTimer_fields)/sizeof(ConfigField));
+
+/**
+ *    Form is in 3 sections, head, time, and buttons. The time section is repeated for every configured interval, plus
+ *    an empty interval to add a new one. An interval is removed by clearing its start or end time.
+ *    Form head is the schema form head and fields (service action url and display name)
+ */
+
 /**                                        
- *    Form time takes start hours, start mins, end hours, end mins as 2 digit integers                                       
+ *    Form time takes the start time and end time as hh:mm (or empty) strings
  */
 const char timer_config_form_time[]  PROGMEM = "<br><label for=\"%s\">Start Time:</label>&emsp;"
-                                        "<input id=\"%s\" type=\"time\" name=\"%s\" value=\"%02d:%02d\" pattern=\"[0-9]{2}:[0-9]{2}\"/>&emsp;&emsp;"
+                                        "<input id=\"%s\" type=\"time\" name=\"%s\" value=\"%s\" pattern=\"[0-9]{2}:[0-9]{2}\"/>&emsp;&emsp;"
                                         "<label for=\"%s\">End Time:</label>&emsp;"
-                                        "<input id=\"%s\" type=\"time\" name=\"%s\" value=\"%02d:%02d\" pattern=\"[0-9]{2}:[0-9]{2}\"/>";
+                                        "<input id=\"%s\" type=\"time\" name=\"%s\" value=\"%s\" pattern=\"[0-9]{2}:[0-9]{2}\"/><br>"
+                                        "<input type=\"hidden\" name=\"%s\" value=\"\">";
+/**
+ *    Form day takes the DAYS_n argument name, weekday number, checked attribute, and weekday name
+ */
+const char timer_config_form_day[]   PROGMEM = "<input type=\"checkbox\" name=\"%s\" value=\"%d\"%s>%s&ensp;";
 
 /** 
  *    Form buttons takes the cancel path as char*
  */
-const char timer_config_form_buttons[]  PROGMEM = "<br><br><div align=\"center\">Note: Intervals may wrap-around midnight but should not overlap</div><br>"
+const char timer_config_form_buttons[]  PROGMEM = "<br><br><div align=\"center\">Note: Intervals may wrap-around midnight and may overlap</div><br>"
                                        "<br><button class=\"fmButton\" type=\"submit\">Submit</button>&nbsp&nbsp"
                                         "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button>" 
                                         "</div></form>";
@@ -59,8 +70,13 @@ const char timer_config_template_head[]  PROGMEM = "<?xml version=\"1.0\" encodi
                                                           "<config>"
                                                               "<displayName>%s</displayName>";                                   
 const char timer_config_template_time[]  PROGMEM =     "<startTime_%d>%02d:%02d</startTime_%d>"
-                                                              "<endTime_%d>%02d:%02d</endTime_%d>";
+                                                              "<endTime_%d>%02d:%02d</endTime_%d>"
+                                                              "<days_%d>%d</days_%d>";
 const char timer_config_template_tail[]  PROGMEM = "</config>";
+const char timer_config_json_head[]      PROGMEM = "{\"displayName\":";
+const char timer_config_json_list[]      PROGMEM = ",\"intervals\":[";
+const char timer_config_json_time[]      PROGMEM = "%s{\"start\":\"%02d:%02d\",\"end\":\"%02d:%02d\",\"days\":%d}";
+const char timer_config_json_tail[]      PROGMEM = "]}";
                                       
 /**
  *  Static RTT initialization
@@ -75,277 +91,334 @@ OutletTimer::OutletTimer(const char* target) : SensorControlledRelay(target) {
   setDisplayName("Outlet Timer");
 }
 
+/**
+ *  The next transition is displayed as published, so the page agrees with stateGeneration(). Rendering has no side
+ *  effects: ChunkedWriter runs it again after a flush. "next" is published on every relay change, see relayChanged().
+ */
 int  OutletTimer::formatContent(char buffer[], int size, int pos) {  
   pos = SensorControlledRelay::formatContent(buffer,size,pos);
-  if( isAUTOMATIC() ) {
-    if( isON() ) pos = formatBuffer_P(buffer,size,pos,next_off,nextOFF()); 
-    else pos = formatBuffer_P(buffer,size,pos,next_on,nextON());
-  } 
+  pos = formatBuffer_P(buffer,size,pos,next_transition,((isAUTOMATIC())?(""):(" style=\"display:none\"")),((isON())?("OFF"):("ON")),_events.get("next"));
   return pos;         
 }
 
 /**
-*   Look at the current time (minutes since midnight) and compare it to every interval. The cycle time is the next
-*   ON or next OFF, which ever comes first. If current time is within an interval then cycle time is the endpoint
-*   of that interval, otherwise it's the smallest start time greater than current time (wrapping around midnight).
-*   If mode is AUTOMATIC and state is ON, then cycle time is the next OFF. Likewise, if mode is AUTOMATIC and state
-*   is OFF, then cycle time is next ON.
+ *  Returns the current minute of the week (Sunday 00:00 is 0), and the current second of the week in secs if not NULL.
+ *  Returns -1 if there is no SoftwareClock.
+ */
+int OutletTimer::currentMinute(long* secs) {
+  SoftwareClock* c = getSoftwareClock();
+  if( c == NULL ) return -1;
+  Instant now = c->now();
+  Date    d   = now.toDate();
+  Time    t   = now.toTime();
+  int     m   = WeeklySchedule::minuteOfWeek(WeeklySchedule::dayOfWeek(d.year,d.month,d.day),t.hour,t.min);
+  if( secs != NULL ) *secs = 60L*m + t.sec;
+  return m;
+}
+
+/**
+*   Fill the nextON and nextOFF buffers from the compiled schedule. A transition on a later day is prefixed with
+*   the weekday name. Both are "--:--" if the schedule never changes state or there is no SoftwareClock.
 */
 void OutletTimer::nextCycle() {
-   SoftwareClock* c   = getSoftwareClock();
-   if( c != NULL ) {
+   int m   = currentMinute();
+   int on  = ((m>=0)?(_schedule.nextStart(m)):(-1));
+   int off = ((m>=0)?(_schedule.nextEnd(m)):(-1));
+   printTransition(_nextON,on,m);
+   printTransition(_nextOFF,off,m);
+   if(loggingLevel(FINE)) TraceBuffer::shared()->record(TRACE_TIMER_CYCLE,this,on,off);
+}
+
+void OutletTimer::printTransition(char buffer[], int next, int current) {
+   if( next < 0 ) snprintf(buffer,16,"--:--");
+   else {
+      int mins = next%MINUTES_PER_DAY;
+      int day  = next/MINUTES_PER_DAY;
+      if( day == current/MINUTES_PER_DAY ) snprintf(buffer,16,"%02d:%02d",mins/60,mins%60);
+      else snprintf(buffer,16,"%s %02d:%02d",WeeklySchedule::dayName(day),mins/60,mins%60);
+   }
+}
+
+ControlState OutletTimer::sensorState() {
+  int m = currentMinute();
+  return (((m >= 0) && _schedule.isOn(m))?(ON):(OFF));
+}
+
 /**
- *    Calculate minutes since midnight
+ *  Milliseconds until the next transition away from the current sensorState(): next OFF if ON, next ON if OFF.
+ *  A schedule that never changes state is re-evaluated once a day.
  */
-      Time t = c->now().toTime();
-      int currentMins = t.hour*60 + t.min;
-      int next_ON     = 1440;       // 1440 mins in a day (60*24)
-      int next_OFF    = 1440;
-      int minStart    = 1440;
-      int minEnd      = 1440;
+long OutletTimer::nextWakeup() {
+  long secs = 0;
+  int  m    = currentMinute(&secs);
+  if( m < 0 ) return -1;
+  int next = ((_schedule.isOn(m))?(_schedule.nextEnd(m)):(_schedule.nextStart(m)));
+  if( next < 0 ) return 86400000L;
+  long delta = 60L*next - secs;
+  if( delta <= 0 ) delta += 60L*MINUTES_PER_WEEK;
+  return delta*1000L;
+}
+
+void OutletTimer::setup(WebContext* svr) {
+  SensorControlledRelay::setup(svr);
+  _clock = getSoftwareClock();
+  if( _clock != NULL ) _syncCount = _clock->syncCount();
+  publishNext();
+}
+
 /**
- *    Check all intervals looking for the smallest start and end that are greater than
- *    current time. While we're at it, also find smallest start and smallest end.
- *    If start[i] == end[i] the interval is trivial and not checked, if end[i] < start[i]
- *    the interval wraps around midnight.
+ *  Publish the next transition away from the current relay state as the event variable "next"
  */
-      for( int i = 0; i < MAX_TIMER_INTERVALS; i++ ) {
-/**
-*        Interval does NOT wrap around midnight
-*/
-         if( _start[i] < _end[i] ) { 
-           if( currentMins < _start[i] ) {      
-              if( next_ON > _start[i] ) next_ON  = _start[i];
-              if( next_OFF > _end[i]  ) next_OFF = _end[i];
-           }
-           else if( (currentMins < _end[i]) && (next_OFF > _end[i]) ) next_OFF = _end[i];
-/**
-*          Update minimum start and end
-*/
-           if( _start[i] < minStart ) minStart = _start[i];
-           if( _end[i]   < minEnd   ) minEnd   = _end[i];
-         }
-/**
-*        Interval DOES wrap around midnight
-*/
-         else if( _end[i] < _start[i] ) {   
-           if( (currentMins >= _start[i]) && (next_OFF > _end[i]) )       next_OFF = _end[i];       // Inside interval before midnight  
-           else if( (currentMins < _end[i]) && (next_OFF > _end[i]) )     next_OFF = _end[i];       // Inside interval after midnight
-           else if( (currentMins < _start[i]) && (next_ON > _start[i]) )  next_ON  = _start[i];     // Outside interval
-/**
-*          Update minimum start and end
-*/
-           if( _start[i] < minStart ) minStart = _start[i];
-           if( _end[i]   < minEnd   ) minEnd   = _end[i];
-         }
-         if(loggingLevel(FINEST)) printInterval(currentMins,_start[i],_end[i],next_ON,next_OFF);
-      }
-      if(loggingLevel(FINEST)) Serial.printf("OutletTimer::nextCycle: minStart is %02d:%02d and minEnd is %02d:%02d\n",
-                                             minStart/60,minStart%60,minEnd/60,minEnd%60);
-/**
-*     If current falls outside of all intervals and is not ahead of
-*     a wrap-around interval, next_ON and possibly next_OFF were not set.
-*     Use minimums.
-*/      
-      if( next_ON == 1440 ) next_ON = minStart;
-      if( next_OFF == 1440 ) next_OFF = minEnd;            
-      snprintf(_nextON,8,"%02d:%02d",next_ON/60,next_ON%60);
-      snprintf(_nextOFF,8,"%02d:%02d",next_OFF/60,next_OFF%60);
-   }
+void OutletTimer::publishNext() {
+  _events.set("next",((isON())?(nextOFF()):(nextON())));
+  _published   = getControlState();
+  _publishedAt = millis();
+}
+
 /**
-*  No SoftwareClock present, nextON and nextOFF are trivially 00:00
-*/
-   else {
-      snprintf(_nextON,8,"00:00");
-      snprintf(_nextOFF,8,"00:00");
-   }
+ *  A clock synchronization (or timezone change) moves local time, so the armed wakeup is recomputed
+ */
+void OutletTimer::doDevice() {
+  SensorControlledRelay::doDevice();
+  if( (_clock != NULL) && (_clock->syncCount() != _syncCount) ) {
+    _syncCount = _clock->syncCount();
+    schedule();
+  }
 
-  if(loggingLevel(FINE)) Serial.printf("OutletTimer::nextCycle:   next ON is %s and nextOFF is %s\n",_nextON,_nextOFF);
+/**
+ *  The next transition is published on relay changes (relayChanged()); otherwise its text (weekday prefix) changes
+ *  at most once a minute
+ */
+  if( (getControlState() != _published) || ((millis() - _publishedAt) >= 60000) ) publishNext();
 }
 
-void OutletTimer::printInterval(int currentMins, int start, int end, int nON, int nOFF) {
-   Serial.printf("OutletTimer::printInterval: current is %02d:%02d, start is %02d:%02d, end is %02d:%02d, nextON is %02d:%02d, nextOFF is %02d:%02d\n",
-           currentMins/60,currentMins%60,start/60,start%60,end/60,end%60,nON/60,nON%60,nOFF/60,nOFF%60);
+/**
+ *  Add an interval and compile the schedule. Returns false, leaving the schedule unchanged, if it is full.
+ */
+boolean OutletTimer::addInterval(int start, int end, uint8_t days) {
+  ScheduleInterval saved[SCHEDULE_MAX_INTERVALS];
+  int n = saveIntervals(saved);
+  if( !_schedule.add(start,end,days) || !compileOrRevert(saved,n) ) return false;
+  entityTag()->touchConfig();
+  schedule();
+  return true;
 }
 
-ControlState OutletTimer::sensorState() {
-  ControlState result = OFF;
-  SoftwareClock* c = getSoftwareClock();
-  if( c != NULL ) {
-  /**
-  *   Calculate minutes since midnight
-  */
-    Time t = c->now().toTime();
-    int currentMins = t.hour*60 + t.min;
-    
-  /**
-  *   Compare minutes since midnight to stored timer intervals. Outlet should be ON if the current time is within
-  *   any of the timer intervals, otherwise is should be OFF. Intervals that wrap around midnight have end < start.
-  *   The search stops once the result is ON. Note that if start == end the interval is trivial and not considered.
-  */
-    for( int i=0; (i<MAX_TIMER_INTERVALS) && (result == OFF); i++ ) {
-  /**
-  *   Time interval does not wrap around midnight
-  */
-      if( _start[i] < _end[i] ) {
-        if( (currentMins >= _start[i]) && (currentMins < _end[i]) ) {
-          result = ON;
-        }
-      }
-  /**
-  *   Time interval wrapped around midnight
-  */
-      else if( _end[i] < _start[i] ) {if( (currentMins >= _start[i]) || (currentMins < _end[i]) ) result = ON;}
-    }
-  }
-  return result;
+int OutletTimer::saveIntervals(ScheduleInterval saved[]) {
+  int n = _schedule.numIntervals();
+  for( int i=0; i<n; i++ ) saved[i] = *_schedule.interval(i);
+  return n;
 }
 
-void OutletTimer::configForm(WebContext* svr) {
 /**
- *  Array dimension of 1700 is barely enough 
+ *  A schedule that does not compile has no ranges, so the saved intervals (which compiled before) are put back
+ *  rather than leave the relay always OFF
  */
-  char buffer[1700];
-  int size = sizeof(buffer);
+boolean OutletTimer::compileOrRevert(const ScheduleInterval saved[], int n) {
+  if( _schedule.compile() ) return true;
+  _schedule.clear();
+  for( int i=0; i<n; i++ ) _schedule.add(saved[i].start,saved[i].end,saved[i].days);
+  _schedule.compile();
+  return false;
+}
+
+void OutletTimer::configForm(WebContext* svr) {
+  ChunkedWriter w(svr);
   
 /**
  *    Config Form HTML Start with Title
  */
-  int pos = formatHeader(buffer,size,"Timer Configuration");
+  w.header("Timer Configuration");
 
 /**
- *  Config Form Content
+ *  Config Form Content, every part depends only on configuration so each is rendered once per configuration. 
+ *  Rows are cached separately since a full schedule is larger than a chunk.
  */ 
-  char pathBuff[100];
-  getPath(pathBuff,100);
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100);
-  pos = formatBuffer_P(buffer,size,pos,timer_config_form_head,svcPath,getDisplayName());
+  FragmentCache* cache      = FragmentCache::shared();
+  uint32_t       generation = entityTag()->config();
+  cache->write(w,this,FORM_FRAGMENT,generation,[this](char buffer[], int size, int pos) {
+    pos = ConfigSchema::formatFormHead(buffer,size,pos,paths().action);
+    return OutletTimer_schema.formatFields(buffer,size,pos,this);
+  });
   
-  for(int i=0; i<MAX_TIMER_INTERVALS; i++ ) {
-     int startHours = _start[i]/60;
-     int startMins  = _start[i]%60;
-     int endHours   = _end[i]/60;
-     int endMins    = _end[i]%60;
-     char startName[32];
-     char endName[32];
-     snprintf(startName,32,"START_TIME_%d",i);
-     snprintf(endName,32,"END_TIME_%d",i);
-     pos = formatBuffer_P(buffer,size,pos,timer_config_form_time,startName,startName,startName,startHours,startMins,endName,endName,endName,endHours,endMins);
+  int n = _schedule.numIntervals();
+  for(int i=0; (i<=n) && (i<SCHEDULE_MAX_INTERVALS); i++ ) {
+     cache->write(w,this,FORM_ROW_FRAGMENT+i,generation,[this,i](char buffer[], int size, int pos) {return formatRow(buffer,size,pos,i);});
   }
 
-  pos = formatBuffer_P(buffer,size,pos,timer_config_form_buttons,pathBuff);
+  cache->write(w,this,FORM_TAIL_FRAGMENT,generation,[this](char buffer[], int size, int pos) {
+    return formatBuffer_P(buffer,size,pos,timer_config_form_buttons,paths().device);
+  });
 
 /**
  *  Config Form HTML Tail
  */
-  pos = formatTail(buffer,size,pos);
-  if( loggingLevel(FINE) ) Serial.printf("OutletTimer::configForm: Sending %d bytes\n",pos);                             
-  svr->send(200,"text/html",buffer); 
+  w.tail();
+  w.end();
+  if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_TIMER_FORM,this,w.bytesSent());                             
 }
 
+/**
+ *  Form row i: start and end time inputs and weekday checkboxes for interval i, empty if there is no interval i
+ */
+int OutletTimer::formatRow(char buffer[], int size, int pos, int i) {
+  const ScheduleInterval* in = _schedule.interval(i);
+  char startName[32];
+  char endName[32];
+  char daysName[32];
+  char startTime[8] = "";
+  char endTime[8]   = "";
+  snprintf(startName,32,"START_TIME_%d",i);
+  snprintf(endName,32,"END_TIME_%d",i);
+  snprintf(daysName,32,"DAYS_%d",i);
+  if( in != NULL ) {
+     snprintf(startTime,8,"%02d:%02d",in->start/60,in->start%60);
+     snprintf(endTime,8,"%02d:%02d",in->end/60,in->end%60);
+  }
+  pos = formatBuffer_P(buffer,size,pos,timer_config_form_time,startName,startName,startName,startTime,endName,endName,endName,endTime,daysName);
+  uint8_t days = ((in != NULL)?(in->days):(ALL_DAYS));
+  for( int d=0; d<7; d++ ) pos = formatBuffer_P(buffer,size,pos,timer_config_form_day,daysName,d,((days & (1<<d))?(" checked"):("")),WeeklySchedule::dayName(d));
+  return pos;
+}
+
+/**
+ *  Intervals are collected by sequence number and the schedule is rebuilt and compiled only if the form carried any
+ *  START_TIME_n or END_TIME_n argument; configuration is only touched if the intervals or a field changed. An interval is kept if both its times parse. DAYS_n may repeat, once per
+ *  selected weekday (0 is Sunday), and defaults to every day if absent.
+ */
 void OutletTimer::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
+  int     start[SCHEDULE_MAX_INTERVALS];
+  int     end[SCHEDULE_MAX_INTERVALS];
+  uint8_t days[SCHEDULE_MAX_INTERVALS];
+  boolean daysSet[SCHEDULE_MAX_INTERVALS];
+  boolean intervals = false;
+  for( int i=0; i<SCHEDULE_MAX_INTERVALS; i++ ) {start[i] = -1; end[i] = -1; days[i] = 0; daysSet[i] = false;}
+
+  uint8_t previous[4+CONFIG_TEXT_SIZE*(sizeof(OutletTimer_fields)/sizeof(ConfigField))];
+  int     previousLen = OutletTimer_schema.serialize(previous,sizeof(previous),this);
+
+  int applied = OutletTimer_schema.parse(svr,this,[&](ArgView& a) {
+     boolean isStart = (a.prefix() == argHash("START_TIME_"));
+     boolean isEnd   = (a.prefix() == argHash("END_TIME_"));
  
-     if( argName.startsWith("START_TIME_") ) {
-        int seqNum = argSequenceNumber(argName);
+     if( isStart || isEnd ) {
+        intervals = true;
+        int seqNum = argSequenceNumber(a);
         if( seqNum >= 0 ) {
-           int h = getHours(arg);
-           int m = getMinutes(arg);
-           if( (h >= 0) && (m >= 0)  ) {
-               _start[seqNum] = 60*h + m;
+           int h = -1;
+           int m = -1;
+           if( a.toTime(h,m) ) {
+               if( isStart ) start[seqNum] = 60*h + m;
+               else end[seqNum] = 60*h + m;
            }
-           else {
-              if( loggingLevel(WARNING) ) Serial.printf("TimerControl::setTimerControlConfiguration: Error processing number format in arg %s for argument %s\n", arg.c_str(),argName.c_str());                  
+           else if( !a.empty() ) {
+              if( loggingLevel(WARNING) ) Serial.printf("OutletTimer::handleSetConfiguration: Error processing number format in arg %s for argument %s\n", a.value(),a.name());                  
            }
         }
         else {
-            if( loggingLevel(WARNING) ) Serial.printf("TimerControl::setTimerControlConfiguration: Error processing sequence number for argument %s\n",argName.c_str());
+            if( loggingLevel(WARNING) ) Serial.printf("OutletTimer::handleSetConfiguration: Error processing sequence number for argument %s\n",a.name());
         }
      }
-     else if( argName.startsWith("END_TIME_") ) {
-        int seqNum = argSequenceNumber(argName);
+     else if( a.prefix() == argHash("DAYS_") ) {
+        int seqNum = argSequenceNumber(a);
         if( seqNum >= 0 ) {
-           int h = getHours(arg);
-           int m = getMinutes(arg);
-           if( (h >= 0) && (m >= 0) ) {
-               _end[seqNum] = 60*h + m;
-           }
-           else {
-              if( loggingLevel(WARNING) ) Serial.printf("TimerControl::setTimerControlConfiguration: Error processing number format in arg %s for argument %s\n", arg.c_str(),argName.c_str());                  
-           }
-        }
-        else {
-            if( loggingLevel(WARNING) ) Serial.printf("TimerControl::setTimerControlConfiguration: Error processing sequence number for argument %s\n",argName.c_str());
+           const char* v = a.value();
+           daysSet[seqNum] = true;
+           if( (v[0] >= '0') && (v[0] <= '6') && (v[1] == '\0') ) days[seqNum] |= (1 << (v[0]-'0'));
         }
      }
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
-  }  
+  });
+
+  if( intervals ) {
+     ScheduleInterval saved[SCHEDULE_MAX_INTERVALS];
+     int n = saveIntervals(saved);
+     _schedule.clear();
+     for( int i=0; i<SCHEDULE_MAX_INTERVALS; i++ ) {
+        if( (start[i] >= 0) && (end[i] >= 0) ) _schedule.add(start[i],end[i],((daysSet[i])?(days[i]):(ALL_DAYS)));
+     }
+
+/**
+ *   A schedule that does not fit rejects the whole submission: intervals and fields are put back and nothing is
+ *   touched, so neither the relay nor ConfigStore see it
+ */
+     if( !compileOrRevert(saved,n) ) {
+        if( previousLen > 0 ) OutletTimer_schema.deserialize(previous,previousLen,this);
+        if( loggingLevel(WARNING) ) Serial.printf("OutletTimer::handleSetConfiguration: Schedule exceeds %d ranges\n",SCHEDULE_MAX_RANGES);
+        svr->send(400,"text/plain","Schedule Too Large");
+        return;
+     }
+     boolean same = (n == _schedule.numIntervals());
+     for( int i=0; same && (i<n); i++ ) {
+        const ScheduleInterval* in = _schedule.interval(i);
+        same = (in->start == saved[i].start) && (in->end == saved[i].end) && (in->days == saved[i].days);
+     }
+     intervals = !same;
+  }
+  if( (applied > 0) || intervals ) entityTag()->touchConfig();
+  schedule();
   display(svr);  
 }
 
-/** 
- *  Returns the hours part of time string hh:mm as int
- *  Result will be >=0 and <= 23.
- *  Returns -1 if time format is incorrect or hours is out of range.
+/**
+ *  Interval count u8, then start u16, end u16, days u8 per interval (little-endian). An image whose intervals do not
+ *  compile is rejected by restoreConfig(), keeping the current schedule.
  */
-int OutletTimer::getHours(const String& s) {
-   int result = -1;
-   if( (s.indexOf(':') == 2) && (s.length() == 5) && isDigit(s.charAt(0)) && isDigit(s.charAt(1)) ) {
-      result = s.substring(0,2).toInt();
-      if( result > 23 ) result = -1;
-   }
-   return result;
+int OutletTimer::saveConfig(uint8_t buffer[], int size) {
+  int pos = SensorControlledRelay::saveConfig(buffer,size);
+  int n   = _schedule.numIntervals();
+  if( (pos == 0) || ((pos + 1 + n*5) > size) ) return 0;
+  buffer[pos++] = n;
+  for( int i=0; i<n; i++ ) {
+     const ScheduleInterval* in = _schedule.interval(i);
+     buffer[pos++] = in->start;
+     buffer[pos++] = in->start >> 8;
+     buffer[pos++] = in->end;
+     buffer[pos++] = in->end >> 8;
+     buffer[pos++] = in->days;
+  }
+  return pos;
 }
 
-/** 
- *  Returns the minutes part of time string hh:mm as int
- *  Result will be >=0 and <= 59.
- *  Returns -1 if time format is incorrect or minutes is out of range.
- */
- int OutletTimer::getMinutes(const String& s) {
-   int result = -1;
-   if( (s.indexOf(':') == 2) && (s.length() == 5) && isDigit(s.charAt(3)) && isDigit(s.charAt(4)) ) {
-      result = s.substring(3).toInt();
-      if( result > 59 ) result = -1;
-   }
-   return result;  
+int OutletTimer::restoreConfig(const uint8_t* data, int len) {
+  int pos = SensorControlledRelay::restoreConfig(data,len);
+  if( (pos == 0) || (pos >= len) ) return 0;
+  int n = data[pos++];
+  if( (pos + n*5) > len ) return 0;
+  ScheduleInterval saved[SCHEDULE_MAX_INTERVALS];
+  int previous = saveIntervals(saved);
+  _schedule.clear();
+  for( int i=0; i<n; i++, pos+=5 ) _schedule.add(data[pos] | (data[pos+1] << 8),data[pos+2] | (data[pos+3] << 8),data[pos+4]);
+  if( !compileOrRevert(saved,previous) ) return 0;
+  return pos;
 }
 
-int OutletTimer::argSequenceNumber(const String& argName) {
-   int result = -1;
 /**
- *  argName should be START_TIME_d where d is a digit less than MAX_TIMER_INTERVALS
+ *  Argument name should be START_TIME_n, END_TIME_n, or DAYS_n where n is a number less than SCHEDULE_MAX_INTERVALS
  */
-   if( argName.length() == 12 ) {
-      if(isDigit(argName.charAt(11)) ) result = argName.substring(11,12).toInt();
-   }
-/**
- *  argName should be END_TIME_d where d is a digit less than MAX_TIMER_INTERVALS
- */
-   else if( argName.length() == 10 ) {
-      if(isDigit(argName.charAt(9)) ) result = argName.substring(9,10).toInt();   
-   }
-   
-   if( (result < 0) || (result > MAX_TIMER_INTERVALS) ) result = -1;
-   return result;
+int OutletTimer::argSequenceNumber(ArgView& a) {
+   return ((a.index() < SCHEDULE_MAX_INTERVALS)?(a.index()):(-1));
 }
 
 void OutletTimer::handleGetConfiguration(WebContext* svr) {
-  char buffer[1000];
-  size_t bufferSize = sizeof(buffer);
-  int size = bufferSize;
-  int pos = 0;
-  pos = formatBuffer_P(buffer,size,pos,timer_config_template_head,getDisplayName());
-  for( int i=0; i<MAX_TIMER_INTERVALS; i++ ) {
-     pos = formatBuffer_P(buffer,size,pos,timer_config_template_time,i,_start[i]/60,_start[i]%60,i,i,_end[i]/60,_end[i]%60,i);
+  ContentFormat format = contentFormat(svr);
+  if( format == BINARY_FORMAT ) {
+    svr->send(406,"text/plain","Not Acceptable");
+    return;
+  }
+  boolean json = (format == JSON_FORMAT);
+  ChunkedWriter w(svr,contentType(format));
+  if( json ) {
+    w.printf_P(timer_config_json_head);
+    w.write([this](char buffer[], int size, int pos) {return formatJSONString(buffer,size,pos,this->getDisplayName());});
+    w.printf_P(timer_config_json_list);
+  }
+  else w.printf_P(timer_config_template_head,getDisplayName());
+  for( int i=0; i<_schedule.numIntervals(); i++ ) {
+     const ScheduleInterval* in = _schedule.interval(i);
+     if( json ) w.printf_P(timer_config_json_time,((i>0)?(","):("")),in->start/60,in->start%60,in->end/60,in->end%60,in->days);
+     else w.printf_P(timer_config_template_time,i,in->start/60,in->start%60,i,i,in->end/60,in->end%60,i,i,in->days,i);
   }
-  pos = formatBuffer_P(buffer,size,pos,timer_config_template_tail);
-  if( loggingLevel(FINE) ) Serial.printf("OutletTimer::getOutletTimerConfiguration: Sending %d bytes\n",pos);                             
-  svr->send(200, "text/xml", buffer);     
+  w.printf_P(((json)?(timer_config_json_tail):(timer_config_template_tail)));
 }
 
-} // End of namespace lsc
\ No newline at end of file
+} // End of namespace lsc
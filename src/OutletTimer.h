@@ -25,19 +25,16 @@
 
 #include "SoftwareClock.h"
 #include "SensorControlledRelay.h"
+#include "WeeklySchedule.h"
 
 /** Leelanau Software Company namespace 
 *  
 */
 namespace lsc {
 
-/**
- *   Number of Timer intevals is 2, only because of buffer size
- */
-#define MAX_TIMER_INTERVALS 2
-
 /** OutletTimer is a SensorControlledRelay that couples a SoftwareClock (for time) with a relay in order 
- *  to control a power outlet. 
+ *  to control a power outlet. ON intervals are configured per weekday (up to SCHEDULE_MAX_INTERVALS) and compiled 
+ *  into a WeeklySchedule when the configuration is set, so state and next transition are a binary search.
  *
  *  Extending SensorControlledRelay requires implementation of the following:
  *    1. void configForm(WebConext*) - for displaying a configuration form 
@@ -57,9 +54,19 @@ class OutletTimer : public SensorControlledRelay {
       const char*     nextOn();              // Return time (as char*) of next ON cycle
 
 /**
- *    SensorControlledRelay will poll for Sensor state every 5 secs by default
+ *    Programmatic configuration, days is a weekday mask with bit 0 as Sunday
+ */
+      boolean         addInterval(int start, int end, uint8_t days = ALL_DAYS);   // Start and end in minutes from midnight, false if it does not fit
+      void            clearIntervals()                 {_schedule.clear(); _schedule.compile(); entityTag()->touchConfig(); schedule();}
+      WeeklySchedule* weeklySchedule()                 {return &_schedule;}
+
+/**
+ *    Rather than polling, the SensorControlledRelay Timer is armed for the next ON/OFF transition and recomputed
+ *    on configuration change, mode change, or when the SoftwareClock is synchronized
  */
       virtual ControlState  sensorState();
+      virtual long          nextWakeup();
+      virtual void          relayChanged()   {publishNext();}
 
 /**
 *    Frame height from Control
@@ -73,6 +80,9 @@ class OutletTimer : public SensorControlledRelay {
       const char*      nextON()       {nextCycle(); return _nextON;}
       const char*      nextOFF()      {nextCycle(); return _nextOFF;}
 
+      void             setup(WebContext* svr);
+      void             doDevice();
+
 /**
  *  Set/Get/Check Logging Level provided by RelayControl. Logging Level can be NONE, 
  *  WARNING, INFO, FINE, and FINEST
@@ -84,6 +94,8 @@ class OutletTimer : public SensorControlledRelay {
       void             configForm(WebContext* svr);
       void             handleSetConfiguration(WebContext* svr);
       void             handleGetConfiguration(WebContext* svr); 
+      int              saveConfig(uint8_t buffer[], int size);                   // Intervals follow the SensorControlledRelay image
+      int              restoreConfig(const uint8_t* data, int len);
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
@@ -105,18 +117,24 @@ class OutletTimer : public SensorControlledRelay {
  *    Timer Control Utilities
  */
       SoftwareClock*  getSoftwareClock()     {return (SoftwareClock*)RootDevice::getDevice(rootDevice(),SoftwareClock::classType());}
-      int             getHours(const String& s);               // Returns hours from time string hh:mm
-      int             getMinutes(const String& s);             // Returns minutes from time string hh:mm
-      int             argSequenceNumber(const String& s);      // Returns web form argument sequence number (for example: START_TIME_2), and -1 on error
+      int             argSequenceNumber(ArgView& a);           // Returns web form argument sequence number (for example: START_TIME_2), and -1 on error
+      int             currentMinute(long* secs = NULL);        // Current minute (and second) of the week, -1 if there is no SoftwareClock
       void            nextCycle();                             // Fill nextON and nextOFF buffers based on current time
-      void            printInterval(int currentMins, int start, int end, int nON, int nOFF);
+      void            printTransition(char buffer[], int next, int current);
+      int             formatRow(char buffer[], int size, int pos, int i);   // Configuration form row for interval i
+      void            publishNext();                           // Publish the next transition as event variable "next"
+      int             saveIntervals(ScheduleInterval saved[]); // Copy the configured intervals, returns the count
+      boolean         compileOrRevert(const ScheduleInterval saved[], int n);   // Compile, or put back n saved intervals and return false
 /**
  *    Control Variables
  */
-      int                 _start[MAX_TIMER_INTERVALS] = {0};        // Time is stored as minutes from midnight
-      int                 _end[MAX_TIMER_INTERVALS]   = {0};        // Maximum of MAX_TIMER_INTERVALS start/end intervals allowed, initialized to 0
-      char                _nextON[8];                               // Character representation of next ON hh:mm
-      char                _nextOFF[8];                              // Character representation of next OFF hh:mm
+      WeeklySchedule      _schedule;                                // Configured intervals, compiled on SetConfiguration
+      char                _nextON[16];                              // Character representation of next ON [day] hh:mm
+      char                _nextOFF[16];                             // Character representation of next OFF [day] hh:mm
+      SoftwareClock*      _clock       = NULL;                      // Clock found at setup, watched for synchronization
+      unsigned long       _syncCount   = 0;
+      ControlState        _published   = OFF;                       // Relay state when "next" was last published
+      unsigned long       _publishedAt = 0;
 
 /**
  *   Copy construction and assignment are not allowed
@@ -0,0 +1,78 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "PathTable.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+PathTable* PathTable::shared() {
+  static PathTable table;
+  return &table;
+}
+
+/**
+ *  Linear search of the pool; it is used from setup(), and once per handler by HandlerMetrics. A string that does not fit in the pool is duplicated 
+ *  on the heap so callers can always keep the returned pointer.
+ */
+const char* PathTable::intern(const char* s) {
+  if( s == NULL ) s = "";
+  for( int i=0; i<_used; i+=strlen(_pool+i)+1 ) {if( strcmp(_pool+i,s) == 0 ) return _pool+i;}
+  int len = strlen(s) + 1;
+  if( _used + len > PATH_TABLE_SIZE ) {
+    char* result = strdup(s);
+    if( result == NULL ) return "";
+    _overflow += len;
+    return result;
+  }
+  char* result = _pool + _used;
+  memcpy(result,s,len);
+  _used += len;
+  return result;
+}
+
+const char* PathTable::path(UPnPObject* obj) {
+  char buffer[PATH_MAX_LENGTH];
+  buffer[0] = '\0';
+  if( obj != NULL ) obj->getPath(buffer,PATH_MAX_LENGTH);
+  return intern(buffer);
+}
+
+const char* PathTable::handlerPath(UPnPObject* obj, const char* name) {
+  char buffer[PATH_MAX_LENGTH];
+  buffer[0] = '\0';
+  if( obj != NULL ) obj->handlerPath(buffer,PATH_MAX_LENGTH,name);
+  return intern(buffer);
+}
+
+void PathTable::paths(DevicePaths& p, UPnPObject* device, SetConfiguration* svc) {
+  char buffer[PATH_MAX_LENGTH];
+  p.device = path(device);
+  p.action = path(svc);
+  buffer[0] = '\0';
+  if( svc != NULL ) svc->formPath(buffer,PATH_MAX_LENGTH);
+  p.form   = intern(buffer);
+}
+
+} // End of namespace lsc
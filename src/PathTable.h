@@ -0,0 +1,89 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <UPnPLib.h>
+#include "ConfigurationServices.h"
+
+/**
+ *   Bytes of the shared path pool. Paths that do not fit are copied to the heap once instead, see PathTable::intern().
+ */
+#ifndef PATH_TABLE_SIZE
+#define PATH_TABLE_SIZE      1024
+#endif
+#define PATH_MAX_LENGTH      100
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *   Interned paths every configurable device renders: its own path (Cancel buttons, inline base), the setConfiguration
+ *   service path (form action), and the configForm path (Configure button). Empty until the device's setup().
+ */
+typedef struct DevicePaths {
+  const char*     device  = "";
+  const char*     action  = "";
+  const char*     form    = "";
+} DevicePaths;
+
+/** PathTable interns device, handler and service paths into one compact pool of NUL terminated strings. Devices 
+ *  intern their paths once from setup(), after the device tree (and so every path) is final, and render from the
+ *  returned pointers instead of walking the tree with getPath()/handlerPath() into stack buffers on each request.
+ *  Identical paths are stored once, so calling setup() again does not grow the table. Interned strings are never 
+ *  released.
+ *  Usage, in setup():
+ *      PathTable::shared()->paths(_paths,this,setConfigurationSvc());
+ *      _dryPath = PathTable::shared()->handlerPath(this,"acquireDry");
+ *      svr->on(_dryPath,[this](WebContext* svr){this->acquireDry(svr);});
+ */
+class PathTable {
+  public:
+    PathTable() {}
+
+    const char*       intern(const char* s);                                   // Never NULL
+    const char*       path(UPnPObject* obj);                                   // Interned getPath()
+    const char*       handlerPath(UPnPObject* obj, const char* name);          // Interned handlerPath()
+    void              paths(DevicePaths& p, UPnPObject* device, SetConfiguration* svc);
+
+    int               used()                     {return _used;}
+    int               overflow()                 {return _overflow;}           // Bytes interned on the heap
+
+    static PathTable* shared();
+
+  private:
+    char              _pool[PATH_TABLE_SIZE];
+    int               _used       = 0;
+    int               _overflow   = 0;
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(PathTable);
+};
+
+} // End of namespace lsc
+
+#endif
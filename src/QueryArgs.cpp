@@ -0,0 +1,107 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "QueryArgs.h"
+#include <limits.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *  One pass over the name computes the hash, the prefix hash at the last '_', and the index following it.
+ */
+ArgView::ArgView(const char* name, const char* value) : _name(((name!=NULL)?(name):(""))), _value(((value!=NULL)?(value):(""))) {
+  const char* last = NULL;
+  for( const char* p=_name; *p != '\0'; p++ ) {
+    char c = *p;
+    _hash = (uint32_t)((_hash ^ (uint8_t)(((c >= 'a') && (c <= 'z'))?(c - ('a'-'A')):(c)))*ARG_HASH_PRIME);
+    if( c == '_' ) {
+      _prefix = _hash;
+      last    = p;
+    }
+  }
+  long n = -1;
+  if( (last != NULL) && isDigit(last[1]) && (strlen(last+1) <= 2) && QueryArgs::parseInt(last+1,n) ) _index = n;
+}
+
+boolean ArgView::toInt(long& result)                      {return QueryArgs::parseInt(_value,result);}
+boolean ArgView::toTime(int& hours, int& minutes)         {return QueryArgs::parseTime(_value,hours,minutes);}
+boolean ArgView::toOffset(int& hours, int& minutes)       {return QueryArgs::parseOffset(_value,hours,minutes);}
+
+boolean QueryArgs::parseInt(const char* s, long& result) {
+  return ((s != NULL) && parseInt(s,strlen(s),result));
+}
+
+/**
+ *  Exactly len characters are parsed, so a field can be read from the middle of a string. Values that would
+ *  overflow a long are rejected.
+ */
+boolean QueryArgs::parseInt(const char* s, int len, long& result) {
+  int  i        = 0;
+  bool negative = false;
+  if( (len > 0) && ((s[0] == '-') || (s[0] == '+')) ) {
+    negative = (s[0] == '-');
+    i++;
+  }
+  if( i >= len ) return false;
+  long value = 0;
+  for( ; i<len; i++ ) {
+    if( !isDigit(s[i]) ) return false;
+    int d = s[i] - '0';
+    if( value > (LONG_MAX - d)/10 ) return false;
+    value = value*10 + d;
+  }
+  result = ((negative)?(-value):(value));
+  return true;
+}
+
+boolean QueryArgs::parseTime(const char* s, int& hours, int& minutes) {
+  long h = 0;
+  long m = 0;
+  if( (s == NULL) || (strlen(s) != 5) || (s[2] != ':') || !isDigit(s[0]) || !isDigit(s[3]) ) return false;
+  if( !parseInt(s,2,h) || !parseInt(s+3,2,m) || (h > 23) || (m > 59) ) return false;
+  hours   = h;
+  minutes = m;
+  return true;
+}
+
+boolean QueryArgs::parseOffset(const char* s, int& hours, int& minutes) {
+  if( s == NULL ) return false;
+  int sign = 1;
+  if( (*s == '-') || (*s == '+') ) {
+    sign = ((*s == '-')?(-1):(1));
+    s++;
+  }
+  const char* colon = strchr(s,':');
+  int  len = ((colon!=NULL)?(colon-s):(strlen(s)));
+  long h   = 0;
+  long m   = 0;
+  if( (len < 1) || (len > 2) || !isDigit(*s) || !parseInt(s,len,h) || (h > 23) ) return false;
+  if( (colon != NULL) && ((strlen(colon+1) != 2) || !isDigit(colon[1]) || !parseInt(colon+1,2,m) || (m > 59)) ) return false;
+  hours   = sign*h;
+  minutes = sign*m;
+  return true;
+}
+
+} // End of namespace lsc
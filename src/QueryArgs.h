@@ -0,0 +1,123 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef QUERY_ARGS_H
+#define QUERY_ARGS_H
+
+/**
+ *   The parsers and ArgView only depend on the Arduino core, so they can also be compiled on a host; QueryArgs needs
+ *   the Web server
+ */
+#ifdef ARDUINO
+#include <UPnPLib.h>
+#else
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+typedef bool boolean;
+inline boolean isDigit(int c) {return isdigit(c) != 0;}
+class WebContext;
+#endif
+
+#define ARG_HASH_SEED   2166136261UL
+#define ARG_HASH_PRIME  16777619UL
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *   Case-insensitive FNV-1a hash of an argument name. A constant name is hashed by the compiler, so argHash("STATE")
+ *   can be used as a case label; ArgView hashes request argument names the same way at run time.
+ */
+constexpr uint32_t argHash(const char* s, uint32_t h = ARG_HASH_SEED) {
+  return ((*s == '\0')?(h):(argHash(s+1,(uint32_t)((h ^ (uint8_t)(((*s >= 'a') && (*s <= 'z'))?(*s - ('a'-'A')):(*s)))*ARG_HASH_PRIME))));
+}
+
+/** ArgView is a request argument borrowed from the Web server: name and value point into the server's own argument 
+ *  Strings and are only valid while the request is handled. Nothing is copied or allocated. Repeated form arguments
+ *  (START_TIME_2) are split at the last '_' into prefix(), the hash of "START_TIME_", and index(), 2.
+ */
+class ArgView {
+  public:
+    ArgView(const char* name, const char* value);
+
+    const char*      name()                         {return _name;}
+    const char*      value()                        {return _value;}
+    uint32_t         hash()                         {return _hash;}                // argHash() of the name
+    uint32_t         prefix()                       {return _prefix;}              // argHash() of the name through its last '_', 0 if none
+    int              index()                        {return _index;}               // 1 or 2 digits after the last '_', -1 if none
+    boolean          empty()                        {return *_value == '\0';}
+    boolean          is(const char* value)          {return strcasecmp(_value,value) == 0;}
+
+    boolean          toInt(long& result);
+    boolean          toTime(int& hours, int& minutes);
+    boolean          toOffset(int& hours, int& minutes);
+
+  private:
+    const char*      _name;
+    const char*      _value;
+    uint32_t         _hash   = ARG_HASH_SEED;
+    uint32_t         _prefix = 0;
+    int              _index  = -1;
+};
+
+/** QueryArgs iterates the arguments of a request as ArgViews, and parses values in place. Handlers switch on the name hash:
+ *      QueryArgs args(svr);
+ *      for( int i=0; i<args.count(); i++ ) {
+ *         ArgView a = args.arg(i);
+ *         switch( a.hash() ) {
+ *            case argHash("THRESHOLD"):   {long t; if( a.toInt(t) ) setThreshold(t);} break;
+ *            case argHash("DISPLAYNAME"): if( !a.empty() ) setDisplayName(a.value()); break;
+ *         }
+ *      }
+ */
+class QueryArgs {
+  public:
+#ifdef ARDUINO
+    QueryArgs(WebContext* svr) : _svr(svr), _count(svr->argCount()) {}
+
+    int              count()                        {return _count;}
+    ArgView          arg(int i)                     {return ArgView(_svr->argName(i).c_str(),_svr->arg(i).c_str());}
+#endif
+
+/**
+ *   Parsers return false, leaving results unchanged, unless the whole string is well formed:
+ *      parseInt     [+-]digits
+ *      parseTime    hh:mm, hours 0-23 and minutes 0-59
+ *      parseOffset  [+-]h[h][:mm], hours 0-23 and minutes 0-59; minutes take the sign of the offset (-05:30 is -5 and -30)
+ */
+    static boolean   parseInt(const char* s, long& result);
+    static boolean   parseInt(const char* s, int len, long& result);
+    static boolean   parseTime(const char* s, int& hours, int& minutes);
+    static boolean   parseOffset(const char* s, int& hours, int& minutes);
+
+  private:
+    WebContext*      _svr;
+    int              _count;
+};
+
+} // End of namespace lsc
+
+#endif
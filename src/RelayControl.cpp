@@ -27,20 +27,37 @@
 */
 namespace lsc {
 
-const char on_msg[]     PROGMEM = "<br><div align=\"center\">Relay is ON</div>";
-const char off_msg[]    PROGMEM = "<br><div align=\"center\">Relay is OFF</div>";
+const char relay_msg[]   PROGMEM = "<br><div align=\"center\">Relay is <span data-ev=\"state\">%s</span></div>";
 
 /**
- * Relay Slider ON
+ * Relay Slider, takes the state to toggle to, checked attribute, and current state as arguments
  */
-const char relay_on[]   PROGMEM = "<div align=\"center\"><a href=\"./setState?STATE=OFF\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\" checked>"
-                                   "<span class=\"toggle-switch\"></span></a>&emsp;Relay ON</div>";
+const char relay_toggle[] PROGMEM = "<div align=\"center\"><a href=\"./setState?STATE=%s\" class=\"toggle\" data-ev=\"state\" data-values=\"ON,OFF\" data-set=\"./setState?STATE=\">"
+                                   "<input class=\"toggle-checkbox\" type=\"checkbox\"%s><span class=\"toggle-switch\"></span></a>&emsp;Relay <span data-ev=\"state\">%s</span></div>";
 
 /**
- * Relay Slider OFF
+ * Updates the page in place: toggles are sent with fetch and answered with the changed event variables as JSON, and
+ * the device event stream pushes changes made elsewhere. Elements bound to a variable carry data-ev="name"; a toggle 
+ * has data-values="checked,unchecked" and data-set (the href prefix), data-show shows an element only for one value, 
+ * and data-t_<value> replaces the displayed text. On a composite root page each Control is a [data-base] fragment with 
+ * its own stream, otherwise the page is a single Control with base "./". Without script support the toggles remain 
+ * plain links.
  */
-const char relay_off[]  PROGMEM = "<div align=\"center\">&ensp;<a href=\"./setState?STATE=ON\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\">"
-                                   "<span class=\"toggle-switch\"></span></a>&emsp;Relay OFF</div>";
+const char relay_script[] PROGMEM = "<script>(function(){"
+  "function up(r,d){for(var k in d){var v=d[k],l=r.querySelectorAll('[data-ev=\"'+k+'\"]');"
+  "for(var i=0;i<l.length;i++){var e=l[i],s=e.dataset;"
+  "if(s.values){var a=s.values.split(','),on=(v==a[0]);e.firstChild.checked=on;e.href=s.set+(on?a[1]:a[0]);}"
+  "else if(s.show)e.style.display=((v==s.show)?'':'none');"
+  "else e.textContent=s['t_'+v.toLowerCase()]||v;}}}"
+  "function listen(r,b){if(window.EventSource)new EventSource(b+'events').onmessage=function(m){up(r,JSON.parse(m.data));};}"
+  "if(window.fetch)document.addEventListener('click',function(ev){var a=ev.target.closest('a.toggle');if(!a)return;ev.preventDefault();"
+  "var r=a.closest('[data-base]')||document;"
+  "fetch(a.href,{headers:{Accept:'application/json'}}).then(function(x){return x.json();}).then(function(d){up(r,d);});});"
+  "var f=document.querySelectorAll('[data-base]');"
+  "if(f.length==0)listen(document,'./');else for(var i=0;i<f.length;i++)listen(f[i],f[i].dataset.base);"
+  "})();</script>";
+const char relay_ack_head[] PROGMEM = "{";
+const char relay_ack_tail[] PROGMEM = "}";
 
 /**
  *  Static RTT initialization
@@ -48,14 +65,14 @@ const char relay_off[]  PROGMEM = "<div align=\"center\">&ensp;<a href=\"./setSt
 INITIALIZE_DEVICE_TYPES(RelayControl,LeelanauSoftware-com,RelayControl,1.0.0);
 
 RelayControl::RelayControl() : Control("RelayControl"), _setStateSvc("setState") {
-  addService(setStateSvc());
-  setStateSvc()->setHttpHandler([this](WebContext* svr){this->setState(svr);});
+  addServices(setStateSvc(),eventSvc());
+  setStateSvc()->setHttpHandler(HandlerMetrics::timed(setStateSvc(),[this](WebContext* svr){this->setState(svr);}));
   setDisplayName("Relay Control");
 }
 
 RelayControl::RelayControl(const char* target) : Control(target), _setStateSvc("setState") {
-  addService(setStateSvc());
-  setStateSvc()->setHttpHandler([this](WebContext* svr){this->setState(svr);});
+  addServices(setStateSvc(),eventSvc());
+  setStateSvc()->setHttpHandler(HandlerMetrics::timed(setStateSvc(),[this](WebContext* svr){this->setState(svr);}));
   setDisplayName("Relay Control");
 }
 
@@ -63,32 +80,41 @@ RelayControl::RelayControl(const char* target) : Control(target), _setStateSvc("
  *  The only expected arguments are STATE=ON or STATE=OFF, all other arguments are ignored
  */
 void RelayControl::setState(WebContext* svr) {
-   int numArgs = svr->argCount();
-   if( numArgs > 0 ) {
-      for( int i=0; i<numArgs; i++ ) {
-         const String& argName = svr->argName(i);
-         const String& argVal = svr->arg(i);
-         if(argName.equalsIgnoreCase("STATE")) {
-            if( loggingLevel(FINE) ) Serial.printf("RelayControl::setState: Setting STATE to %s\n",argVal.c_str());
-            if( argVal.equalsIgnoreCase("ON")) setControlState(ON);
-            else if( argVal.equalsIgnoreCase("OFF") ) setControlState(OFF);
-            break;
-          }
-       }
+   QueryArgs args(svr);
+   for( int i=0; i<args.count(); i++ ) {
+      ArgView a = args.arg(i);
+      if( a.hash() == argHash("STATE") ) {
+         if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_REQUEST,this,((a.is("ON"))?(ON):((a.is("OFF"))?(OFF):(-1))));
+         if( a.is("ON") ) setControlState(ON);
+         else if( a.is("OFF") ) setControlState(OFF);
+         break;
+      }
    }
-   displayControl(svr);
+   acknowledge(svr);
 }
 
+/**
+ *  A script toggle (Accept: application/json) only needs the event variables, which are a few dozen bytes; 
+ *  otherwise the whole Control is redisplayed.
+ */
+void RelayControl::acknowledge(WebContext* svr) {
+  if( contentFormat(svr) != JSON_FORMAT ) {
+    displayControl(svr);
+    return;
+  }
+  char buffer[128];
+  int pos = formatBuffer_P(buffer,128,0,relay_ack_head);
+  pos = _events.formatJSON(buffer,128,pos);
+  pos = formatBuffer_P(buffer,128,pos,relay_ack_tail);
+  svr->send(200,"application/json",buffer);
+}
+
+PGM_P RelayControl::controlScript() {return relay_script;}
+
 int  RelayControl::formatContent(char buffer[], int size, int pos) {  
-  if( loggingLevel(FINE) ) Serial.printf("RelayControl::content: %s Relay state is %s \n",getDisplayName(),controlState());
-  if( isON() ) {
-    pos = formatBuffer_P(buffer,size,pos,relay_on);  
-    pos = formatBuffer_P(buffer,size,pos,on_msg);          
-  }        
-  else {
-    pos = formatBuffer_P(buffer,size,pos,relay_off); 
-    pos = formatBuffer_P(buffer,size,pos,off_msg);          
-  }  
+  if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_CONTENT,this,getControlState());
+  pos = formatBuffer_P(buffer,size,pos,relay_toggle,((isON())?("OFF"):("ON")),((isON())?(" checked"):("")),controlState());  
+  pos = formatBuffer_P(buffer,size,pos,relay_msg,controlState());          
   return pos;       
 }
 
@@ -100,22 +126,24 @@ void RelayControl::setControlState(ControlState flag) {
  */
   if(flag == ON) {
     digitalWrite(pin(),HIGH);
-    if( loggingLevel(FINE) ) Serial.printf("RelayControl::setControlState: %s Relay turned ON, set to %d\n", getDisplayName(),HIGH);
+    if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_SET,this,ON,HIGH);
   }
 /**
  *  Otherwise send LOW
  */
   else {
     digitalWrite(pin(),LOW);
-    if( loggingLevel(FINE) ) Serial.printf("RelayControl::setControlState: %s Relay turned OFF, set to %d\n",getDisplayName(), LOW);
+    if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_SET,this,OFF,LOW);
   }
+  _events.set("state",controlState());
 }
 
 void RelayControl::setup(WebContext* svr) {
   Control::setup(svr);
   pinMode(pin(),OUTPUT);
   digitalWrite(pin(),LOW);
-  if( loggingLevel(FINE) )  Serial.printf("RelayControl::setup: %s pin %d set to %s\n",getDisplayName(),pin(),controlState());
+  _events.set("state",controlState());
+  if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_SETUP,this,pin(),getControlState());
 
 }
 
@@ -26,6 +26,7 @@
 #include <CommonProgmem.h>
 #include "Control.h"
 #include "ControlServices.h"
+#include "EventServices.h"
 
 /** Leelanau Software Company namespace 
 *  
@@ -46,6 +47,11 @@ namespace lsc {
  *  Note that the digital pin is initialized in setup() so pin definition must happen prior to setup() being called, either when setup() is called
  *  on a RootDevice containing RelayControl, or RelayControl is added to the RootDevice after setup().
  *  Configuration support is provided by Control allowing  deviceName definition
+ *  Relay state is published as the event variable "state" through the EventService eventSvc(), so subscribers are
+ *  notified from doDevice() when setControlState() changes it. The same variables drive the Control page: displayControl()
+ *  adds a script (see controlScript()) that listens on the event stream of eventSvc() and updates elements marked 
+ *  data-ev="name" in place, and sends toggles with fetch, answered by acknowledge() with the variables as JSON rather 
+ *  than a whole page.
  */
 
 class RelayControl : public Control {
@@ -61,7 +67,10 @@ class RelayControl : public Control {
  *    Relay state management
  */
       void            setState(WebContext* svr);                                                        // HttpHandler for setting ControlState
+      void            acknowledge(WebContext* svr);                                                     // Respond to a toggle with JSON state or the Control display
       UPnPService*    setStateSvc()               {return &_setStateSvc;}                               // UPnPService for setting ControlState
+      EventService*   eventSvc()                  {return &_events;}                                    // UPnPService for state change events
+      virtual int     formatSnapshot(char buffer[], int size, int pos)  {return _events.formatVariables(buffer,size,pos);}  // State (and mode) for the ExtendedDevice snapshot
       
       boolean         isON()                      {return(getControlState() == ON);}                    // Returns TRUE if the relay is ON
       boolean         isOFF()                     {return(getControlState() == OFF);}                   // Returns TRUE if the relay is OFF
@@ -78,7 +87,10 @@ class RelayControl : public Control {
  *    Display this Control
  */
       int              formatContent(char buffer[], int size, int pos);
+      PGM_P            controlScript();
+      uint32_t         stateGeneration()          {return Control::stateGeneration() + _events.changes();}   // Displayed state is the event variables
       void             setup(WebContext* svr);
+      void             doDevice()                 {_events.doDevice();}
  
 /**
  *  Set/Get/Check Logging Level. Logging Level can be NONE, WARNING, INFO, FINE, and FINEST
@@ -104,6 +116,7 @@ class RelayControl : public Control {
       protected:
       virtual void        setControlState(ControlState flag);            
       SetStateService     _setStateSvc;
+      EventService        _events;
 
 /**
  *    Control Variables
@@ -31,28 +31,18 @@ const char msg_display[]     PROGMEM = "<br><div align=\"center\">%s</div>";
 
 const char table_start[]     PROGMEM = "<div align=\"center\"><table>";
 
-// Control State = ON
-const char table_state_ON[]  PROGMEM = "<tr>"
-        "<td><a href=\"./setState?STATE=OFF\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\" checked><span class=\"toggle-switch\"></span></a></td>"
-        "<td>&ensp;ON</td>"
+// Control State, takes the state to toggle to, checked attribute, and current state as arguments
+const char table_state[]     PROGMEM = "<tr>"
+        "<td><a href=\"./setState?STATE=%s\" class=\"toggle\" data-ev=\"state\" data-values=\"ON,OFF\" data-set=\"./setState?STATE=\">"
+        "<input class=\"toggle-checkbox\" type=\"checkbox\"%s><span class=\"toggle-switch\"></span></a></td>"
+        "<td>&ensp;<span data-ev=\"state\">%s</span></td>"
       "</tr>";
 
-// Control State = OFF
-const char table_state_OFF[] PROGMEM = "<tr>"
-        "<td><a href=\"./setState?STATE=ON\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\"><span class=\"toggle-switch\"></span></a></td>"
-        "<td>&ensp;OFF</td>"
-      "</tr>";
-
-// Control Mode = AUTOMATIC
-const char table_mode_AUTO[]  PROGMEM = "<tr>"
-        "<td><a href=\"./setMode?MODE=MANUAL\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\" checked><span class=\"toggle-switch\"></span></a></td>"
-        "<td>&ensp;Automatic</td>"
-      "</tr>";
-
-// Control Mode = MANUAL
-const char table_mode_MAN[] PROGMEM = "<tr>"
-        "<td><a href=\"./setMode?MODE=AUTOMATIC\" class=\"toggle\"><input class=\"toggle-checkbox\" type=\"checkbox\"><span class=\"toggle-switch\"></span></a></td>"
-        "<td>&ensp;Manual&ensp;&ensp;</td>"
+// Control Mode, takes the mode to toggle to, checked attribute, and current mode display as arguments
+const char table_mode[]      PROGMEM = "<tr>"
+        "<td><a href=\"./setMode?MODE=%s\" class=\"toggle\" data-ev=\"mode\" data-values=\"AUTOMATIC,MANUAL\" data-set=\"./setMode?MODE=\">"
+        "<input class=\"toggle-checkbox\" type=\"checkbox\"%s><span class=\"toggle-switch\"></span></a></td>"
+        "<td>&ensp;<span data-ev=\"mode\" data-t_automatic=\"Automatic\" data-t_manual=\"Manual\">%s</span></td>"
       "</tr>";
     
 const char table_tail[]      PROGMEM = "</table><br></div>";
@@ -87,7 +77,7 @@ INITIALIZE_DEVICE_TYPES(SensorControlledRelay,LeelanauSoftware-com,SensorControl
 SensorControlledRelay::SensorControlledRelay() : RelayControl("SensorControlledRelay"), _setModeSvc("setMode") {
   
   addService(setModeSvc());
-  setModeSvc()->setHttpHandler([this](WebContext* svr){this->setMode(svr);});
+  setModeSvc()->setHttpHandler(HandlerMetrics::timed(setModeSvc(),[this](WebContext* svr){this->setMode(svr);}));
   setDisplayName("Sensor Controlled Relay");
   sensorRefresh(SENSOR_REFRESH);
   _timer.setHandler([this]{this->timerCallback();});
@@ -95,19 +85,17 @@ SensorControlledRelay::SensorControlledRelay() : RelayControl("SensorControlledR
 
 SensorControlledRelay::SensorControlledRelay(const char* target) : RelayControl(target), _setModeSvc("setMode") {
   addService(setModeSvc());
-  setModeSvc()->setHttpHandler([this](WebContext* svr){this->setMode(svr);});
+  setModeSvc()->setHttpHandler(HandlerMetrics::timed(setModeSvc(),[this](WebContext* svr){this->setMode(svr);}));
   setDisplayName("Sensor Controlled Relay");
   sensorRefresh(SENSOR_REFRESH);
   _timer.setHandler([this]{this->timerCallback();});
 }
 
 int  SensorControlledRelay::formatContent(char buffer[], int size, int pos) {  
-  if( loggingLevel(FINE) ) Serial.printf("SensorControlledRelay::formatContent: %s Relay state is %s and mode is %s\n",getDisplayName(),controlState(),controlMode());
+  if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_SCR_CONTENT,this,getControlState(),_mode);
   pos = formatBuffer_P(buffer,size,pos,table_start);
-  if( isAUTOMATIC() ) pos = formatBuffer_P(buffer,size,pos,table_mode_AUTO);
-  else pos = formatBuffer_P(buffer,size,pos,table_mode_MAN);
-  if( isON() ) pos = formatBuffer_P(buffer,size,pos,table_state_ON);         
-  else pos = formatBuffer_P(buffer,size,pos,table_state_OFF);  
+  pos = formatBuffer_P(buffer,size,pos,table_mode,((isAUTOMATIC())?("MANUAL"):("AUTOMATIC")),((isAUTOMATIC())?(" checked"):("")),((isAUTOMATIC())?("Automatic"):("Manual")));
+  pos = formatBuffer_P(buffer,size,pos,table_state,((isON())?("OFF"):("ON")),((isON())?(" checked"):("")),controlState());  
   pos = formatBuffer_P(buffer,size,pos,table_tail);
   return pos;        
 }
@@ -117,10 +105,10 @@ int  SensorControlledRelay::formatContent(char buffer[], int size, int pos) {
  *   to change mode to MANUAL as well.
  */
 void SensorControlledRelay::setControlState(ControlState flag) {
-   if(loggingLevel(FINE)) Serial.printf("SensorControlledRelay::setControlState: Relay state is %s, setting state to %s\n",controlState(),((flag==ON)?("ON"):("OFF")));
+   if(loggingLevel(FINE)) TraceBuffer::shared()->record(TRACE_SCR_STATE,this,getControlState(),flag);
    relayState(flag);
    if(isAUTOMATIC()) {
-     if(loggingLevel(FINE)) Serial.printf("SensorControlledRelay::setControlState setting mode to MANUAL\n");
+     if(loggingLevel(FINE)) TraceBuffer::shared()->record(TRACE_SCR_MANUAL,this);
      setControlMode(MANUAL);
    }
 }
@@ -130,44 +118,88 @@ void SensorControlledRelay::setControlState(ControlState flag) {
  *   then the state may also need to change.
  */
 void SensorControlledRelay::setControlMode(ControlMode flag) {
+   if( _mode != flag ) entityTag()->touchConfig();
    _mode = flag;
-   if( loggingLevel(FINE) ) Serial.printf("SensorControlledRelay::setControlMode ControlMode set to %s\n",controlMode());
+   _events.set("mode",controlMode());
+   if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_SCR_MODE,this,_mode);
    if(isAUTOMATIC()) {
      ControlState state = sensorState();
      if( relayState() != state ) {
-       if( loggingLevel(FINE) ) Serial.printf("SensorControlledRelay::setControlMode: resetting controlState to %s\n",controlState());
+       if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_SCR_RESET,this,state);
        relayState(state);
      }
    }
+   schedule();
 }
 
 /**
  *  The only expected arguments are MODE=AUTOMATIC or MOD=MANUAL, all other arguments are ignored
  */
 void SensorControlledRelay::setMode(WebContext* svr) {
-   int numArgs = svr->argCount();
-   if( numArgs > 0 ) {
-      for( int i=0; i<numArgs; i++ ) {
-         const String& argName = svr->argName(i);
-         const String& argVal = svr->arg(i);
-         if(argName.equalsIgnoreCase("MODE")) {
-            if( loggingLevel(FINE) ) Serial.printf("SensorControlledRelay::setMode: Setting MODE to %s\n",argVal.c_str());
-            if( argVal.equalsIgnoreCase("AUTOMATIC")) setControlMode(AUTOMATIC);
-            else if( argVal.equalsIgnoreCase("MANUAL") ) setControlMode(MANUAL);
-            break;
-          }
-       }
+   QueryArgs args(svr);
+   for( int i=0; i<args.count(); i++ ) {
+      ArgView a = args.arg(i);
+      if( a.hash() == argHash("MODE") ) {
+         if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_SCR_REQUEST,this,((a.is("AUTOMATIC"))?(AUTOMATIC):((a.is("MANUAL"))?(MANUAL):(-1))));
+         if( a.is("AUTOMATIC") ) setControlMode(AUTOMATIC);
+         else if( a.is("MANUAL") ) setControlMode(MANUAL);
+         break;
+      }
    }
-   displayControl(svr);
+   acknowledge(svr);
+}
+
+int SensorControlledRelay::saveConfig(uint8_t buffer[], int size) {
+  int pos = RelayControl::saveConfig(buffer,size);
+  if( (pos == 0) || (pos >= size) ) return 0;
+  buffer[pos++] = (uint8_t)_mode;
+  return pos;
+}
+
+/**
+ *  Called before setup(), which publishes mode and arms the Timer
+ */
+int SensorControlledRelay::restoreConfig(const uint8_t* data, int len) {
+  int pos = RelayControl::restoreConfig(data,len);
+  if( (pos == 0) || (pos >= len) ) return 0;
+  _mode = ((data[pos++] == AUTOMATIC)?(AUTOMATIC):(MANUAL));
+  return pos;
 }
 
 void SensorControlledRelay::setup(WebContext* svr) {
   RelayControl::setup(svr);
+  _events.set("mode",controlMode());
   lastSensorState(getControlState());
+  schedule();
+}
+
+/**
+ *  Set relay state according to the Sensor unless the toggle has been triggered, as indicated by mode having been
+ *  set to MANUAL; the Sensor will not effect a change to ControlState unless mode is AUTOMATIC. Then wake at the
+ *  subclass deadline if there is one, otherwise poll every sensorRefresh() seconds. nextWakeup() is the next change 
+ *  away from the current sensorState(), so state must be applied first: an interval added (or a clock resync) that
+ *  covers now would otherwise be skipped until its end.
+ */
+void SensorControlledRelay::schedule() {
+  ControlState state = sensorState();
+  if( sensorStateChange(state) ) lastSensorState(state);
+
+/**
+ *  RelayState is set ONLY if it's different from the actual relay, and mode is AUTOMATIC.
+ */
+  if( !isRelayState(state) && isAUTOMATIC() ) relayState(state);
+  long ms = nextWakeup();
+  if( ms < 0 ) ms = _refresh*1000L;
+  else if( ms == 0 ) ms = 1;
+  if( loggingLevel(FINEST) ) TraceBuffer::shared()->record(TRACE_SCR_SCHEDULE,this,ms);
+  _timer.set(ms);
+  _timer.reset();
   _timer.start();
 }
 
 void SensorControlledRelay::doDevice() {
+  RelayControl::doDevice();
+  LoopScope scope(this,"timer");
   _timer.doDevice();
 }
 
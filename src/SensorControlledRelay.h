@@ -31,7 +31,7 @@
 namespace lsc {
 
 /**
- *   How often to poll the Sensor (in seconds)
+ *   How often to poll the Sensor (in seconds), unless the subclass supplies its next wakeup (see nextWakeup())
  */
 #define SENSOR_REFRESH 5
 
@@ -42,7 +42,7 @@ namespace lsc {
  *  also trips the mode toggle.
  *  
  *  Relay state management, pin definition, and logging all come from RelayControl and a new UPnPService is added to set
- *  ControlMode. SensorControlledRelay is a virtual base class deriving from RelayControl, and as such, subclasses must 
+ *  ControlMode. ControlMode is published as the event variable "mode" alongside "state" from RelayControl. SensorControlledRelay is a virtual base class deriving from RelayControl, and as such, subclasses must 
  *  supply implementation for the following method:
  *     ControlState sensorState() := Returns ControlState according to the Sensor
  *  Note that in the semantics below, sensorState refers to the ControlState that the Sensor indicates, and relayState 
@@ -86,8 +86,23 @@ class SensorControlledRelay : public RelayControl {
 /**
  *    Sensor refresh rate (polling interval)
  */
-      int             sensorRefresh()               {return _timer.setPointMillis()/1000;}
-      void            sensorRefresh(int secs)       {if( secs > 0 ) _timer.set(secs*1000);}
+      int             sensorRefresh()               {return _refresh;}
+      void            sensorRefresh(int secs)       {if( secs > 0 ) _refresh = secs;}
+
+/**
+ *    Milliseconds until sensorState() can next change, or -1 if unknown. A subclass that can compute this (for example 
+ *    from a schedule) overrides it, so the Timer is armed once per transition rather than polling every sensorRefresh()
+ *    seconds. The deadline is relative to the current sensorState(), so schedule() applies it first; subclasses call
+ *    schedule() whenever the answer may have changed (configuration, clock change).
+ */
+      virtual long    nextWakeup()                  {return -1;}
+
+/**
+ *    ControlMode is kept by ConfigStore after the Control configuration image. Relay state is not, the Sensor 
+ *    (or MANUAL default OFF) decides it after a restart.
+ */
+      int             saveConfig(uint8_t buffer[], int size);
+      int             restoreConfig(const uint8_t* data, int len);
 
 /**
  *    These methods make explicit the difference between the actual state of the relay and the state as determined
@@ -95,7 +110,8 @@ class SensorControlledRelay : public RelayControl {
  */
       virtual ControlState  sensorState() = 0;
       ControlState          relayState()                 {return getControlState();}            // From RelayControl
-      void                  relayState(ControlState s)   {RelayControl::setControlState(s);}    // Set relay state via RelayControl
+      void                  relayState(ControlState s)   {RelayControl::setControlState(s); relayChanged();}    // Set relay state via RelayControl
+      virtual void          relayChanged()               {}                                     // After every relay state change, from a handler or schedule()
 
 /**
 *    Frame height from Control
@@ -137,6 +153,7 @@ class SensorControlledRelay : public RelayControl {
       
       void             setControlState(ControlState s);
       void             setControlMode(ControlMode mode); 
+      void             schedule();                                               // Evaluate the Sensor now and arm the Timer for the next evaluation
       void             lastSensorState(ControlState s)    {_sensorState = s;}
       ControlState     lastSensorState()                  {return _sensorState;}
       bool             sensorStateChange(ControlState s)  {return(s == _sensorState);}
@@ -147,6 +164,7 @@ class SensorControlledRelay : public RelayControl {
  */
       ControlMode         _mode          = MANUAL;          // AUTOMATIC/MANUAL triggered by the toggle
       ControlState        _sensorState   = OFF;             // Last measured ControlState by Sensor
+      int                 _refresh       = SENSOR_REFRESH;  // Polling interval in seconds
       Timer               _timer;
 
 /**
@@ -155,20 +173,9 @@ class SensorControlledRelay : public RelayControl {
      DEFINE_EXCLUSIONS(SensorControlledRelay);         
 
 /**
- *    Timer callback sets relay state according to the Sensor unless the toggle has been triggered,
- *    as indicated by mode having been set to MANUAL. Sensor will not effect a change to ControlState
- *    unless mode is AUTOMATIC.
- */
-      void timerCallback() {
-        ControlState state = sensorState(); 
-        if(sensorStateChange(state))  lastSensorState(state);
-/**
- *      RelayState is set ONLY if it's different from the actual relay, and mode is AUTOMATIC.
+ *    Timer callback evaluates the Sensor and arms the Timer again, see schedule()
  */
-        if( !isRelayState(state) && isAUTOMATIC() ) RelayControl::setControlState(state);
-        _timer.reset();
-        _timer.start();
-      }
+      void timerCallback() {schedule();}
 
 };
 
@@ -36,35 +36,61 @@ INITIALIZE_DEVICE_TYPES(Sensor,LeelanauSoftware-com,Sensor,1.0.0);
 Sensor::Sensor() : UPnPDevice("sensor") {
   addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services for configuration
   setDisplayName("Sensor");                                   // Set the eisplay name
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
 }
 
 Sensor::Sensor(const char* target) : UPnPDevice(target) {
   addServices(getConfigurationSvc(),setConfigurationSvc());   // Add services configuration
   setDisplayName("Sensor");                                   // Set the eisplay name
-  setConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleSetConfiguration(svr);});
+  setConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(setConfigurationSvc(),[this](WebContext* svr){this->handleSetConfiguration(svr);}));
   setConfigurationSvc()->setFormHandler([this](WebContext* svr){this->configForm(svr);});
-  getConfigurationSvc()->setHttpHandler([this](WebContext* svr){this->handleGetConfiguration(svr);});
+  getConfigurationSvc()->setHttpHandler(HandlerMetrics::timed(getConfigurationSvc(),[this](WebContext* svr){if( !this->entityTag()->notModified(svr,EntityTag::variant(contentFormat(svr))) ) this->handleGetConfiguration(svr);}));
+}
+
+void Sensor::setup(WebContext* svr) {
+  UPnPDevice::setup(svr);
+  PathTable::shared()->paths(_paths,this,setConfigurationSvc());
+  FragmentCache::shared()->invalidate(this);
+}
+
+int Sensor::formatSnapshot(char buffer[], int size, int pos) {
+  EventService* events = eventSvc();
+  return ((events != NULL)?(events->formatVariables(buffer,size,pos)):(pos));
+}
+
+int Sensor::saveConfig(uint8_t buffer[], int size) {
+  const ConfigSchema* schema = configSchema();
+  return ((schema != NULL)?(schema->serialize(buffer,size,this)):(displayName_schema.serialize(buffer,size,(UPnPObject*)this)));
+}
+
+int Sensor::restoreConfig(const uint8_t* data, int len) {
+  const ConfigSchema* schema = configSchema();
+  return ((schema != NULL)?(schema->deserialize(data,len,this)):(displayName_schema.deserialize(data,len,(UPnPObject*)this)));
+}
+
+/**
+ *  Configuration generation only changes if a display name was applied
+ */
+void Sensor::handleSetConfiguration(WebContext* svr) {
+  if( displayName_schema.parse(svr,(UPnPObject*)this) > 0 ) entityTag()->touchConfig();
+  display(svr);
 }
 
 void Sensor::display(WebContext* svr) {
-  char buffer[DISPLAY_SIZE];
-  int size = sizeof(buffer);
-  int pos = formatHeader(buffer,size,getDisplayName());
-  pos = formatContent(buffer,size,pos);
+  HandlerScope scope(this);
+  if( _entityTag.notModified(svr,'d',stateGeneration()) ) return;
+  ChunkedWriter w(svr);
+  w.header(getDisplayName());
+  w.content(this);
  
 /** 
  *  Parent of a Sensor is a RootDevice and thus is non-null and provides a complete path
  *  Add a Config Button to the Sensor display
  */
-  char pathBuff[100];
-  setConfigurationSvc()->formPath(pathBuff,100);
-  pos = formatBuffer_P(buffer,size,pos,config_button,pathBuff,"Configure"); 
-   
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.printf_P(config_button,_paths.form,"Configure"); 
+  w.tail();
 }
 
 }
@@ -29,12 +29,26 @@
 
 #include <UPnPLib.h>
 #include "ConfigurationServices.h"
+#include "ChunkedWriter.h"
+#include "SensorHistory.h"
+#include "EventServices.h"
+#include "EntityTag.h"
+#include "FragmentCache.h"
+#include "PathTable.h"
+#include "ConfigSchema.h"
+#include "HandlerMetrics.h"
+#include "LoopProfiler.h"
 
 /** Leelanau Software Company namespace 
  *  
  */
 namespace lsc {
   
+/**
+ *   Minimum interval (in seconds) between event notifications to a subscriber of a Sensor
+ */
+#define SENSOR_EVENT_MODERATION 10
+
 
 /** A Sensor is a configurable UPnPDevice that provides its Sensor reading as simple HTML.
  *  Configuration is provided by SetConfiguration and GetConfiguration UPnPServices
@@ -48,7 +62,7 @@ class Sensor : public UPnPDevice {
 
       SetConfiguration*  setConfigurationSvc()                     {return &_setConfiguration;}                        // Return setConfigutation Service
       GetConfiguration*  getConfigurationSvc()                     {return &_getConfiguration;}                        // Return getConfigutation Service
-      virtual void       handleSetConfiguration(WebContext* svr)   {_setConfiguration.handleSetConfiguration(svr);}    // Default form (submit) handler for set configuration
+      virtual void       handleSetConfiguration(WebContext* svr);                                                      // Default form (submit) handler sets the display name
       virtual void       handleGetConfiguration(WebContext* svr)   {_getConfiguration.handleGetConfiguration(svr);}    // Default HTTP handler for get configuration
       virtual void       configForm(WebContext* svr)               {_setConfiguration.configForm(svr);}                // Default form display for set configuration
 
@@ -79,6 +93,55 @@ class Sensor : public UPnPDevice {
  */
 
     void   display(WebContext* svr);                                       // display() adds a "Configure" button
+    void   setup(WebContext* svr);                                         // Paths are (re)assigned, cached fragments are dropped
+
+/**
+ *  Generation counters for conditional requests: display() and getConfiguration answer 304 when the client already has
+ *  the current version. handleSetConfiguration() bumps the configuration generation (entityTag()->touchConfig()) only
+ *  when it applies a field, as counted by ConfigSchema::parse(). Sensors call entityTag()->touchState() when a published
+ *  reading changes. A Sensor whose display changes on its own (a clock) overrides stateGeneration().
+ */
+      EntityTag*              entityTag()                    {return &_entityTag;}
+      virtual uint32_t        stateGeneration()              {return _entityTag.state();}
+
+/**
+ *  Device, form action and Configure paths, interned at setup() (see PathTable)
+ */
+      const DevicePaths&      paths()                        {return _paths;}
+
+/**
+ *  Sensors that describe their configuration with a field table (see ConfigSchema) return it here, so configuration
+ *  can be rendered, parsed, and persisted generically
+ */
+      virtual const ConfigSchema* configSchema()             {return NULL;}
+
+/**
+ *  Configuration image kept by ConfigStore. saveConfig() returns the image length (0 if it does not fit) and
+ *  restoreConfig() the number of bytes it used (0 if the image is not valid). The default image is configSchema(),
+ *  or the display name alone; a Sensor with configuration outside its schema appends it.
+ */
+      virtual int             saveConfig(uint8_t buffer[], int size);
+      virtual int             restoreConfig(const uint8_t* data, int len);
+
+/**
+ *  Sensors that keep a history of their readings provide one SensorHistory per value (channel), and a GetHistory
+ *  member returned from historySvc() and added in their constructor. GetHistory returns a time range for every channel.
+ */
+      virtual int             numHistories()                 {return 0;}
+      virtual SensorHistory*  history(int i)                 {return NULL;}
+      virtual GetHistory*     historySvc()                   {return NULL;}
+
+/**
+ *  Sensors that publish their readings as events hold an EventService, returned from eventSvc() and added in their
+ *  constructor, set() each value on a new sample, and call eventSvc()->doDevice() from doDevice(). Notifications
+ *  should be moderated to SENSOR_EVENT_MODERATION. Sensors without events (SoftwareClock) carry no subscriber table.
+ */
+      virtual EventService*   eventSvc()                     {return NULL;}
+
+/**
+ *  Current readings as XML elements for the ExtendedDevice snapshot, by default the published event variables
+ */
+      virtual int             formatSnapshot(char buffer[], int size, int pos);
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
@@ -103,6 +166,8 @@ class Sensor : public UPnPDevice {
 
       GetConfiguration     _getConfiguration;
       SetConfiguration     _setConfiguration;
+      EntityTag            _entityTag;
+      DevicePaths          _paths;
 
 };
 
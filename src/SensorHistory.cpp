@@ -0,0 +1,190 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SensorHistory.h"
+#include "SensorDevice.h"
+#include "SoftwareClock.h"
+#include "ChunkedWriter.h"
+#include "QueryArgs.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char history_head[]          PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><history><uptime>%lu</uptime>";
+const char history_logtime[]       PROGMEM = "<logtime>%lu</logtime>";
+const char history_clock[]         PROGMEM = "<clock>%s</clock>";
+const char history_channel[]       PROGMEM = "<channel name=\"%s\" unit=\"%s\" tier=\"%s\">";
+const char history_raw[]           PROGMEM = "<s t=\"%lu\" v=\"%.2f\"/>";
+const char history_aggregate[]     PROGMEM = "<s t=\"%lu\" min=\"%.2f\" mean=\"%.2f\" max=\"%.2f\"/>";
+const char history_channel_tail[]  PROGMEM = "</channel>";
+const char history_tail[]          PROGMEM = "</history>";
+
+/**
+ *  Static RTT initialization
+ */
+INITIALIZE_SERVICE_TYPES(GetHistory,LeelanauSoftware-com,getHistory,1.0.0);
+
+SensorHistory::SensorHistory(const char* name, const char* unit) : _name(name), _unit(unit) {}
+
+void SensorHistory::record(float value) {record(value,uptime());}
+
+/**
+ *  A raw sample is kept at most every HISTORY_RAW_INTERVAL seconds. Every value is added to the current minute;
+ *  when a value arrives for a new minute, the current minute is closed into the minute ring and folded into the
+ *  current hour, which is closed the same way. Closed minutes are also appended to the HistoryLog, if any.
+ */
+void SensorHistory::record(float value, uint32_t time) {
+  const HistorySample* last = raw(_rawCount-1);
+  if( (last == NULL) || ((time - last->time) >= HISTORY_RAW_INTERVAL) ) {
+    _raw[_rawNext] = {time,value};
+    _rawNext = (_rawNext+1)%HISTORY_RAW_SIZE;
+    if( _rawCount < HISTORY_RAW_SIZE ) _rawCount++;
+  }
+
+  uint32_t minStart = time - time%60;
+  if( (_minAcc.count > 0) && (minStart != _minAcc.time) ) {
+    _min[_minNext] = aggregate(_minAcc);
+    if( _log != NULL ) _log->append(_log->origin()+_min[_minNext].time,_min[_minNext].mean);
+    _minNext = (_minNext+1)%HISTORY_MINUTE_SIZE;
+    if( _minCount < HISTORY_MINUTE_SIZE ) _minCount++;
+
+    uint32_t hourStart = _minAcc.time - _minAcc.time%3600;
+    if( (_hourAcc.count > 0) && (hourStart != _hourAcc.time) ) {
+      _hour[_hourNext] = aggregate(_hourAcc);
+      _hourNext = (_hourNext+1)%HISTORY_HOUR_SIZE;
+      if( _hourCount < HISTORY_HOUR_SIZE ) _hourCount++;
+      _hourAcc.count = 0;
+    }
+    accumulate(_hourAcc,hourStart,_minAcc.min,_minAcc.max,_minAcc.sum,_minAcc.count);
+    _minAcc.count = 0;
+  }
+  accumulate(_minAcc,minStart,value,value,value,1);
+}
+
+void SensorHistory::accumulate(Accumulator& a, uint32_t start, float min, float max, float sum, uint32_t count) {
+  if( a.count == 0 ) a = {start,min,max,sum,count};
+  else {
+    if( min < a.min ) a.min = min;
+    if( max > a.max ) a.max = max;
+    a.sum   += sum;
+    a.count += count;
+  }
+}
+
+HistoryAggregate SensorHistory::aggregate(const Accumulator& a) {
+  HistoryAggregate result = {a.time,a.min,((a.count>0)?(a.sum/a.count):(0.0f)),a.max};
+  return result;
+}
+
+int SensorHistory::size(HistoryTier tier) {
+  if( tier == MINUTE ) return _minCount;
+  if( tier == HOUR )   return _hourCount;
+  return _rawCount;
+}
+
+uint32_t SensorHistory::uptime() {
+  static uint32_t lastMillis = 0;
+  static uint32_t rollovers  = 0;
+  uint32_t current = millis();
+  if( current < lastMillis ) rollovers++;
+  lastMillis = current;
+  return (uint32_t)(((((uint64_t)rollovers) << 32) | current)/1000);
+}
+
+GetHistory::GetHistory() : UPnPService("getHistory") {setDisplayName("Get History");}
+
+void GetHistory::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
+  Sensor* s = (Sensor*)GET_PARENT_AS(Sensor::classType());
+  if( s == NULL ) {
+    char buffer[128];
+    snprintf_P(buffer,128,error_html,"Sensor");
+    svr->send(500,"text/html",buffer);
+    return;
+  }
+
+  HistoryTier tier    = RAW;
+  uint32_t    from    = 0;
+  uint32_t    to      = 0xFFFFFFFF;
+  char        channel[32];
+  channel[0] = '\0';
+  QueryArgs args(svr);
+  for( int i=0; i<args.count(); i++ ) {
+     ArgView a = args.arg(i);
+     long    t;
+     switch( a.hash() ) {
+        case argHash("TIER"):
+           if( a.is("MINUTE") ) tier = MINUTE;
+           else if( a.is("HOUR") ) tier = HOUR;
+           else if( a.is("LOG") ) tier = LOG;
+           break;
+        case argHash("FROM"):    if( a.toInt(t) && (t >= 0) ) from = t; break;
+        case argHash("TO"):      if( a.toInt(t) && (t >= 0) ) to = t; break;
+        case argHash("CHANNEL"): strncpy(channel,a.value(),31); channel[31] = '\0'; break;
+     }
+  }
+  const char* tierName = ((tier==MINUTE)?("MINUTE"):((tier==HOUR)?("HOUR"):((tier==LOG)?("LOG"):("RAW"))));
+
+  ChunkedWriter w(svr,"text/xml");
+  w.printf_P(history_head,(unsigned long)SensorHistory::uptime());
+
+/**
+ *  If there is a SoftwareClock, include the current date/time so uptime can be related to wall clock time
+ */
+  SoftwareClock* c = (SoftwareClock*)RootDevice::getDevice(s->rootDevice(),SoftwareClock::classType());
+  if( c != NULL ) {
+    char date[64];
+    c->now().printDateTime(date,64);
+    w.printf_P(history_clock,date);
+  }
+
+  for( int i=0; i<s->numHistories(); i++ ) {
+    SensorHistory* h = s->history(i);
+    if( (h == NULL) || ((channel[0] != '\0') && (strcasecmp(channel,h->name()) != 0)) ) continue;
+    w.printf_P(history_channel,h->name(),h->unit(),tierName);
+    if( tier == LOG ) {
+      if( h->log() != NULL ) {
+        w.printf_P(history_logtime,(unsigned long)(h->log()->origin()+SensorHistory::uptime()));
+        h->log()->read(from,to,[&w](uint32_t time, float value){w.printf_P(history_raw,(unsigned long)time,value);});
+      }
+      w.printf_P(history_channel_tail);
+      continue;
+    }
+    int n = h->size(tier);
+    for( int j=0; j<n; j++ ) {
+      if( tier == RAW ) {
+        const HistorySample* r = h->raw(j);
+        if( (r->time >= from) && (r->time <= to) ) w.printf_P(history_raw,(unsigned long)r->time,r->value);
+      }
+      else {
+        const HistoryAggregate* a = ((tier==MINUTE)?(h->minute(j)):(h->hour(j)));
+        if( (a->time >= from) && (a->time <= to) ) w.printf_P(history_aggregate,(unsigned long)a->time,a->min,a->mean,a->max);
+      }
+    }
+    w.printf_P(history_channel_tail);
+  }
+  w.printf_P(history_tail);
+}
+
+} // End of namespace lsc
@@ -0,0 +1,177 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <UPnPLib.h>
+#include "HistoryLog.h"
+
+/**
+ *   History RAM budget per channel is
+ *      8*HISTORY_RAW_SIZE + 16*(HISTORY_MINUTE_SIZE + HISTORY_HOUR_SIZE) bytes
+ *   (about 1.1K with the defaults below). A raw sample is kept at most every HISTORY_RAW_INTERVAL seconds,
+ *   but every recorded value contributes to the minute and hour aggregates.
+ */
+#ifndef HISTORY_RAW_SIZE
+#define HISTORY_RAW_SIZE       30
+#endif
+#ifndef HISTORY_MINUTE_SIZE
+#define HISTORY_MINUTE_SIZE    30
+#endif
+#ifndef HISTORY_HOUR_SIZE
+#define HISTORY_HOUR_SIZE      24
+#endif
+#define HISTORY_RAW_INTERVAL   10
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef enum HistoryTier {
+  RAW,
+  MINUTE,
+  HOUR,
+  LOG
+} HistoryTier;
+
+typedef struct HistorySample {
+  uint32_t   time;                      // Seconds since boot
+  float      value;
+} HistorySample;
+
+typedef struct HistoryAggregate {
+  uint32_t   time;                      // Start of the interval in seconds since boot
+  float      min;
+  float      mean;
+  float      max;
+} HistoryAggregate;
+
+/** SensorHistory is a bounded-memory, multi-resolution time series for a single Sensor value (channel). Recorded
+ *  values go into a ring of raw samples and are downsampled incrementally into rings of 1-minute and 1-hour
+ *  min/mean/max aggregates. Rings overwrite their oldest entry when full, so RAM use is fixed at compile time.
+ *  Time is seconds since boot, see SensorHistory::uptime().
+ *  An optional HistoryLog persists the mean of each closed minute to flash, at log time origin() + uptime.
+ */
+class SensorHistory {
+  public:
+    SensorHistory(const char* name, const char* unit = "");
+    virtual ~SensorHistory() {}
+
+    void                     record(float value);                                // Record a value at the current time
+    void                     record(float value, uint32_t time);                 // Record a value at time (seconds since boot)
+
+    const char*              name()                  {return _name;}
+    const char*              unit()                  {return _unit;}
+
+    void                     log(HistoryLog* l)      {_log = l;}
+    HistoryLog*              log()                   {return _log;}
+
+/**
+ *   Ring access, index 0 is the oldest entry
+ */
+    int                      size(HistoryTier tier);
+    const HistorySample*     raw(int i)              {return (((i>=0)&&(i<_rawCount))?(&_raw[(_rawNext+HISTORY_RAW_SIZE-_rawCount+i)%HISTORY_RAW_SIZE]):(NULL));}
+    const HistoryAggregate*  minute(int i)           {return (((i>=0)&&(i<_minCount))?(&_min[(_minNext+HISTORY_MINUTE_SIZE-_minCount+i)%HISTORY_MINUTE_SIZE]):(NULL));}
+    const HistoryAggregate*  hour(int i)             {return (((i>=0)&&(i<_hourCount))?(&_hour[(_hourNext+HISTORY_HOUR_SIZE-_hourCount+i)%HISTORY_HOUR_SIZE]):(NULL));}
+
+/**
+ *   Seconds since boot, corrected for millis() rollover
+ */
+    static uint32_t          uptime();
+
+  protected:
+
+/**
+ *   Aggregate under construction for the current minute and hour
+ */
+    typedef struct Accumulator {
+      uint32_t   time;
+      float      min;
+      float      max;
+      float      sum;
+      uint32_t   count;
+    } Accumulator;
+
+    void                     accumulate(Accumulator& a, uint32_t start, float min, float max, float sum, uint32_t count);
+    static HistoryAggregate  aggregate(const Accumulator& a);
+
+    const char*              _name;
+    const char*              _unit;
+    HistoryLog*              _log       = NULL;
+    HistorySample            _raw[HISTORY_RAW_SIZE];
+    HistoryAggregate         _min[HISTORY_MINUTE_SIZE];
+    HistoryAggregate         _hour[HISTORY_HOUR_SIZE];
+    int                      _rawNext   = 0;
+    int                      _rawCount  = 0;
+    int                      _minNext   = 0;
+    int                      _minCount  = 0;
+    int                      _hourNext  = 0;
+    int                      _hourCount = 0;
+    Accumulator              _minAcc    = {0,0,0,0,0};
+    Accumulator              _hourAcc   = {0,0,0,0,0};
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(SensorHistory);
+};
+
+/**
+ *   GetHistory is a UPnPService returning a time range of history for every channel of its parent Sensor in a
+ *   single XML response. Arguments (all optional):
+ *      TIER=RAW|MINUTE|HOUR|LOG     := Resolution, default RAW. LOG streams minute means from the channel's HistoryLog
+ *      FROM=secs, TO=secs           := Time range in seconds since boot (log time for LOG), default is everything
+ *      CHANNEL=name                 := Only return the named channel
+ *   The response is streamed, so its size is not limited by a buffer.
+ */
+class GetHistory : public UPnPService {
+  public:
+    GetHistory();
+    virtual ~GetHistory() {}
+
+    void handleRequest(WebContext* svr);
+
+/**
+ *   Macros to define the following Runtime and UPnP Type Info:
+ *     private: static const ClassType  _classType;
+ *     public:  static const ClassType* classType();
+ *     public:  virtual void*           as(const ClassType* t);
+ *     public:  virtual boolean         isClassType( const ClassType* t);
+ *     private: static const char*      _upnpType;
+ *     public:  static const char*      upnpType()
+ *     public:  virtual const char*     getType()
+ *     public:  virtual boolean         isType(const char* t)
+ */
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(GetHistory);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -38,6 +38,7 @@ const char  clock_body[]         PROGMEM = "<p align=\"center\" style=\"font-siz
             "</div><br><br>";
 
 const char  root_clock_body[]    PROGMEM = "<p align=\"center\" style=\"font-size:1.1em;\"> %s </p>";
+const char  snapshot_clock[]     PROGMEM = "<dateTime>%s</dateTime>";
 const char  success_template[]   PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><success> Timezone %d Refresh %d</success>";                                       
 const char  datetime_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><datetime>"
                                             "<date>"
@@ -50,30 +51,33 @@ const char  datetime_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF
                                                 "<min>%02d</min>"
                                                 "<sec>%02d</sec>"
                                             "</time></datetime>";
-const char  SoftwareClock_config_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-                                            "<config>"
-                                               "<displayName>%s</displayName>"
-                                               "<tz>%d</tz>"
-                                               "<refresh>%d</refresh>"
-                                            "</config>";
+const char  datetime_json[]      PROGMEM = "{\"date\":{\"month\":\"%s\",\"day\":%d,\"year\":%d},\"time\":{\"hour\":%d,\"min\":%d,\"sec\":%d}}";
+
+/**
+ *  Configuration: display name, timezone offset (minutes, +/-hh:mm on the form), and NTP refresh (minutes)
+ */
+const char  SoftwareClock_tz[]               PROGMEM = "tz";
+const char  SoftwareClock_tz_label[]         PROGMEM = "Timezone";
+const char  SoftwareClock_refresh[]          PROGMEM = "refresh";
+const char  SoftwareClock_refresh_label[]    PROGMEM = "NTP Refresh";
+constexpr ConfigField SoftwareClock_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(SoftwareClock,control_name_label),
+  CONFIG_OFFSET(SoftwareClock,SoftwareClock_tz,SoftwareClock_tz_label,-840,840,timezoneMinutes(),timezoneMinutes(v)),
+  CONFIG_INT(SoftwareClock,SoftwareClock_refresh,SoftwareClock_refresh_label,15,10080,getNTPSync(),setNTPSync(v))
+};
+constexpr ConfigSchema SoftwareClock_schema(SoftwareClock_fields,sizeof(SoftwareClock_fields)/sizeof(ConfigField));
+
+/**
+ *   The form is split around the current time so the parts before and after it can be cached
+ */
 const char  SoftwareClock_config_form[] PROGMEM = "<br><br><form action=\"%s\">"                                                                           // Service path
-            "<div align=\"center\">"
-              "<p align=\"center\" style=\"font-size:1.35em;\"> %s </p>"                                                                                   // Current time
+            "<div align=\"center\">";
+const char  SoftwareClock_config_time[] PROGMEM = "<p align=\"center\" style=\"font-size:1.35em;\"> %s </p>";                                               // Current time
+const char  SoftwareClock_config_buttons[] PROGMEM = 
               "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Sync NTP</button>&ensp;"                                // Sync NTP path
               "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Reset</button><br>"                                     // Reset path
             "</div><br><br><br><br>"
-            "<div align=\"center\">"
-              "<table>"
-              "<tr><td><b><label for=\"displayName\">Control Name</label></b></td>"
-                  "<td>&ensp;<input type=\"text\" placeholder=\"%s\" size=\"16\" name=\"displayName\"></td></tr>"                                          // Device display name    
-              "<tr><td><b><label for=\"tz\">Timezone</label></b></td>"
-                  "<td>&ensp;<input type=\"text\" name=\"tz\" value=\"%s\" pattern=\"^([+-]?[0-9]{1,2}:[0-9]{2})$\" ></td></tr>"                           // Timezone
-              "<tr><td><b><label for=\"ntpSync\">NTP Refresh</label></b></td>"
-                  "<td>&ensp;<input type=\"number\" name=\"ntpSync\" min=\"15\" maxlength=\"4\" value=\"%d\"></td></tr>"                                   // NTP refresh
-              "</table><br><br>"
-              "<button class=\"fmButton\" type=\"submit\">Submit</button>&ensp;"
-              "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button><br><br>"                                // Device path
-            "</div></form>";
+            "<div align=\"center\">";
 
 /**
  *  Static RTT/UPnP type initialization
@@ -83,20 +87,34 @@ INITIALIZE_DEVICE_TYPES(SoftwareClock,LeelanauSoftware-com,SoftwareClock,2.1.1);
 
 GetDateTime::GetDateTime() : UPnPService("getDateTime") {setDisplayName("Get Date/Time");};
 void GetDateTime::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
   SoftwareClock* c = (SoftwareClock*)GET_PARENT_AS(SoftwareClock::classType());
   char buffer[256];
-  int result = 200;
-  if( c != NULL ) {
-    Instant current = c->now();
-    Date date = current.toDate();
-    Time time = current.toTime();
-    snprintf_P(buffer,256,datetime_template,Instant::MONTHS[date.month-1],date.day,date.year,time.hour,time.min,time.sec);
-  }
-  else {
-    result = 500;
+  if( c == NULL ) {
     snprintf_P(buffer,128,error_html,"SoftwareClock");
+    svr->send(500, "text/html", buffer);  
+    return;
+  }
+
+  ContentFormat format = contentFormat(svr);
+  Instant current = c->now();
+  Date date = current.toDate();
+  Time time = current.toTime();
+  if( format == BINARY_FORMAT ) {
+    BinaryRecord r(DATETIME_RECORD);
+    r.put16(date.year);
+    r.put8(date.month);
+    r.put8(date.day);
+    r.put8(time.hour);
+    r.put8(time.min);
+    r.put8(time.sec);
+    r.put8(0);
+    r.put16((int16_t)lround(c->getTimezone()*60.0));
+    r.send(svr);
+    return;
   }
-  svr->send(result, "text/xml", buffer);  
+  snprintf_P(buffer,256,((format==JSON_FORMAT)?(datetime_json):(datetime_template)),Instant::MONTHS[date.month-1],date.day,date.year,time.hour,time.min,time.sec);
+  svr->send(200, contentType(format), buffer);  
 }
 
 SoftwareClock::SoftwareClock() : Sensor("clock") {
@@ -109,6 +127,16 @@ SoftwareClock::SoftwareClock(const char* target) : Sensor(target) {
   setDisplayName("Software Clock");
 }
 
+/**
+ *  The display shows the time to the second (and running time), so any tag from an earlier second is stale
+ */
+uint32_t SoftwareClock::stateGeneration() {
+  Instant t = now();
+  Date    d = t.toDate();
+  Time    c = t.toTime();
+  return ((uint32_t)((d.year*12 + d.month)*31 + d.day))*86400UL + c.hour*3600UL + c.min*60UL + c.sec + _syncCount;
+}
+
 int SoftwareClock::formatContent(char buffer[], int size, int pos) {
   char date[64];
   char nst[64];
@@ -141,82 +169,76 @@ int SoftwareClock::formatRootContent(char buffer[], int size, int pos) {
   return pos;
 }
 
+int SoftwareClock::formatSnapshot(char buffer[], int size, int pos) {
+  char date[64];
+  now().printDateTime(date,64);
+  return formatBuffer_P(buffer,size,pos,snapshot_clock,date);
+}
+
 void SoftwareClock::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
-     if( argName.equalsIgnoreCase("TZ") ) {
-        double tz = (double)getHours(arg) +(double)getMinutes(arg)/60.;
-        setTimezone(tz);
-     }
-     else if( argName.equalsIgnoreCase("REFRESH") ) setNTPSync((int) arg.toInt());
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
-  }
+  if( SoftwareClock_schema.parse(svr,this) > 0 ) entityTag()->touchConfig();
   display(svr);
 }
 
-void SoftwareClock::handleGetConfiguration(WebContext* svr) {
-  char buffer[1000];
-  int    size = sizeof(buffer);
-  double tz   = getTimezone();
-  int    r    = getNTPSync();
-  snprintf_P(buffer,size,SoftwareClock_config_template,getDisplayName(),tz,r);
-  svr->send(200, "text/xml", buffer);    
-}
+void SoftwareClock::handleGetConfiguration(WebContext* svr) {SoftwareClock_schema.send(svr,this);}
+
+const ConfigSchema* SoftwareClock::configSchema() {return &SoftwareClock_schema;}
 
 void SoftwareClock::setup(WebContext* svr) {
   Sensor::setup(svr);
-  char pathBuffer[100];
-  char resetPath[100];
-  handlerPath(pathBuffer,100,"refreshNTP");
-  handlerPath(resetPath,100,"resetClock");
-  svr->on(pathBuffer,[this](WebContext* svr){this->refreshNTP(svr);});
-  svr->on(resetPath,[this](WebContext* svr){this->resetClock(svr);});
+  _refreshPath = PathTable::shared()->handlerPath(this,"refreshNTP");
+  _resetPath   = PathTable::shared()->handlerPath(this,"resetClock");
+  svr->on(_refreshPath,HandlerMetrics::timed(_refreshPath,[this](WebContext* svr){this->refreshNTP(svr);}));
+  svr->on(_resetPath,HandlerMetrics::timed(_resetPath,[this](WebContext* svr){this->resetClock(svr);}));
   updateSysTime();
 }
 
+/**
+ *  SystemClock synchronizes with NTP on its own schedule, so a change in lastSync() is counted as a sync
+ */
+void SoftwareClock::doDevice() {
+  {
+    LoopScope scope(this,"sysClock");
+    _sysClock.doDevice();
+  }
+  if( (millis() - _syncCheck) >= 1000 ) {
+    _syncCheck = millis();
+    Time t = lastSync().toTime();
+    long secs = t.hour*3600L + t.min*60L + t.sec;
+    if( secs != _lastSyncSecs ) {
+      _lastSyncSecs = secs;
+      _syncCount++;
+    }
+  }
+}
+
 void SoftwareClock::configForm(WebContext* svr) {
 /**
  *    Config Form HTML Start with Title
  */
-  char buffer[1500];
-  int size = sizeof(buffer);
-  int pos = formatHeader(buffer,size,"Set Configuration");
+  ChunkedWriter w(svr);
+  w.header("Set Configuration");
 
 /**
- *  Config Form Content
+ *  Config Form Content, static parts rendered once per configuration
  */
+  FragmentCache* cache = FragmentCache::shared();
+  cache->write(w,this,FORM_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+    return formatBuffer_P(buffer,size,pos,SoftwareClock_config_form,paths().action);
+  });
   char current[64];
   now().printDateTime(current,64);
-  char pathBuff[100];
-  getPath(pathBuff,100);                       // Device path
-  char ns_d[64];
-  char ns_t[64];
-  Instant t = nextSync(); 
-  t.printDate(ns_d,64);
-  t.printTime(ns_t,64);
-  int r =  getNTPSync();                        // NTP refresh interval
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100); // Form submit path (service path)
-  char tzBuff[8];
-  int h = (int)getTimezone();
-  int m = (getTimezone() - h)*60;
-  m = ((m<0)?(-m):(m));
-  if(h<0) snprintf(tzBuff,8,"-%02d:%02d",-h,m); // in order to force leading zeros in hours place
-  else snprintf(tzBuff,8,"+%02d:%02d",h,m);
-
-  char refreshPath[100];
-  char resetPath[100];
-  handlerPath(refreshPath,100,"refreshNTP");   // Refresh handler path
-  handlerPath(resetPath,100,"resetClock");     // Reset handler path
-  pos = formatBuffer_P(buffer,size,pos,SoftwareClock_config_form,svcPath,current,refreshPath,resetPath,getDisplayName(),tzBuff,r,pathBuff);
+  w.printf_P(SoftwareClock_config_time,current);
+  cache->write(w,this,FORM_TAIL_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+    pos = formatBuffer_P(buffer,size,pos,SoftwareClock_config_buttons,_refreshPath,_resetPath);
+    pos = SoftwareClock_schema.formatFields(buffer,size,pos,this);
+    return ConfigSchema::formatFormTail(buffer,size,pos,paths().device);
+  });
 
 /**
  *  Config Form HTML Tail
  */
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer);
+  w.tail();
 }
 
 /** 
@@ -225,24 +247,10 @@ void SoftwareClock::configForm(WebContext* svr) {
  *  Returns 0 if time format is incorrect or hours is out of range.
  */
 int SoftwareClock::getHours(const String& s) {
-   int result = 0;
-   int index = s.indexOf(':');
-   String hourStr = s.substring(0,index);
-   if(hourStr.startsWith("-")) {
-     if( hourStr.charAt(1)  == '0' ) result = -(hourStr.substring(2).toInt());
-     else result = -(hourStr.substring(1).toInt());
-   }
-   else if(hourStr.startsWith("+")) {
-     if( hourStr.charAt(1)  == '0' ) result = hourStr.substring(2).toInt();
-     else result = hourStr.substring(1).toInt();
-   }
-   else {
-     if( hourStr.charAt(0)  == '0' ) result = hourStr.substring(1).toInt();
-     else result = hourStr.substring(0).toInt();
-   }
-
-   if( (result > 14 ) || (result < -14) ) result = 0;
-   return result;
+   int h = 0;
+   int m = 0;
+   if( !QueryArgs::parseOffset(s.c_str(),h,m) || (h > 14) || (h < -14) ) h = 0;
+   return h;
 }
 
 /** 
@@ -251,16 +259,22 @@ int SoftwareClock::getHours(const String& s) {
  *  Returns 0 if time format is incorrect or minutes is out of range.
  */
  int SoftwareClock::getMinutes(const String& s) {
-   int result = 0;
-   int index = s.indexOf(':');
-   String minStr = s.substring(index+1);
-   result = minStr.toInt();
-   if( (result >= 0) && (result < 8))  result = 0;
-   else if( (result >= 8) && (result < 23) ) result = 15;
-   else if( (result >= 23) && (result < 38) ) result = 30;
+   int h = 0;
+   int m = 0;
+   if( !QueryArgs::parseOffset(s.c_str(),h,m) ) m = 0;
+   return quarterHour(m); 
+}
+
+/**
+ *  Round (+/-)minutes to the nearest quarter hour, keeping the sign
+ */
+int SoftwareClock::quarterHour(int minutes) {
+   int result = ((minutes<0)?(-minutes):(minutes));
+   if( result < 8 )  result = 0;
+   else if( result < 23 ) result = 15;
+   else if( result < 38 ) result = 30;
    else result = 45;
-   if(s.charAt(0) == '-') result = -result;
-   return result; 
+   return ((minutes<0)?(-result):(result)); 
 }
 
 } // End of namespace lsc
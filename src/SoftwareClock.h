@@ -63,25 +63,28 @@ class SoftwareClock : public Sensor {
     SoftwareClock( const char* target );
     virtual ~SoftwareClock() {}
 
-    virtual void             setTimezone(double hours)                {_sysClock.tzOffset(hours);}
-    virtual void             initialize(const Instant& ref)           {_sysClock.initialize(ref);}
+    virtual void             setTimezone(double hours)                {_sysClock.tzOffset(hours); _syncCount++; entityTag()->touchConfig();}
+    virtual void             initialize(const Instant& ref)           {_sysClock.initialize(ref); _syncCount++;}
     virtual const Instant&   initializationDate()                     {return _sysClock.initializationDate();}
     virtual double           getTimezone()                            {return _sysClock.tzOffset();}
-    virtual void             setNTPSync(unsigned int mins)            {_sysClock.ntpSync(mins);}
+    virtual void             setNTPSync(unsigned int mins)            {_sysClock.ntpSync(mins); entityTag()->touchConfig();}
     virtual unsigned int     getNTPSync()                             {return _sysClock.ntpSync();}
+    long                     timezoneMinutes()                        {return lround(getTimezone()*60.);}
+    void                     timezoneMinutes(long m)                  {setTimezone((double)(m/60) + (double)quarterHour(m%60)/60.);}   // Rounded to a quarter hour
     virtual Instant          lastSync()                               {return _sysClock.lastSync();}
     virtual Instant          nextSync()                               {return _sysClock.nextSync();}
     virtual Instant          now()                                    {return _sysClock.now();}
     virtual Instant          sysTime()                                {return _sysClock.sysTime();}
-    virtual Instant          updateSysTime()                          {return _sysClock.updateSysTime();}
-    virtual void             reset()                                  {_sysClock.reset();}
+    virtual Instant          updateSysTime()                          {Instant t = _sysClock.updateSysTime(); _syncCount++; return t;}
+    virtual void             reset()                                  {_sysClock.reset(); _syncCount++;}
+    unsigned long            syncCount()                              {return _syncCount;}    // Incremented whenever local time may have jumped
     virtual const Timestamp& startTime()  const                       {return _sysClock.startTime();}
 
 /**
  *   Virtual Functions required for UPnPDevice
  */
     void                     setup(WebContext* svr);
-    void                     doDevice()                               {_sysClock.doDevice();}
+    void                     doDevice();
 
 /**  Form handlers for NTP Refresh and clock reset
  *   
@@ -93,7 +96,9 @@ void                       resetClock(WebContext* svr)                {reset();d
  *   Virtual Functions required by Sensor
  */
      int                   formatContent(char buffer[], int bufferSize, int pos);
+     uint32_t              stateGeneration();                                                 // Changes every second of local time
      int                   formatRootContent(char buffer[], int bufferSize, int pos);
+     int                   formatSnapshot(char buffer[], int bufferSize, int pos);
 
 /**
  *    Methods to customize configuration (defined and set on Sensor)
@@ -101,11 +106,13 @@ void                       resetClock(WebContext* svr)                {reset();d
       void                 configForm(WebContext* svr);
       void                 handleSetConfiguration(WebContext* svr);
       void                 handleGetConfiguration(WebContext* svr);
+      const ConfigSchema*  configSchema();
 /**
  *    Return hours (or minutes) parf of the String (+/-)HH:MM returned from the config form
  */
       static int           getHours(const String& s);
       static int           getMinutes(const String& s);
+      static int           quarterHour(int minutes);
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
@@ -127,6 +134,11 @@ void                       resetClock(WebContext* svr)                {reset();d
       GetDateTime     _getDateTime;
 
       SystemClock     _sysClock;  
+      unsigned long   _syncCount    = 0;
+      long            _lastSyncSecs = -1;            // Time of day of lastSync(), checked once a second to detect periodic NTP sync
+      unsigned long   _syncCheck    = 0;
+      const char*     _refreshPath  = "";            // Interned at setup()
+      const char*     _resetPath    = "";
 
 /**
  *   Copy construction and assignment are not allowed
@@ -29,20 +29,21 @@ const char TempHum_root_body[]           PROGMEM = "<p align=\"center\" style=\"
 const char TempHum_template[]            PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><TempHum>"
                                                       "<temp>%f %c</temp>"
                                                       "<hum>%f</hum>"
+                                                      "<age>%lu</age>"
                                                    "</TempHum>";
-const char Thermometer_config_template[]  PROGMEM = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-                                            "<config>"
-                                               "<displayName>%s</displayName>"
-                                               "<unit>%c</unit>"
-                                            "</config>";
-const char Thermometer_config_form[]      PROGMEM = "<form action=\"%s\"><div align=\"center\">"
-            "<label for=\"displayName\">Sensor Name &nbsp &nbsp</label>"
-            "<input type=\"text\" placeholder=\"%s\" name=\"displayName\"><br><br>"
-            "<label for=\"unit\">Thermometer Unit &nbsp </label>"
-            "<input type=\"text\" name=\"unit\" pattern=\"[FfCc]{1}\" style=\"width:2.1em;font-size:1em\" maxlength=\"1\" placeholder=\"%c\"><br><br>"        
-            "<button class=\"fmButton\" type=\"submit\">Submit</button>&nbsp&nbsp"
-            "<button class=\"fmButton\" type=\"button\" onclick=\"window.location.href=\'%s\';\">Cancel</button>"  // Cancel path
-            "</div></form>";
+const char TempHum_json[]                PROGMEM = "{\"temp\":%.2f,\"unit\":\"%c\",\"hum\":%.2f,\"age\":%lu}";
+
+/**
+ *  Configuration: display name and unit (F or C)
+ */
+const char Thermometer_unit[]             PROGMEM = "unit";
+const char Thermometer_unit_label[]       PROGMEM = "Thermometer Unit";
+const char Thermometer_unit_choices[]     PROGMEM = "FfCc";
+constexpr ConfigField Thermometer_fields[] PROGMEM = {
+  CONFIG_DISPLAY_NAME(Thermometer,sensor_name_label),
+  CONFIG_CHAR(Thermometer,Thermometer_unit,Thermometer_unit_label,Thermometer_unit_choices,unit(),unit((char)v))
+};
+constexpr ConfigSchema Thermometer_schema(Thermometer_fields,sizeof(Thermometer_fields)/sizeof(ConfigField));
 
 /**
  *  Static RTT initialization
@@ -51,41 +52,80 @@ INITIALIZE_SERVICE_TYPES(GetTempHum,LeelanauSoftware-com,getTempHum,1.0.0);
 INITIALIZE_DEVICE_TYPES(Thermometer,LeelanauSoftware-com,Thermometer,1.0.0);
 
 GetTempHum::GetTempHum() : UPnPService("getTempHum") {setDisplayName("Get Temperature/Humidity");};
+/**
+ *  Response format is negotiated, see contentFormat(). The binary record is always Celcius.
+ */
 void GetTempHum::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
   Thermometer* t = (Thermometer*)GET_PARENT_AS(Thermometer::classType());
   char buffer[256];
-  int result = 200;
-  if( t != NULL ) {
-    float temp = t->temp();
-    float hum  = t->hum();
-    snprintf_P(buffer,256,TempHum_template,temp,t->unit(),hum);
-  }
-  else {
-    result = 500;
+  if( t == NULL ) {
     snprintf_P(buffer,128,error_html,"Thermometer");
+    svr->send(500,"text/html",buffer); 
+    return;
+  }
+
+  ContentFormat format = contentFormat(svr);
+  if( format == BINARY_FORMAT ) {
+    BinaryRecord r(TEMPHUM_RECORD);
+    r.put16((int16_t)lroundf(t->tempC()*100.0f));
+    r.put16((uint16_t)lroundf(t->hum()*100.0f));
+    r.put32(t->sampleAge());
+    r.send(svr);
+    return;
   }
-  svr->send(200,"text/xml",buffer); 
+  float temp = t->temp();
+  float hum  = t->hum();
+  snprintf_P(buffer,256,((format==JSON_FORMAT)?(TempHum_json):(TempHum_template)),temp,t->unit(),hum,t->sampleAge());
+  svr->send(200,contentType(format),buffer); 
 }
 
-Thermometer::Thermometer() : Sensor("thermometer") {
-  addServices(&_getTempHum);
+Thermometer::Thermometer() : Sensor("thermometer"), _tempHistory("temperature","C"), _humHistory("humidity","%") {
+  addServices(&_getTempHum,historySvc(),eventSvc());
+  _events.moderation(SENSOR_EVENT_MODERATION*1000UL);
   setDisplayName("Thermometer");
+  sampleRefresh(DHT_REFRESH);
+  _timer.setHandler([this]{this->timerCallback();});
 }
 
-Thermometer::Thermometer(const char* target) : Sensor(target) {
-  addServices(&_getTempHum);
+Thermometer::Thermometer(const char* target) : Sensor(target), _tempHistory("temperature","C"), _humHistory("humidity","%") {
+  addServices(&_getTempHum,historySvc(),eventSvc());
+  _events.moderation(SENSOR_EVENT_MODERATION*1000UL);
   setDisplayName("Thermometer");
+  sampleRefresh(DHT_REFRESH);
+  _timer.setHandler([this]{this->timerCallback();});
 }
 
 float Thermometer::temp() {
-  float result = _dht.getTemperature();
+  float result = _temp;
   if( isFahrenheit() ) result = _dht.toFahrenheit(result);
   return result; 
 }
 
 float Thermometer::hum() {
-  float result = _dht.getHumidity();
-  return result; 
+  return _hum; 
+}
+
+/**
+ *  Read the DHT22 into the cache. A failed read returns NaN, in which case the previous reading is kept. The state
+ *  generation (display ETag) only changes when a published value changes at display resolution.
+ */
+void Thermometer::sample() {
+  float t = _dht.getTemperature();
+  float h = _dht.getHumidity();
+  if( !isnan(t) && !isnan(h) ) {
+    _temp = t;
+    _hum  = h;
+    _sampleTime = millis();
+    _tempHistory.record(t);
+    _humHistory.record(h);
+    char value[16];
+    snprintf(value,16,"%.1f",t);
+    boolean changed = eventSvc()->set("temperature",value);
+    snprintf(value,16,"%.0f",h);
+    if( eventSvc()->set("humidity",value) ) changed = true;
+    if( changed ) entityTag()->touchState();
+  }
 }
 
 int Thermometer::pin() {
@@ -113,55 +153,40 @@ int Thermometer::formatRootContent(char buffer[], int size, int pos) {
 }
 
 void Thermometer::configForm(WebContext* svr) {
-  char buffer[1000];
-  int size = sizeof(buffer);
+  ChunkedWriter w(svr);
   
 /**
  *    Config Form HTML Start with Title
  */
-  int pos = formatHeader(buffer,size,"Thermometer Configuration");
+  w.header("Thermometer Configuration");
 
 /**
- *  Config Form Content
+ *  Config Form Content, rendered once per configuration
  */
-  char pathBuff[100];
-  getPath(pathBuff,100);
-  char svcPath[100];
-  setConfigurationSvc()->getPath(svcPath,100);
-  pos = formatBuffer_P(buffer,size,pos,Thermometer_config_form,svcPath,getDisplayName(),unit(),pathBuff);
+  FragmentCache::shared()->write(w,this,FORM_FRAGMENT,entityTag()->config(),[this](char buffer[], int size, int pos) {
+    return Thermometer_schema.formatForm(buffer,size,pos,this,paths().action,paths().device);
+  });
 
 /**
  *  Config Form HTML Tail
  */
-  formatTail(buffer,size,pos);
-  svr->send(200,"text/html",buffer); 
+  w.tail();
 }
 
 void Thermometer::handleSetConfiguration(WebContext* svr) {
-  int numArgs = svr->argCount();
-  for( int i=0; i<numArgs; i++) {
-     const String& argName = svr->argName(i);
-     const String& arg = svr->arg(i);
-     if( argName.equalsIgnoreCase("UNIT") ) {
-        if(isFahrenheit(arg.c_str()[0])) setFahrenheit();
-        else if(isCelcius(arg.c_str()[0])) setCelcius();
-     }
-     else if( argName.equalsIgnoreCase("DISPLAYNAME") ) {if( arg.length() > 0 ) setDisplayName(arg.c_str());}
-  }
+  if( Thermometer_schema.parse(svr,this) > 0 ) entityTag()->touchConfig();
   display(svr);  
 }
 
-void Thermometer::handleGetConfiguration(WebContext* svr) {
-  char buffer[1000];
-  size_t bufferSize = sizeof(buffer);
-  int size = bufferSize;
-  snprintf_P(buffer,size,Thermometer_config_template,getDisplayName(),unit());
-  svr->send(200, "text/xml", buffer);     
-}
+void Thermometer::handleGetConfiguration(WebContext* svr) {Thermometer_schema.send(svr,this);}
+
+const ConfigSchema* Thermometer::configSchema() {return &Thermometer_schema;}
 
 void Thermometer::setup(WebContext* svr) {
   Sensor::setup(svr);
   _dht.setup(pin(), DHTesp::DHT22);
+  sample();
+  _timer.start();
 }
 
 } // End of namespace lsc
@@ -24,6 +24,12 @@
 #define THERMOMETER_H
 #include "SensorDevice.h"
 #include <DHTesp.h>
+#include <Timer.h>
+
+/**
+ *   How often to sample the DHT22 (in seconds). The DHT22 cannot be sampled faster than every 2 seconds.
+ */
+#define DHT_REFRESH 2
 
 /** Leelanau Software Company namespace 
 *  
@@ -58,17 +64,13 @@ class GetTempHum : public UPnPService {
 
 /**
  *   DHT22 Thermometer Device. 
- *   Temperature and Humidity readings query the DHT22 directly so should not exceed 1 second intervals. Readings in a tight loop should be cached
- *   and refreshed with a Timer. For example, if Timer _t is a member of a class caching temperature and humidity, define a member function:
- *      void timerCallback() {
- *           updateCache();
- *           _t.reset();
- *           _t.start();
- *      }
- *   and set the Timer callback and refresh interval in the Class constructor:
- *      _t.set(2000)
- *      _t.setHandler([this]{this->timerCallback();});
- *
+ *   The DHT22 is sampled on a Timer from doDevice(), every sampleRefresh() seconds (DHT_REFRESH by default), and the 
+ *   reading is cached along with the time it was taken. temp(), hum(), page display, the GetTempHum service, and 
+ *   HumidityFan all read the cache, so an HTTP handler never waits on the sensor. sampleAge() is the age of the cached
+ *   reading in milliseconds and is reported as <age> by GetTempHum.
+ *   If a sample fails, the previous reading is kept and its age continues to grow.
+ *   Each sample is recorded into temperature (Celcius) and humidity histories, available from the GetHistory service,
+ *   and published to event subscribers as temperature (Celcius, 0.1 resolution) and humidity (1% resolution).
  */
 class Thermometer : public Sensor {
   public:
@@ -77,14 +79,24 @@ class Thermometer : public Sensor {
   virtual ~Thermometer() {}
 
 
-  float           temp();
-  float           hum();
+  float           temp();                                                          // Cached temperature in unit()
+  float           tempC()              {return _temp;}                             // Cached temperature in Celcius
+  float           hum();                                                           // Cached relative humidity
+  unsigned long   sampleAge()          {return millis() - _sampleTime;}            // Age of the cached reading in milliseconds
+  int             sampleRefresh()      {return _timer.setPointMillis()/1000;}
+  void            sampleRefresh(int secs)  {if( secs >= DHT_REFRESH ) _timer.set(secs*1000);}
   int             pin();
   void            pin(int p);
 
+  int             numHistories()       {return 2;}
+  SensorHistory*  history(int i)       {return ((i==0)?(&_tempHistory):((i==1)?(&_humHistory):(NULL)));}
+  GetHistory*     historySvc()         {return &_getHistory;}
+  EventService*   eventSvc()           {return &_events;}
+
   char            unit()               {return _unit;}
   void            setFahrenheit()      {_unit = 'F';}
   void            setCelcius()         {_unit = 'C';}
+  void            unit(char u)         {if( isFahrenheit(u) ) setFahrenheit(); else if( isCelcius(u) ) setCelcius();}
   static boolean  isFahrenheit(char u) {return (((u=='F') || (u=='f'))?(true):(false));}
   static boolean  isCelcius(char u)    {return (((u=='C') || (u=='c'))?(true):(false));}
   boolean         isFahrenheit()       {return isFahrenheit(_unit);}
@@ -94,6 +106,7 @@ class Thermometer : public Sensor {
  *   Virtual Functions required for UPnPDevice
  */
   void            setup(WebContext* svr);
+  void            doDevice()           {_timer.doDevice(); _events.doDevice();}
 
 /**
  *   Required by Sensor
@@ -107,6 +120,7 @@ class Thermometer : public Sensor {
    void           configForm(WebContext* svr);
    void           handleSetConfiguration(WebContext* svr);
    void           handleGetConfiguration(WebContext* svr);  
+   const ConfigSchema* configSchema();
 
 /**
  *   Macros to define the following Runtime Type Info:
@@ -121,8 +135,23 @@ class Thermometer : public Sensor {
   private:
   GetTempHum      _getTempHum;
   DHTesp          _dht;
+  Timer           _timer;
   int             _pin = WEMOS_D2;        // Set pin to GPIO 4, or WeMOS D2
   char            _unit = 'F';
+  float           _temp = 0.0;            // Last sampled temperature in Celcius
+  float           _hum  = 0.0;            // Last sampled relative humidity
+  unsigned long   _sampleTime = 0;        // millis() of the last successful sample
+  SensorHistory   _tempHistory;
+  SensorHistory   _humHistory;
+  GetHistory      _getHistory;
+  EventService    _events;
+
+  void            sample();
+  void            timerCallback() {
+    sample();
+    _timer.reset();
+    _timer.start();
+  }
   
 /**
  *   Copy construction and assignment are not allowed
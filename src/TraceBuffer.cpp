@@ -0,0 +1,156 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#include "TraceBuffer.h"
+#include "ChunkedWriter.h"
+#include "HandlerMetrics.h"
+
+/**
+ *  How an argument is formatted: as a number, or as the name of a ControlState or ControlMode
+ */
+#define ARG_NONE    0
+#define ARG_INT     1
+#define ARG_STATE   2
+#define ARG_MODE    3
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct TraceFormat {
+  PGM_P         format;                                   // Source display name followed by one %s per argument
+  uint8_t       args[TRACE_ARGS];
+} TraceFormat;
+
+const char trace_relay_request[]  PROGMEM = "%s: setState request %s";
+const char trace_relay_content[]  PROGMEM = "%s: content, relay %s";
+const char trace_relay_set[]      PROGMEM = "%s: relay %s, pin set to %s";
+const char trace_relay_setup[]    PROGMEM = "%s: setup, pin %s set to %s";
+const char trace_scr_content[]    PROGMEM = "%s: content, relay %s, mode %s";
+const char trace_scr_state[]      PROGMEM = "%s: relay is %s, setting %s";
+const char trace_scr_manual[]     PROGMEM = "%s: state toggle sets mode to MANUAL";
+const char trace_scr_mode[]       PROGMEM = "%s: mode set to %s";
+const char trace_scr_reset[]      PROGMEM = "%s: AUTOMATIC resets relay to %s";
+const char trace_scr_request[]    PROGMEM = "%s: setMode request %s";
+const char trace_scr_schedule[]   PROGMEM = "%s: next wakeup in %s ms";
+const char trace_timer_cycle[]    PROGMEM = "%s: next ON at minute %s, next OFF at minute %s of the week";
+const char trace_timer_form[]     PROGMEM = "%s: configForm sent %s bytes";
+const char trace_line[]           PROGMEM = "%lu ";
+const char trace_dropped[]        PROGMEM = "%lu records dropped\n";
+
+const TraceFormat trace_formats[TRACE_EVENTS] PROGMEM = {
+  {trace_relay_request, {ARG_STATE, ARG_NONE,  ARG_NONE}},
+  {trace_relay_content, {ARG_STATE, ARG_NONE,  ARG_NONE}},
+  {trace_relay_set,     {ARG_STATE, ARG_INT,   ARG_NONE}},
+  {trace_relay_setup,   {ARG_INT,   ARG_STATE, ARG_NONE}},
+  {trace_scr_content,   {ARG_STATE, ARG_MODE,  ARG_NONE}},
+  {trace_scr_state,     {ARG_STATE, ARG_STATE, ARG_NONE}},
+  {trace_scr_manual,    {ARG_NONE,  ARG_NONE,  ARG_NONE}},
+  {trace_scr_mode,      {ARG_MODE,  ARG_NONE,  ARG_NONE}},
+  {trace_scr_reset,     {ARG_STATE, ARG_NONE,  ARG_NONE}},
+  {trace_scr_request,   {ARG_MODE,  ARG_NONE,  ARG_NONE}},
+  {trace_scr_schedule,  {ARG_INT,   ARG_NONE,  ARG_NONE}},
+  {trace_timer_cycle,   {ARG_INT,   ARG_INT,   ARG_NONE}},
+  {trace_timer_form,    {ARG_INT,   ARG_NONE,  ARG_NONE}}
+};
+
+/**
+ *  Static RTT initialization
+ */
+INITIALIZE_SERVICE_TYPES(GetTrace,LeelanauSoftware-com,getTrace,1.0.0);
+
+TraceBuffer* TraceBuffer::shared() {
+  static TraceBuffer trace;
+  return &trace;
+}
+
+void TraceBuffer::record(TraceEvent event, UPnPObject* source, int32_t a0, int32_t a1, int32_t a2) {
+  TraceRecord& r = _records[_head];
+  r.time    = millis();
+  r.event   = event;
+  r.source  = source;
+  r.args[0] = a0;
+  r.args[1] = a1;
+  r.args[2] = a2;
+  _head = (_head + 1)%TRACE_SIZE;
+  if( _count < TRACE_SIZE ) _count++;
+  else _dropped++;
+}
+
+/**
+ *  Format a record as one line. ControlState (ON=0, OFF=1) and ControlMode (AUTOMATIC=0, MANUAL=1) arguments are
+ *  printed by name; a value that is neither (an unrecognized request) is printed as "?".
+ */
+int TraceBuffer::format(const TraceRecord& r, char buffer[], int size, int pos) {
+  if( r.event >= TRACE_EVENTS ) return pos;
+  TraceFormat f;
+  memcpy_P(&f,&trace_formats[r.event],sizeof(TraceFormat));
+  char args[TRACE_ARGS][12];
+  for( int i=0; i<TRACE_ARGS; i++ ) {
+    int32_t v = r.args[i];
+    switch( f.args[i] ) {
+      case ARG_INT:   snprintf(args[i],12,"%ld",(long)v); break;
+      case ARG_STATE: snprintf(args[i],12,"%s",((v==0)?("ON"):((v==1)?("OFF"):("?")))); break;
+      case ARG_MODE:  snprintf(args[i],12,"%s",((v==0)?("AUTOMATIC"):((v==1)?("MANUAL"):("?")))); break;
+      default:        args[i][0] = '\0';
+    }
+  }
+  pos = formatBuffer_P(buffer,size,pos,trace_line,(unsigned long)r.time);
+  pos = formatBuffer_P(buffer,size,pos,f.format,((r.source != NULL)?(r.source->getDisplayName()):("")),args[0],args[1],args[2]);
+  return formatBuffer_P(buffer,size,pos,PSTR("\n"));
+}
+
+void TraceBuffer::drain(Print& p) {
+  char line[TRACE_LINE_SIZE];
+  if( _dropped > 0 ) {
+    formatBuffer_P(line,TRACE_LINE_SIZE,0,trace_dropped,(unsigned long)_dropped);
+    p.print(line);
+    _dropped = 0;
+  }
+  for( ; _count>0; _count-- ) {
+    format(oldest(),line,TRACE_LINE_SIZE,0);
+    p.print(line);
+  }
+}
+
+void TraceBuffer::send(WebContext* svr) {
+  ChunkedWriter w(svr,"text/plain");
+  if( _dropped > 0 ) {
+    w.printf_P(trace_dropped,(unsigned long)_dropped);
+    _dropped = 0;
+  }
+  for( ; _count>0; _count-- ) {
+    const TraceRecord& r = oldest();
+    w.write([this,&r](char buffer[], int size, int pos) {return this->format(r,buffer,size,pos);});
+  }
+}
+
+GetTrace::GetTrace() : UPnPService("getTrace") {setDisplayName("Get Trace");}
+
+void GetTrace::handleRequest(WebContext* svr) {
+  HandlerScope scope(this);
+  TraceBuffer::shared()->send(svr);
+}
+
+} // End of namespace lsc
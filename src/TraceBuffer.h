@@ -0,0 +1,143 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <UPnPLib.h>
+
+/**
+ *   Number of trace records kept. Each record is 24 bytes; once the buffer is full the oldest record is overwritten
+ *   and counted in dropped().
+ */
+#ifndef TRACE_SIZE
+#define TRACE_SIZE           64
+#endif
+#define TRACE_ARGS           3
+#define TRACE_LINE_SIZE      128
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+/**
+ *   Trace events. Each has an entry in the format table of TraceBuffer.cpp, in the same order.
+ */
+typedef enum TraceEvent {
+  TRACE_RELAY_REQUEST,                                    // RelayControl::setState(), requested ControlState
+  TRACE_RELAY_CONTENT,                                    // RelayControl::formatContent(), ControlState
+  TRACE_RELAY_SET,                                        // RelayControl::setControlState(), ControlState, pin level
+  TRACE_RELAY_SETUP,                                      // RelayControl::setup(), pin, ControlState
+  TRACE_SCR_CONTENT,                                      // SensorControlledRelay::formatContent(), ControlState, ControlMode
+  TRACE_SCR_STATE,                                        // SensorControlledRelay::setControlState(), current and requested ControlState
+  TRACE_SCR_MANUAL,                                       // SensorControlledRelay::setControlState() switches to MANUAL
+  TRACE_SCR_MODE,                                         // SensorControlledRelay::setControlMode(), ControlMode
+  TRACE_SCR_RESET,                                        // SensorControlledRelay::setControlMode(), ControlState from the sensor
+  TRACE_SCR_REQUEST,                                      // SensorControlledRelay::setMode(), requested ControlMode
+  TRACE_SCR_SCHEDULE,                                     // SensorControlledRelay::schedule(), ms to the next wakeup
+  TRACE_TIMER_CYCLE,                                      // OutletTimer::nextCycle(), minute of the week of the next ON and OFF (-1 if none)
+  TRACE_TIMER_FORM,                                       // OutletTimer::configForm(), bytes sent
+  TRACE_EVENTS
+} TraceEvent;
+
+typedef struct TraceRecord {
+  uint32_t        time;                                   // millis()
+  uint8_t         event;                                  // TraceEvent
+  UPnPObject*     source;                                 // Object that recorded the event, formatted by display name
+  int32_t         args[TRACE_ARGS];
+} TraceRecord;
+
+/** TraceBuffer replaces Serial.printf() in hot paths with a compact binary record (event, time, source and up to
+ *  three integer arguments) in a RAM ring buffer. Nothing is formatted when an event is recorded; records are turned
+ *  into text lines from a PROGMEM format table only when the buffer is drained, over HTTP by the GetTrace service of
+ *  ExtendedDevice or to a serial port by the sketch. Draining empties the buffer.
+ *  Usage:
+ *      if( loggingLevel(FINE) ) TraceBuffer::shared()->record(TRACE_RELAY_SET,this,ON,HIGH);
+ *      ...
+ *      if( Serial.available() && (Serial.read() == 't') ) TraceBuffer::shared()->drain(Serial);
+ *  A line looks like:
+ *      12345 Outlet Timer: relay ON, pin set to 1
+ */
+class TraceBuffer {
+  public:
+    TraceBuffer() {}
+
+    void                    record(TraceEvent event, UPnPObject* source, int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0);
+    void                    drain(Print& p);                                     // Print and remove all records
+    void                    send(WebContext* svr);                               // Send and remove all records as text/plain
+    void                    clear()                    {_head = 0; _count = 0;}
+
+    int                     count()                    {return _count;}
+    uint32_t                dropped()                  {return _dropped;}        // Records overwritten before they were drained
+    int                     format(const TraceRecord& r, char buffer[], int size, int pos);
+
+    static TraceBuffer*     shared();
+
+  private:
+    const TraceRecord&      oldest()                   {return _records[(_head + TRACE_SIZE - _count)%TRACE_SIZE];}
+
+    int                     _head          = 0;                                  // Next record written
+    int                     _count         = 0;
+    uint32_t                _dropped       = 0;
+    TraceRecord             _records[TRACE_SIZE];
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(TraceBuffer);
+};
+
+/**
+ *   GetTrace is a UPnPService that drains TraceBuffer::shared() as text/plain, one line per record, oldest first
+ */
+class GetTrace : public UPnPService {
+  public:
+    GetTrace();
+    virtual ~GetTrace() {}
+
+    void handleRequest(WebContext* svr);
+
+/**
+ *   Macros to define the following Runtime and UPnP Type Info:
+ *     private: static const ClassType  _classType;
+ *     public:  static const ClassType* classType();
+ *     public:  virtual void*           as(const ClassType* t);
+ *     public:  virtual boolean         isClassType( const ClassType* t);
+ *     private: static const char*      _upnpType;
+ *     public:  static const char*      upnpType()
+ *     public:  virtual const char*     getType()
+ *     public:  virtual boolean         isType(const char* t)
+ */
+    DEFINE_RTTI;
+    DERIVED_TYPE_CHECK(UPnPService);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(GetTrace);
+};
+
+} // End of namespace lsc
+
+#endif
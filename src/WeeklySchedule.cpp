@@ -0,0 +1,137 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#include "WeeklySchedule.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+const char* const DAY_NAMES[7] = {"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
+
+boolean WeeklySchedule::add(int start, int end, uint8_t days) {
+  if( _numIntervals >= SCHEDULE_MAX_INTERVALS ) return false;
+  _intervals[_numIntervals++] = {(uint16_t)start,(uint16_t)end,(uint8_t)(days & ALL_DAYS)};
+  return true;
+}
+
+boolean WeeklySchedule::addRange(int start, int end) {
+  if( _numRanges >= SCHEDULE_MAX_RANGES ) return false;
+  _ranges[_numRanges++] = {(uint16_t)start,(uint16_t)end};
+  return true;
+}
+
+/**
+ *  Expand every interval into one range per selected weekday, splitting a range that runs past the end of the week,
+ *  then sort by start and merge ranges that overlap or touch. Trivial intervals (start == end) are ignored. Compile
+ *  is all or nothing: if the ranges do not fit, none are kept, since a partial, unsorted array cannot be searched.
+ */
+boolean WeeklySchedule::compile() {
+  _numRanges = 0;
+  for( int i=0; i<_numIntervals; i++ ) {
+    const ScheduleInterval& in = _intervals[i];
+    if( in.start == in.end ) continue;
+    for( int d=0; d<7; d++ ) {
+      if( (in.days & (1 << d)) == 0 ) continue;
+      int start = d*MINUTES_PER_DAY + in.start;
+      int end   = d*MINUTES_PER_DAY + in.end + ((in.end < in.start)?(MINUTES_PER_DAY):(0));
+      if( end > MINUTES_PER_WEEK ) {
+        if( !addRange(0,end-MINUTES_PER_WEEK) ) {_numRanges = 0; return false;}
+        end = MINUTES_PER_WEEK;
+      }
+      if( !addRange(start,end) ) {_numRanges = 0; return false;}
+    }
+  }
+
+  for( int i=1; i<_numRanges; i++ ) {
+    ScheduleRange r = _ranges[i];
+    int j = i;
+    for( ; (j>0) && (_ranges[j-1].start > r.start); j-- ) _ranges[j] = _ranges[j-1];
+    _ranges[j] = r;
+  }
+
+  int n = 0;
+  for( int i=0; i<_numRanges; i++ ) {
+    if( (n > 0) && (_ranges[i].start <= _ranges[n-1].end) ) {
+      if( _ranges[i].end > _ranges[n-1].end ) _ranges[n-1].end = _ranges[i].end;
+    }
+    else _ranges[n++] = _ranges[i];
+  }
+  _numRanges = n;
+  return true;
+}
+
+int WeeklySchedule::find(int m) {
+  int lo = 0;
+  int hi = _numRanges - 1;
+  int result = -1;
+  while( lo <= hi ) {
+    int mid = (lo + hi)/2;
+    if( _ranges[mid].start <= m ) {
+      result = mid;
+      lo = mid + 1;
+    }
+    else hi = mid - 1;
+  }
+  return result;
+}
+
+boolean WeeklySchedule::isOn(int m) {
+  int i = find(m);
+  return ((i >= 0) && (m < _ranges[i].end));
+}
+
+/**
+ *  Ranges are disjoint and do not touch, so the next start is always the following range (wrapping to the first).
+ *  A range ending at the end of the week that continues at minute 0 is one ON period, whose start is not a transition.
+ */
+int WeeklySchedule::nextStart(int m) {
+  if( (_numRanges == 0) || ((_numRanges == 1) && wrapsWeek()) ) return -1;
+  int i = find(m) + 1;
+  if( i >= _numRanges ) i = 0;
+  if( (i == 0) && wrapsWeek() ) i = 1;
+  return _ranges[i].start;
+}
+
+int WeeklySchedule::nextEnd(int m) {
+  if( (_numRanges == 0) || ((_numRanges == 1) && wrapsWeek()) ) return -1;
+  int i = find(m);
+  if( (i < 0) || (m >= _ranges[i].end) ) i++;
+  if( i >= _numRanges ) i = 0;
+  if( (i == _numRanges-1) && wrapsWeek() ) i = 0;
+  return _ranges[i].end;
+}
+
+/**
+ *  Sakamoto's method, 0 is Sunday
+ */
+int WeeklySchedule::dayOfWeek(int year, int month, int day) {
+  static const int t[12] = {0,3,2,5,0,3,5,1,4,6,2,4};
+  if( month < 3 ) year -= 1;
+  return (year + year/4 - year/100 + year/400 + t[(month-1)%12] + day)%7;
+}
+
+const char* WeeklySchedule::dayName(int dayOfWeek) {return DAY_NAMES[((dayOfWeek%7)+7)%7];}
+
+} // End of namespace lsc
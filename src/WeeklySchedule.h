@@ -0,0 +1,118 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+
+#ifndef WEEKLY_SCHEDULE_H
+#define WEEKLY_SCHEDULE_H
+
+/**
+ *   WeeklySchedule only depends on the Arduino core for its types, so it can also be compiled on a host
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+typedef bool boolean;
+#endif
+
+/**
+ *   Maximum number of configured intervals, and of ON ranges after compilation. Each interval can produce one
+ *   range per selected weekday, plus one when it wraps the end of the week, so the default SCHEDULE_MAX_RANGES
+ *   holds any SCHEDULE_MAX_INTERVALS intervals. RAM is 5*SCHEDULE_MAX_INTERVALS + 4*SCHEDULE_MAX_RANGES bytes.
+ */
+#ifndef SCHEDULE_MAX_INTERVALS
+#define SCHEDULE_MAX_INTERVALS  32
+#endif
+#ifndef SCHEDULE_MAX_RANGES
+#define SCHEDULE_MAX_RANGES     (8*SCHEDULE_MAX_INTERVALS)
+#endif
+#define MINUTES_PER_DAY         1440
+#define MINUTES_PER_WEEK        10080
+#define ALL_DAYS                0x7F        // Weekday mask, bit 0 is Sunday
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef struct ScheduleInterval {
+  uint16_t   start;                         // Minutes from midnight
+  uint16_t   end;                           // Minutes from midnight, end < start wraps around midnight
+  uint8_t    days;                          // Weekdays the interval starts on, bit 0 is Sunday
+} ScheduleInterval;
+
+typedef struct ScheduleRange {
+  uint16_t   start;                         // Minute of week, inclusive
+  uint16_t   end;                           // Minute of week, exclusive
+} ScheduleRange;
+
+/** WeeklySchedule holds the configured ON intervals of an OutletTimer and compiles them into a sorted array of
+ *  disjoint, non-wrapping ON ranges over the minute of the week (Sunday 00:00 is 0). Wrap-around intervals are
+ *  split and overlapping intervals are merged at compile() time, so isOn() and the next transition are a binary
+ *  search.
+ *  Usage:
+ *     schedule.clear();
+ *     schedule.add(8*60,17*60,0x3E);            // Monday through Friday, 08:00 to 17:00
+ *     schedule.compile();
+ *     if( schedule.isOn(WeeklySchedule::minuteOfWeek(date,time)) ) ...
+ */
+class WeeklySchedule {
+  public:
+    WeeklySchedule() {}
+    virtual ~WeeklySchedule() {}
+
+    void                     clear()                  {_numIntervals = 0; _numRanges = 0;}
+    boolean                  add(int start, int end, uint8_t days = ALL_DAYS);  // Returns false if the schedule is full
+    boolean                  compile();                                         // Returns false, with no ranges (always OFF), if there are too many ranges
+
+    int                      numIntervals()           {return _numIntervals;}
+    const ScheduleInterval*  interval(int i)          {return (((i>=0)&&(i<_numIntervals))?(&_intervals[i]):(NULL));}
+    int                      numRanges()              {return _numRanges;}
+
+/**
+ *   Queries take the minute of week. Next start/end are minutes of week strictly after m (modulo a week), or -1 if
+ *   the schedule never changes state.
+ */
+    boolean                  isOn(int m);
+    int                      nextStart(int m);
+    int                      nextEnd(int m);
+
+    static int               dayOfWeek(int year, int month, int day);           // 0 is Sunday
+    static int               minuteOfWeek(int dayOfWeek, int hour, int min)    {return dayOfWeek*MINUTES_PER_DAY + hour*60 + min;}
+    static const char*       dayName(int dayOfWeek);
+
+  protected:
+    int                      find(int m);                                       // Index of the last range starting at or before m, or -1
+    boolean                  addRange(int start, int end);
+    boolean                  wrapsWeek()              {return ((_numRanges > 0) && (_ranges[0].start == 0) && (_ranges[_numRanges-1].end == MINUTES_PER_WEEK));}
+
+    ScheduleInterval         _intervals[SCHEDULE_MAX_INTERVALS];
+    ScheduleRange            _ranges[SCHEDULE_MAX_RANGES];
+    int                      _numIntervals = 0;
+    int                      _numRanges    = 0;
+};
+
+} // End of namespace lsc
+
+#endif
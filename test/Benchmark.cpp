@@ -0,0 +1,124 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include "MemoryStorage.h"
+#include "WeeklySchedule.h"
+#include "QueryArgs.h"
+#include "ConfigSchema.h"
+
+using namespace lsc;
+
+/**
+ *   Host timings of the pure DeviceLib modules, one line per case: nanoseconds per operation and, where it applies,
+ *   bytes produced. Host numbers do not predict ESP8266/ESP32 times, but compare one commit with another:
+ *       make -C test bench
+ */
+static volatile long sink = 0;
+
+template<typename F> void bench(const char* name, long n, long bytes, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for( long i=0; i<n; i++ ) f(i);
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double,std::nano>(end-start).count()/n;
+  if( bytes >= 0 ) printf("%-32s %10ld %12.1f ns/op %10ld bytes\n",name,n,ns,bytes);
+  else printf("%-32s %10ld %12.1f ns/op\n",name,n,ns);
+}
+
+void benchQueryArgs() {
+  static const char* values[] = {"1234","-42","+7","99999","12a"};
+  bench("QueryArgs::parseInt",1000000,-1,[](long i) {long v = 0; sink += QueryArgs::parseInt(values[i%5],v) + v;});
+  bench("QueryArgs::parseTime",1000000,-1,[](long i) {int h = 0, m = 0; sink += QueryArgs::parseTime(((i&1)?("08:30"):("23:59")),h,m) + h + m;});
+  bench("QueryArgs::parseOffset",1000000,-1,[](long i) {int h = 0, m = 0; sink += QueryArgs::parseOffset(((i&1)?("-05:30"):("9")),h,m) + h + m;});
+  bench("ArgView",1000000,-1,[](long i) {ArgView a("START_TIME_12","08:30"); sink += a.hash() + a.index();});
+}
+
+void benchWeeklySchedule() {
+  static WeeklySchedule s;
+  s.clear();
+  for( int i=0; i<SCHEDULE_MAX_INTERVALS; i++ ) s.add((i*45)%MINUTES_PER_DAY,(i*45+30)%MINUTES_PER_DAY,(uint8_t)(1 << (i%7)));
+  bench("WeeklySchedule::compile",100000,-1,[](long) {sink += s.compile();});
+  bench("WeeklySchedule::isOn",1000000,-1,[](long i) {sink += s.isOn(i%MINUTES_PER_WEEK);});
+  bench("WeeklySchedule::nextStart",1000000,-1,[](long i) {sink += s.nextStart(i%MINUTES_PER_WEEK);});
+  bench("WeeklySchedule::nextEnd",1000000,-1,[](long i) {sink += s.nextEnd(i%MINUTES_PER_WEEK);});
+}
+
+/**
+ *  A day of one minute samples of a slowly changing reading; bytes is the log size after 100000 samples
+ */
+void benchHistoryLog() {
+  MemoryStorage storage;
+  HistoryLog log("log",&storage);
+  log.begin();
+  auto start = std::chrono::steady_clock::now();
+  for( long i=0; i<100000; i++ ) log.append(60*i,20.0f + 0.1f*((i/10)%50));
+  log.flush();
+  double ns = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count()/100000;
+  printf("%-32s %10d %12.1f ns/op %10ld bytes\n","HistoryLog::append",100000,ns,storage.total());
+  bench("HistoryLog::read",10,-1,[&](long) {sink += log.read(0,0xFFFFFFFF,[](uint32_t t, float v) {sink += t;});});
+  bench("HistoryLog::begin",1000,-1,[&](long) {HistoryLog l("log",&storage); sink += l.begin() + l.origin();});
+}
+
+class BenchDevice {
+  public:
+    const char*   getDisplayName()                   {return _name;}
+    void          setDisplayName(const char* name)   {strncpy(_name,name,sizeof(_name)-1);}
+
+    char          _name[CONFIG_TEXT_SIZE] = "Basement Dehumidifier";
+    long          _threshold = 50;
+    char          _unit      = 'F';
+    long          _offset    = -300;
+};
+
+const char BenchDevice_threshold[]  = "threshold";
+const char BenchDevice_unit[]       = "unit";
+const char BenchDevice_offset[]     = "offset";
+const char BenchDevice_choices[]    = "CF";
+
+constexpr ConfigField BenchDevice_fields[] = {
+  CONFIG_DISPLAY_NAME(BenchDevice,sensor_name_label),
+  CONFIG_INT(BenchDevice,BenchDevice_threshold,BenchDevice_threshold,0,100,_threshold,_threshold=v),
+  CONFIG_CHAR(BenchDevice,BenchDevice_unit,BenchDevice_unit,BenchDevice_choices,_unit,_unit=v),
+  CONFIG_OFFSET(BenchDevice,BenchDevice_offset,BenchDevice_offset,-720,840,_offset,_offset=v)
+};
+const ConfigSchema BenchDevice_schema(BenchDevice_fields,4);
+
+void benchConfigSchema() {
+  static BenchDevice d;
+  static uint8_t     image[128];
+  int len = BenchDevice_schema.serialize(image,sizeof(image),&d);
+  bench("ConfigSchema::serialize",1000000,len,[](long) {sink += BenchDevice_schema.serialize(image,sizeof(image),&d);});
+  bench("ConfigSchema::deserialize",1000000,len,[len](long) {sink += BenchDevice_schema.deserialize(image,len,&d);});
+  bench("ConfigSchema::parse",1000000,-1,[](long i) {
+    ArgView a(((i&1)?("THRESHOLD"):("offset")),((i&1)?("65"):("-05:00")));
+    sink += BenchDevice_schema.parse(a,&d);
+  });
+}
+
+int main() {
+  benchQueryArgs();
+  benchWeeklySchedule();
+  benchHistoryLog();
+  benchConfigSchema();
+  return 0;
+}
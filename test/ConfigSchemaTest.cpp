@@ -0,0 +1,170 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HostTest.h"
+#include "ConfigSchema.h"
+
+using namespace lsc;
+
+class TestDevice {
+  public:
+    const char*   getDisplayName()                   {return _name;}
+    void          setDisplayName(const char* name)   {strncpy(_name,name,sizeof(_name)-1); _name[sizeof(_name)-1] = '\0';}
+
+    char          _name[CONFIG_TEXT_SIZE] = "Test";
+    long          _threshold = 50;
+    char          _unit      = 'F';
+    long          _offset    = 0;
+};
+
+const char TestDevice_threshold[]   = "threshold";
+const char TestDevice_unit[]        = "unit";
+const char TestDevice_offset[]      = "offset";
+const char TestDevice_choices[]     = "CF";
+
+constexpr ConfigField TestDevice_fields[] = {
+  CONFIG_DISPLAY_NAME(TestDevice,sensor_name_label),
+  CONFIG_INT(TestDevice,TestDevice_threshold,TestDevice_threshold,0,100,_threshold,_threshold=v),
+  CONFIG_CHAR(TestDevice,TestDevice_unit,TestDevice_unit,TestDevice_choices,_unit,_unit=v),
+  CONFIG_OFFSET(TestDevice,TestDevice_offset,TestDevice_offset,-720,840,_offset,_offset=v)
+};
+const ConfigSchema TestDevice_schema(TestDevice_fields,4);
+const ConfigSchema TestDevice_short(TestDevice_fields,3);
+
+void testParse() {
+  TestDevice d;
+  ArgView threshold("THRESHOLD","75");
+  ArgView unit("unit","C");
+  ArgView offset("Offset","-05:30");
+  ArgView name("displayName","Porch");
+  CHECK(TestDevice_schema.parse(threshold,&d));  CHECK_EQ(d._threshold,75);
+  CHECK(TestDevice_schema.parse(unit,&d));       CHECK_EQ(d._unit,'C');
+  CHECK(TestDevice_schema.parse(offset,&d));     CHECK_EQ(d._offset,-330);
+  CHECK(TestDevice_schema.parse(name,&d));       CHECK(strcmp(d._name,"Porch") == 0);
+
+  ArgView high("threshold","101");
+  ArgView badUnit("unit","K");
+  ArgView longUnit("unit","CF");
+  ArgView badOffset("offset","15");
+  ArgView empty("displayName","");
+  ArgView other("state","on");
+  CHECK(!TestDevice_schema.parse(high,&d));
+  CHECK(!TestDevice_schema.parse(badUnit,&d));
+  CHECK(!TestDevice_schema.parse(longUnit,&d));
+  CHECK(!TestDevice_schema.parse(badOffset,&d));
+  CHECK(!TestDevice_schema.parse(empty,&d));
+  CHECK(!TestDevice_schema.parse(other,&d));
+  CHECK_EQ(d._threshold,75);
+  CHECK_EQ(d._unit,'C');
+  CHECK_EQ(d._offset,-330);
+  CHECK(strcmp(d._name,"Porch") == 0);
+}
+
+/**
+ *  A form always submits every field; values equal to the current ones are not counted as changes
+ */
+void testResubmit() {
+  TestDevice d;
+  ArgView name("displayName","Test");
+  ArgView threshold("threshold","50");
+  ArgView unit("unit","F");
+  ArgView offset("offset","+00:00");
+  int changed = TestDevice_schema.parse(name,&d) + TestDevice_schema.parse(threshold,&d) + TestDevice_schema.parse(unit,&d) +
+                TestDevice_schema.parse(offset,&d);
+  CHECK_EQ(changed,0);
+
+  ArgView update("threshold","60");
+  CHECK(TestDevice_schema.parse(update,&d));
+  CHECK(!TestDevice_schema.parse(update,&d));
+  CHECK_EQ(d._threshold,60);
+}
+
+void testImage() {
+  TestDevice d;
+  d.setDisplayName("Basement Dehumidifier");
+  d._threshold = 65;
+  d._unit      = 'C';
+  d._offset    = -300;
+  uint8_t image[128];
+  int len = TestDevice_schema.serialize(image,sizeof(image),&d);
+  CHECK_EQ(len,4 + 1 + strlen("Basement Dehumidifier") + 3*4);
+  CHECK_EQ(TestDevice_schema.serialize(image,len-1,&d),0);
+
+  TestDevice r;
+  CHECK_EQ(TestDevice_schema.deserialize(image,len,&r),len);
+  CHECK(strcmp(r._name,"Basement Dehumidifier") == 0);
+  CHECK_EQ(r._threshold,65);
+  CHECK_EQ(r._unit,'C');
+  CHECK_EQ(r._offset,-300);
+
+/**
+ *  Trailing data is not part of the image; a short image, or one from another table, sets nothing
+ */
+  uint8_t padded[128];
+  memcpy(padded,image,len);
+  memset(padded+len,0xFF,16);
+  TestDevice p;
+  CHECK_EQ(TestDevice_schema.deserialize(padded,len+16,&p),len);
+  CHECK_EQ(p._offset,-300);
+
+  TestDevice t;
+  CHECK_EQ(TestDevice_schema.deserialize(image,len-1,&t),0);
+  CHECK_EQ(TestDevice_short.deserialize(image,len,&t),0);
+  CHECK(TestDevice_schema.signature() != TestDevice_short.signature());
+  CHECK(strcmp(t._name,"Test") == 0);
+  CHECK_EQ(t._threshold,50);
+
+/**
+ *  Values are validated as if submitted: an out of range threshold is skipped, the rest are applied
+ */
+  int at = 4 + 1 + strlen("Basement Dehumidifier");
+  image[at] = 200;
+  TestDevice v;
+  CHECK_EQ(TestDevice_schema.deserialize(image,len,&v),len);
+  CHECK_EQ(v._threshold,50);
+  CHECK_EQ(v._unit,'C');
+}
+
+void testLongText() {
+  TestDevice d;
+  char name[64];
+  memset(name,'x',sizeof(name)-1);
+  name[sizeof(name)-1] = '\0';
+  strcpy(d._name,"");
+  uint8_t image[128];
+  ArgView a("displayName",name);
+  CHECK(!TestDevice_schema.parse(a,&d));
+  d.setDisplayName(name);
+  int len = TestDevice_schema.serialize(image,sizeof(image),&d);
+  CHECK_EQ(image[4],CONFIG_TEXT_SIZE-1);
+  TestDevice r;
+  CHECK_EQ(TestDevice_schema.deserialize(image,len,&r),len);
+  CHECK_EQ(strlen(r._name),CONFIG_TEXT_SIZE-1);
+}
+
+int main() {
+  testParse();
+  testResubmit();
+  testImage();
+  testLongText();
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "DiscoveryTable.h"
+
+using namespace lsc;
+
+/**
+ *   Simulated SSDP fleet for discovery scaling. N root devices answer one M-SEARCH, each after a random delay within
+ *   MX (the search sends MX: 2) plus network latency, and some repeat their reply. Replies queue in a socket of
+ *   QUEUE packets, dropping when full, and the loop reads at most DISCOVERY_MAX_PACKETS of them every LOOP ms until
+ *   the reply window closes, as DiscoveryCache::doDevice() does. Each reply is raw SSDP text parsed by
+ *   DiscoveryTable::reply(), the path DiscoveryCache::readReplies() takes; the display name header is UPnPLib's, so
+ *   the name is passed as UPnPBuffer::displayName() would return it. A second pass feeds NOTIFY announcements
+ *   through DiscoveryTable::notify().
+ *   The resulting entries are rendered as ExtendedDevice::streamDiscovered() does, into CHUNK_SIZE chunks, and the
+ *   streamed bytes reported. app_button is a UPnPLib template, so BUTTON stands in for it; build with
+ *   -DFLEET_BUTTON='"..."' to measure another template. The random sequence is seeded, so runs compare from one
+ *   commit to the next:
+ *       make -C test bench
+ */
+#define MX_MS           2000
+#define REPLY_WINDOW    4000             // DISCOVERY_REPLY_WINDOW
+#define REPEAT_PERCENT  50               // Replies sent twice
+#define BYEBYE_PERCENT  10               // Devices leaving in the NOTIFY pass
+#define NEW_PERCENT     10               // Devices announcing themselves in the NOTIFY pass
+#define CHUNK_SIZE      1024             // ChunkedWriter CHUNK_SIZE
+#ifndef FLEET_BUTTON
+#define FLEET_BUTTON    "<a href=\"%s\" class=\"button\">%s</a><br>"
+#endif
+
+static const char reply_packet[]  = "HTTP/1.1 200 OK\r\n"
+                                    "CACHE-CONTROL: max-age=1800\r\n"
+                                    "EXT:\r\n"
+                                    "LOCATION: %s\r\n"
+                                    "SERVER: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n"
+                                    "ST: upnp:rootdevice\r\n"
+                                    "USN: %s\r\n\r\n";
+static const char notify_packet[] = "NOTIFY * HTTP/1.1\r\n"
+                                    "HOST: 239.255.255.250:1900\r\n"
+                                    "CACHE-CONTROL: max-age=1800\r\n"
+                                    "LOCATION: %s\r\n"
+                                    "NT: upnp:rootdevice\r\n"
+                                    "NTS: ssdp:%s\r\n"
+                                    "USN: %s\r\n\r\n";
+
+typedef struct Packet {
+  unsigned long   arrival;
+  int             device;
+} Packet;
+
+static uint32_t seed = 1;
+static uint32_t next(uint32_t n) {seed = seed*1103515245 + 12345; return (seed >> 8)%n;}
+
+static void device(int d, char usn[], char loc[], char name[]) {
+  snprintf(usn,DISCOVERY_USN_SIZE,"uuid:%08x-0000-1000-8000-%012x::upnp:rootdevice",d,d);
+  snprintf(loc,DISCOVERY_LOCATION_SIZE,"http://10.0.%d.%d:80/",d/250,d%250 + 2);
+  snprintf(name,DISCOVERY_NAME_SIZE,"Device %d",d);
+}
+
+/**
+ *   Bytes streamed for the entries of a table, formatted into a CHUNK_SIZE buffer and flushed when a button does
+ *   not fit, as ChunkedWriter::printf_P() does. Chunked transfer framing (size line and CRLF) is counted per chunk.
+ */
+static long streamed(DiscoveryTable& table, int& chunks) {
+  char buffer[CHUNK_SIZE];
+  long sent = 0;
+  int  pos  = 0;
+  chunks    = 0;
+  for( int i=0; i<table.size(); i++ ) {
+    const DiscoveryEntry* e = table.entry(i);
+    int n = snprintf(buffer+pos,CHUNK_SIZE-pos,FLEET_BUTTON,e->location,e->name);
+    if( pos + n >= CHUNK_SIZE-1 ) {
+      sent += pos + snprintf(NULL,0,"%x\r\n\r\n",pos);
+      chunks++;
+      pos = snprintf(buffer,CHUNK_SIZE,FLEET_BUTTON,e->location,e->name);
+    }
+    else pos += n;
+  }
+  if( pos > 0 ) {
+    sent += pos + snprintf(NULL,0,"%x\r\n\r\n",pos);
+    chunks++;
+  }
+  return sent;
+}
+
+typedef struct FleetResult {
+  int             sent;
+  int             dropped;
+  uint32_t        replies;
+  uint32_t        duplicates;
+  uint32_t        evictions;
+  int             entries;
+  unsigned long   first;
+  unsigned long   complete;
+  long            streamed;                // Bytes of the streamDiscovered() buttons, with chunk framing
+  int             chunks;
+  uint32_t        notifies;
+  uint32_t        rejected;
+  int             announced;               // Entries after the NOTIFY pass
+  int             searches;                // Searches requested to learn the name of a new device
+} FleetResult;
+
+FleetResult simulate(int devices, unsigned long loop, int queue) {
+  std::vector<Packet> packets;
+  seed = 1;
+  for( int d=0; d<devices; d++ ) {
+    unsigned long t = next(MX_MS) + 1 + next(5);
+    packets.push_back({t,d});
+    if( (int)next(100) < REPEAT_PERCENT ) packets.push_back({t + 1 + next(100),d});
+  }
+  std::stable_sort(packets.begin(),packets.end(),[](const Packet& a, const Packet& b) {return a.arrival < b.arrival;});
+
+  DiscoveryTable      table;
+  std::vector<Packet> socket;
+  FleetResult         result = {};
+  size_t              p      = 0;
+  table.searched(0);
+  for( unsigned long now=loop; now<=REPLY_WINDOW; now+=loop ) {
+    for( ; (p < packets.size()) && (packets[p].arrival <= now); p++ ) {
+      if( (int)socket.size() < queue ) socket.push_back(packets[p]);
+      else result.dropped++;
+    }
+    for( int n=0; (n<DISCOVERY_MAX_PACKETS) && !socket.empty(); n++ ) {
+      char usn[DISCOVERY_USN_SIZE];
+      char loc[DISCOVERY_LOCATION_SIZE];
+      char name[DISCOVERY_NAME_SIZE];
+      char packet[512];
+      device(socket.front().device,usn,loc,name);
+      socket.erase(socket.begin());
+      snprintf(packet,sizeof(packet),reply_packet,loc,usn);
+      table.reply(packet,name,now);
+    }
+  }
+  result.sent       = packets.size();
+  result.replies    = table.stats().replies;
+  result.duplicates = table.stats().duplicates;
+  result.evictions  = table.stats().evictions;
+  result.entries    = table.size();
+  result.first      = table.stats().firstReply;
+  result.complete   = table.stats().lastReply;
+  result.streamed   = streamed(table,result.chunks);
+
+/**
+ *  NOTIFY pass: some devices leave, some new ones announce themselves without a display name, the rest refresh
+ */
+  unsigned long now = REPLY_WINDOW + 1000;
+  for( int d=0; d<devices + devices*NEW_PERCENT/100; d++, now+=10 ) {
+    char usn[DISCOVERY_USN_SIZE];
+    char loc[DISCOVERY_LOCATION_SIZE];
+    char name[DISCOVERY_NAME_SIZE];
+    char packet[512];
+    device(d,usn,loc,name);
+    boolean leaving = (d < devices) && ((int)next(100) < BYEBYE_PERCENT);
+    snprintf(packet,sizeof(packet),notify_packet,loc,((leaving)?("byebye"):("alive")),usn);
+    if( table.notify(packet,NULL,now) ) result.searches++;
+  }
+  result.notifies   = table.stats().notifies;
+  result.rejected   = table.stats().rejected;
+  result.announced  = table.size();
+  return result;
+}
+
+void run(unsigned long loop, int queue) {
+  static const int fleet[] = {10,25,50,100,200};
+  printf("\nloop %lu ms, socket queue %d packets, %d packets per loop, cache %d entries\n",loop,queue,DISCOVERY_MAX_PACKETS,DISCOVERY_CACHE_SIZE);
+  printf("%8s %8s %8s %8s %10s %8s %9s %10s %12s %9s %7s %9s %9s %9s\n","devices","packets","dropped","replies","duplicates","entries",
+         "evicted","first ms","complete ms","streamed","chunks","notifies","announced","searches");
+  for( int n : fleet ) {
+    FleetResult r = simulate(n,loop,queue);
+    printf("%8d %8d %8d %8lu %10lu %8d %9lu %10lu %12lu %9ld %7d %9lu %9d %9d\n",n,r.sent,r.dropped,(unsigned long)r.replies,
+           (unsigned long)r.duplicates,r.entries,(unsigned long)r.evictions,r.first,r.complete,r.streamed,r.chunks,
+           (unsigned long)r.notifies,r.announced,r.searches);
+    if( r.rejected > 0 ) printf("%8s %lu packets rejected\n","",(unsigned long)r.rejected);
+  }
+}
+
+int main() {
+  run(10,8);
+  run(50,8);
+  run(50,32);
+  return 0;
+}
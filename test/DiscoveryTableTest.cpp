@@ -0,0 +1,177 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <stdio.h>
+#include "HostTest.h"
+#include "DiscoveryTable.h"
+
+using namespace lsc;
+
+#define MAX_AGE  1800000UL
+
+static const char* usn(int i) {
+  static char buffer[DISCOVERY_USN_SIZE];
+  snprintf(buffer,sizeof(buffer),"uuid:device-%d::upnp:rootdevice",i);
+  return buffer;
+}
+
+void testReplies() {
+  DiscoveryTable table;
+  table.searched(1000);
+  table.replied(usn(1),1150);  table.update(usn(1),"http://10.0.0.1:80/","Porch",MAX_AGE,1150);
+  table.replied(usn(2),1700);  table.update(usn(2),"http://10.0.0.2:80/","Garage",MAX_AGE,1700);
+  table.replied(usn(1),1900);  table.update(usn(1),"http://10.0.0.1:80/","Porch",MAX_AGE,1900);
+  CHECK_EQ(table.size(),2);
+  CHECK_EQ(table.stats().searches,1);
+  CHECK_EQ(table.stats().replies,2);
+  CHECK_EQ(table.stats().duplicates,1);
+  CHECK_EQ(table.stats().searchReplies,2);
+  CHECK_EQ(table.stats().firstReply,150);
+  CHECK_EQ(table.stats().lastReply,700);
+
+/**
+ *  A device seen before the search is not a duplicate of it
+ */
+  table.searched(5000);
+  table.replied(usn(1),5100);  table.update(usn(1),"http://10.0.0.1:80/","Porch",MAX_AGE,5100);
+  CHECK_EQ(table.stats().searches,2);
+  CHECK_EQ(table.stats().replies,3);
+  CHECK_EQ(table.stats().duplicates,1);
+  CHECK_EQ(table.stats().searchReplies,1);
+  CHECK_EQ(table.stats().firstReply,100);
+  CHECK(strcmp(table.entry(1)->name,"Garage") == 0);
+}
+
+void testEviction() {
+  DiscoveryTable table;
+  table.searched(0);
+  for( int i=0; i<DISCOVERY_CACHE_SIZE; i++ ) table.update(usn(i),"/","Device",MAX_AGE,100+i);
+  table.update(usn(0),"/","Device",MAX_AGE,500);
+  CHECK_EQ(table.size(),DISCOVERY_CACHE_SIZE);
+  CHECK_EQ(table.stats().evictions,0);
+  table.update(usn(100),"/","New",MAX_AGE,600);
+  CHECK_EQ(table.size(),DISCOVERY_CACHE_SIZE);
+  CHECK_EQ(table.stats().evictions,1);
+  CHECK_EQ(table.stats().peak,DISCOVERY_CACHE_SIZE);
+  CHECK(table.indexOf(usn(1)) < 0);
+  CHECK(table.indexOf(usn(0)) >= 0);
+  CHECK(table.indexOf(usn(100)) >= 0);
+}
+
+void testExpiry() {
+  DiscoveryTable table;
+  table.update(usn(1),"/","One",1000,0);
+  table.update(usn(2),"/","Two",5000,0);
+  table.update(usn(3),"/","Three",1000,800);
+  table.expire(1500);
+  CHECK_EQ(table.size(),2);
+  CHECK(strcmp(table.entry(0)->name,"Two") == 0);
+  CHECK(strcmp(table.entry(1)->name,"Three") == 0);
+  table.remove(table.indexOf(usn(2)));
+  table.remove(-1);
+  CHECK_EQ(table.size(),1);
+  CHECK(table.entry(1) == NULL);
+  table.expire(10000);
+  CHECK(table.isEmpty());
+}
+
+/**
+ *  Values are truncated to the entry size, and an entry can be refreshed with its own name
+ */
+void testValues() {
+  DiscoveryTable table;
+  char name[64];
+  memset(name,'n',sizeof(name)-1);
+  name[sizeof(name)-1] = '\0';
+  table.update(usn(1),"http://10.0.0.1:80/",name,MAX_AGE,0);
+  CHECK_EQ(strlen(table.entry(0)->name),DISCOVERY_NAME_SIZE-1);
+  const DiscoveryEntry* e = table.entry(0);
+  table.update(usn(1),"http://10.0.0.9:80/",e->name,MAX_AGE,10);
+  CHECK_EQ(strlen(e->name),DISCOVERY_NAME_SIZE-1);
+  CHECK_EQ(strncmp(e->location,"http://10.0.0.9:80/",DISCOVERY_LOCATION_SIZE),0);
+  CHECK_EQ(e->lastSeen,10);
+}
+
+/**
+ *  Raw SSDP text as read from the sockets; header names are case insensitive and values trimmed
+ */
+void testPackets() {
+  DiscoveryTable table;
+  char value[DISCOVERY_USN_SIZE];
+  table.searched(0);
+  const char* reply = "HTTP/1.1 200 OK\r\n"
+                      "Cache-Control: max-age = 120\r\n"
+                      "LOCATION:http://10.0.0.1:80/ \r\n"
+                      "ST: upnp:rootdevice\r\n"
+                      "USN: uuid:porch::upnp:rootdevice\r\n\r\n";
+  CHECK(DiscoveryTable::headerValue(reply,"location",value,sizeof(value)));
+  CHECK(strcmp(value,"http://10.0.0.1:80/") == 0);
+  CHECK(!DiscoveryTable::headerValue(reply,"HTTP/1.1 200 OK",value,sizeof(value)));
+  CHECK(!DiscoveryTable::headerValue(reply,"US",value,sizeof(value)));
+  CHECK(DiscoveryTable::headerValue(reply,"USN",value,8));
+  CHECK(strcmp(value,"uuid:po") == 0);
+  CHECK_EQ(DiscoveryTable::maxAge(reply),120000UL);
+  CHECK_EQ(DiscoveryTable::maxAge("HTTP/1.1 200 OK\r\nUSN: x\r\n\r\n"),DISCOVERY_MAX_AGE*1000UL);
+
+  CHECK(table.reply(reply,"Porch",100));
+  CHECK(!table.reply(reply,NULL,110));
+  CHECK(!table.reply("HTTP/1.1 404 Not Found\r\nUSN: uuid:x\r\n\r\n","X",120));
+  CHECK(!table.reply("HTTP/1.1 200 OK\r\nLOCATION: /\r\n\r\n","X",130));
+  CHECK(table.reply("HTTP/1.1 200 OK\r\nUSN: uuid:garage::upnp:rootdevice\r\n\r\n","Garage",140));
+  CHECK_EQ(table.size(),2);
+  CHECK_EQ(table.stats().rejected,3);
+  CHECK_EQ(table.stats().replies,2);
+  const DiscoveryEntry* e = table.entry(0);
+  CHECK_EQ(strncmp(e->name,"Porch",DISCOVERY_NAME_SIZE),0);
+  CHECK_EQ(e->maxAge,120000UL);
+  CHECK_EQ(strncmp(table.entry(1)->location,"/",DISCOVERY_LOCATION_SIZE),0);
+
+/**
+ *  NOTIFY: only upnp:rootdevice counts; alive refreshes, byebye removes, and an unknown device without a name
+ *  asks for a search
+ */
+  CHECK(!table.notify("NOTIFY * HTTP/1.1\r\nNT: urn:schemas-upnp-org:device:Basic:1\r\nNTS: ssdp:alive\r\nUSN: uuid:y\r\n\r\n",NULL,200));
+  CHECK(!table.notify("NOTIFY * HTTP/1.1\r\nNT: upnp:rootdevice\r\nNTS: ssdp:alive\r\nUSN: uuid:porch::upnp:rootdevice\r\n"
+                      "LOCATION: http://10.0.0.7:80/\r\n\r\n",NULL,300));
+  CHECK_EQ(table.size(),2);
+  CHECK_EQ(strncmp(e->name,"Porch",DISCOVERY_NAME_SIZE),0);
+  CHECK_EQ(strncmp(e->location,"http://10.0.0.7:80/",DISCOVERY_LOCATION_SIZE),0);
+  CHECK_EQ(e->lastSeen,300);
+  CHECK(table.notify("NOTIFY * HTTP/1.1\r\nNT: upnp:rootdevice\r\nNTS: ssdp:alive\r\nUSN: uuid:new::upnp:rootdevice\r\n"
+                     "LOCATION: http://10.0.0.8:80/\r\n\r\n",NULL,400));
+  CHECK_EQ(table.size(),3);
+  CHECK(!table.notify("NOTIFY * HTTP/1.1\r\nNT: upnp:rootdevice\r\nNTS: ssdp:byebye\r\nUSN: uuid:garage::upnp:rootdevice\r\n\r\n",NULL,500));
+  CHECK_EQ(table.size(),2);
+  CHECK(table.indexOf("uuid:garage::upnp:rootdevice") < 0);
+  CHECK_EQ(table.stats().notifies,3);
+  CHECK(!table.notify("M-SEARCH * HTTP/1.1\r\nST: upnp:rootdevice\r\n\r\n",NULL,600));
+  CHECK_EQ(table.stats().notifies,3);
+}
+
+int main() {
+  testReplies();
+  testEviction();
+  testExpiry();
+  testValues();
+  testPackets();
+  return HOST_TEST_RESULT();
+}
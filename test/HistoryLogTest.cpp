@@ -0,0 +1,165 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HostTest.h"
+#include "MemoryStorage.h"
+
+using namespace lsc;
+
+static float value(uint32_t t) {return 20.0f + 0.1f*((t/60)%50);}
+
+/**
+ *  Read every sample, checking times increase and values are exact. Returns the number of samples, last is the
+ *  time of the last one.
+ */
+static int readAll(HistoryLog& log, uint32_t& last) {
+  boolean ordered = true;
+  boolean exact   = true;
+  last = 0;
+  int n = log.read(0,0xFFFFFFFF,[&](uint32_t t, float v) {
+    if( (last > 0) && (t <= last) ) ordered = false;
+    if( v != value(t) ) exact = false;
+    last = t;
+  });
+  CHECK(ordered);
+  CHECK(exact);
+  return n;
+}
+
+/**
+ *  The newest file, the one whose first segment has the highest sequence number
+ */
+static std::vector<uint8_t>& newest(MemoryStorage& storage) {
+  char     p[HISTORY_PATH_SIZE];
+  int      result = 0;
+  uint32_t seq    = 0;
+  for( int i=0; i<HISTORY_FILES; i++ ) {
+    snprintf(p,sizeof(p),"log.%d",i);
+    if( storage.size(p) < 12 ) continue;
+    std::vector<uint8_t>& f = storage.file(p);
+    uint32_t s = f[8] | (f[9] << 8) | (f[10] << 16) | ((uint32_t)f[11] << 24);
+    if( s >= seq ) {
+      seq    = s;
+      result = i;
+    }
+  }
+  snprintf(p,sizeof(p),"log.%d",result);
+  return storage.file(p);
+}
+
+void testCrc() {
+  CHECK_EQ(HistoryLog::crc32((const uint8_t*)"123456789",9),0xCBF43926L);
+  CHECK_EQ(HistoryLog::crc32((const uint8_t*)"6789",4,HistoryLog::crc32((const uint8_t*)"12345",5)),0xCBF43926L);
+}
+
+void testRoundTrip() {
+  MemoryStorage storage;
+  HistoryLog log("log",&storage);
+  CHECK(log.begin());
+  CHECK_EQ(log.origin(),0);
+  for( uint32_t i=0; i<1000; i++ ) log.append(60*i,value(60*i));
+  uint32_t last = 0;
+  CHECK_EQ(readAll(log,last),1000);
+  CHECK_EQ(last,60*999);
+  log.flush();
+  CHECK_EQ(readAll(log,last),1000);
+  CHECK_EQ(log.read(6000,11940,[](uint32_t,float){}),100);
+  CHECK(storage.total() < 1000*8);                              // Less than raw time and value
+
+  HistoryLog reopened("log",&storage);
+  CHECK(reopened.begin());
+  CHECK_EQ(reopened.origin(),60*999+1);
+  CHECK_EQ(reopened.segments(),log.segments());
+}
+
+/**
+ *  A partial segment spanning HISTORY_FLUSH_INTERVAL is written without an explicit flush
+ */
+void testPeriodicFlush() {
+  MemoryStorage storage;
+  HistoryLog log("log",&storage);
+  log.begin();
+  for( uint32_t t=0; t<HISTORY_FLUSH_INTERVAL; t+=60 ) log.append(t,1.0f);
+  CHECK_EQ(storage.total(),0);
+  log.append(HISTORY_FLUSH_INTERVAL,1.0f);
+  CHECK(storage.total() > 0);
+  CHECK_EQ(log.segments(),1);
+}
+
+/**
+ *  Cut the last segment short (damage 30) or flip a byte of its payload (damage -1). Origin comes from the last
+ *  intact segment, and new samples are appended to the next file and read back after the old ones.
+ */
+void testTorn(int damage) {
+  MemoryStorage storage;
+  {
+    HistoryLog log("log",&storage);
+    log.begin();
+    for( uint32_t i=0; i<2000; i++ ) log.append(60*i,value(60*i));
+    log.flush();
+  }
+  std::vector<uint8_t>& f = newest(storage);
+  if( damage > 0 ) f.resize(f.size()-damage);
+  else f[f.size()-10] ^= 0x55;
+
+  HistoryLog log("log",&storage);
+  CHECK(log.begin());
+  uint32_t last = 0;
+  int n = readAll(log,last);
+  CHECK(n > 1900);
+  CHECK(n < 2000);
+  CHECK_EQ(log.origin(),last+1);
+
+  uint32_t origin = log.origin();
+  for( uint32_t i=0; i<100; i++ ) log.append(origin+60*i,value(origin+60*i));
+  log.flush();
+  CHECK_EQ(readAll(log,last),n+100);
+  CHECK_EQ(last,origin+60*99);
+}
+
+/**
+ *  Writing several times HISTORY_FILES*HISTORY_FILE_SIZE drops the oldest files
+ */
+void testRing() {
+  MemoryStorage storage;
+  HistoryLog log("log",&storage);
+  log.begin();
+  uint32_t i = 0;
+  for( ; log.segments() < 8L*HISTORY_FILES*HISTORY_FILE_SIZE/HISTORY_SEGMENT_SIZE; i++ ) log.append(60*i,value(60*i));
+  log.flush();
+  CHECK(storage.total() <= (long)HISTORY_FILES*HISTORY_FILE_SIZE);
+  uint32_t last = 0;
+  int n = readAll(log,last);
+  CHECK(n > 0);
+  CHECK(n < (int)i);
+  CHECK_EQ(last,60*(i-1));
+}
+
+int main() {
+  testCrc();
+  testRoundTrip();
+  testPeriodicFlush();
+  testTorn(30);
+  testTorn(-1);
+  testRing();
+  return HOST_TEST_RESULT();
+}
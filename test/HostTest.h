@@ -0,0 +1,39 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+/**
+ *   Minimal checks for the host tests. CHECK records a failure and continues; a test program returns
+ *   HOST_TEST_RESULT() from main() so make stops on the first failing program.
+ */
+static int host_test_failures = 0;
+
+#define CHECK(cond)          do { if( !(cond) ) {host_test_failures++; printf("%s:%d: CHECK(%s) failed\n",__FILE__,__LINE__,#cond);} } while(0)
+#define CHECK_EQ(a,b)        do { long _a = (long)(a); long _b = (long)(b); \
+                                  if( _a != _b ) {host_test_failures++; printf("%s:%d: CHECK_EQ(%s,%s) failed, %ld != %ld\n",__FILE__,__LINE__,#a,#b,_a,_b);} } while(0)
+#define HOST_TEST_RESULT()   (printf("%s: %s\n",__FILE__,((host_test_failures==0)?("passed"):("FAILED"))), ((host_test_failures==0)?(0):(1)))
+
+#endif
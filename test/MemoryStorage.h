@@ -0,0 +1,58 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#ifndef MEMORY_STORAGE_H
+#define MEMORY_STORAGE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "HistoryLog.h"
+
+/**
+ *   LogStorage kept in memory, so tests can make torn writes by truncating or corrupting a file, and the benchmark
+ *   measures the log without file system overhead
+ */
+class MemoryStorage : public lsc::LogStorage {
+  public:
+    boolean   append(const char* path, const uint8_t* data, size_t len)       {_files[path].insert(_files[path].end(),data,data+len); return true;}
+    long      size(const char* path)                                          {return ((_files.count(path)>0)?((long)_files[path].size()):(-1));}
+    int       read(const char* path, size_t offset, uint8_t* data, size_t len);
+    boolean   remove(const char* path)                                        {return (_files.erase(path) > 0);}
+
+    std::vector<uint8_t>& file(const char* path)                              {return _files[path];}
+    long      total()                                                         {long n = 0; for( auto& f : _files ) n += f.second.size(); return n;}
+
+  private:
+    std::map<std::string,std::vector<uint8_t>> _files;
+};
+
+inline int MemoryStorage::read(const char* path, size_t offset, uint8_t* data, size_t len) {
+  if( _files.count(path) == 0 ) return -1;
+  std::vector<uint8_t>& f = _files[path];
+  if( offset > f.size() ) return 0;
+  size_t n = ((offset+len > f.size())?(f.size()-offset):(len));
+  memcpy(data,f.data()+offset,n);
+  return (int)n;
+}
+
+#endif
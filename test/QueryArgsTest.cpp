@@ -0,0 +1,122 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <stdlib.h>
+#include <new>
+#include "HostTest.h"
+#include "QueryArgs.h"
+
+using namespace lsc;
+
+/**
+ *   Every allocation in the process is counted, so a parser that builds a String or any other heap object fails
+ *   the allocation checks below.
+ */
+static long allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc((size>0)?(size):(1));
+  if( p == NULL ) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size)                 {return operator new(size);}
+void  operator delete(void* p) noexcept           {free(p);}
+void  operator delete[](void* p) noexcept         {free(p);}
+void  operator delete(void* p, size_t) noexcept   {free(p);}
+void  operator delete[](void* p, size_t) noexcept {free(p);}
+
+void testParseInt() {
+  long v = 7;
+  CHECK(QueryArgs::parseInt("0",v));            CHECK_EQ(v,0);
+  CHECK(QueryArgs::parseInt("123",v));          CHECK_EQ(v,123);
+  CHECK(QueryArgs::parseInt("-45",v));          CHECK_EQ(v,-45);
+  CHECK(QueryArgs::parseInt("+45",v));          CHECK_EQ(v,45);
+  CHECK(QueryArgs::parseInt("12:30",2,v));      CHECK_EQ(v,12);
+  v = 7;
+  CHECK(!QueryArgs::parseInt("",v));
+  CHECK(!QueryArgs::parseInt("-",v));
+  CHECK(!QueryArgs::parseInt("12a",v));
+  CHECK(!QueryArgs::parseInt(" 12",v));
+  CHECK(!QueryArgs::parseInt(NULL,v));
+  CHECK(!QueryArgs::parseInt("99999999999999999999999",v));
+  CHECK_EQ(v,7);
+}
+
+void testParseTime() {
+  int h = -1, m = -1;
+  CHECK(QueryArgs::parseTime("00:00",h,m));     CHECK_EQ(h,0);  CHECK_EQ(m,0);
+  CHECK(QueryArgs::parseTime("23:59",h,m));     CHECK_EQ(h,23); CHECK_EQ(m,59);
+  CHECK(QueryArgs::parseTime("08:05",h,m));     CHECK_EQ(h,8);  CHECK_EQ(m,5);
+  h = m = -1;
+  CHECK(!QueryArgs::parseTime("24:00",h,m));
+  CHECK(!QueryArgs::parseTime("12:60",h,m));
+  CHECK(!QueryArgs::parseTime("8:05",h,m));
+  CHECK(!QueryArgs::parseTime("08-05",h,m));
+  CHECK(!QueryArgs::parseTime("+8:05",h,m));
+  CHECK(!QueryArgs::parseTime("08:+5",h,m));
+  CHECK(!QueryArgs::parseTime(NULL,h,m));
+  CHECK_EQ(h,-1); CHECK_EQ(m,-1);
+}
+
+void testParseOffset() {
+  int h = 99, m = 99;
+  CHECK(QueryArgs::parseOffset("5",h,m));       CHECK_EQ(h,5);  CHECK_EQ(m,0);
+  CHECK(QueryArgs::parseOffset("-5",h,m));      CHECK_EQ(h,-5); CHECK_EQ(m,0);
+  CHECK(QueryArgs::parseOffset("-05:30",h,m));  CHECK_EQ(h,-5); CHECK_EQ(m,-30);
+  CHECK(QueryArgs::parseOffset("+09:45",h,m));  CHECK_EQ(h,9);  CHECK_EQ(m,45);
+  h = m = 99;
+  CHECK(!QueryArgs::parseOffset("",h,m));
+  CHECK(!QueryArgs::parseOffset("24",h,m));
+  CHECK(!QueryArgs::parseOffset("123",h,m));
+  CHECK(!QueryArgs::parseOffset("5:3",h,m));
+  CHECK(!QueryArgs::parseOffset("5:60",h,m));
+  CHECK(!QueryArgs::parseOffset("+-5",h,m));
+  CHECK(!QueryArgs::parseOffset(NULL,h,m));
+  CHECK_EQ(h,99); CHECK_EQ(m,99);
+}
+
+void testArgView() {
+  ArgView a("start_time_2","08:30");
+  CHECK_EQ(a.hash(),argHash("START_TIME_2"));
+  CHECK_EQ(a.prefix(),argHash("START_TIME_"));
+  CHECK_EQ(a.index(),2);
+  int h = 0, m = 0;
+  CHECK(a.toTime(h,m));                         CHECK_EQ(h,8);  CHECK_EQ(m,30);
+  ArgView b("STATE","on");
+  CHECK(b.is("ON"));
+  CHECK_EQ(b.prefix(),0);
+  CHECK_EQ(b.index(),-1);
+  ArgView c(NULL,NULL);
+  CHECK(c.empty());
+  CHECK_EQ(c.hash(),ARG_HASH_SEED);
+}
+
+int main() {
+  allocations = 0;
+  testParseInt();
+  testParseTime();
+  testParseOffset();
+  testArgView();
+  CHECK_EQ(allocations,0);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+/**
+ *
+ *  DeviceLib Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HostTest.h"
+#include "WeeklySchedule.h"
+
+using namespace lsc;
+
+static WeeklySchedule schedule;
+
+void testWorkdays() {
+  schedule.clear();
+  CHECK(schedule.add(8*60,17*60,0x3E));
+  CHECK(schedule.compile());
+  CHECK_EQ(schedule.numRanges(),5);
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(1,8,0)));
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(5,16,59)));
+  CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(1,7,59)));
+  CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(1,17,0)));
+  CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(0,12,0)));
+  CHECK_EQ(schedule.nextStart(WeeklySchedule::minuteOfWeek(1,17,0)),WeeklySchedule::minuteOfWeek(2,8,0));
+  CHECK_EQ(schedule.nextEnd(WeeklySchedule::minuteOfWeek(1,9,0)),WeeklySchedule::minuteOfWeek(1,17,0));
+  CHECK_EQ(schedule.nextStart(WeeklySchedule::minuteOfWeek(6,12,0)),WeeklySchedule::minuteOfWeek(1,8,0));
+  CHECK_EQ(schedule.nextEnd(WeeklySchedule::minuteOfWeek(6,12,0)),WeeklySchedule::minuteOfWeek(1,17,0));
+}
+
+/**
+ *  Saturday 22:00 to 02:00 wraps both midnight and the end of the week
+ */
+void testWrap() {
+  schedule.clear();
+  schedule.add(22*60,2*60,0x40);
+  CHECK(schedule.compile());
+  CHECK_EQ(schedule.numRanges(),2);
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(6,23,0)));
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(0,1,59)));
+  CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(0,2,0)));
+  CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(6,21,59)));
+  CHECK_EQ(schedule.nextEnd(WeeklySchedule::minuteOfWeek(6,23,0)),WeeklySchedule::minuteOfWeek(0,2,0));
+  CHECK_EQ(schedule.nextEnd(WeeklySchedule::minuteOfWeek(0,1,0)),WeeklySchedule::minuteOfWeek(0,2,0));
+  CHECK_EQ(schedule.nextStart(WeeklySchedule::minuteOfWeek(0,1,0)),WeeklySchedule::minuteOfWeek(6,22,0));
+}
+
+void testMerge() {
+  schedule.clear();
+  schedule.add(8*60,12*60);
+  schedule.add(11*60,14*60);
+  schedule.add(14*60,15*60);
+  schedule.add(9*60,9*60);
+  CHECK(schedule.compile());
+  CHECK_EQ(schedule.numRanges(),7);
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(3,14,30)));
+  CHECK_EQ(schedule.nextEnd(WeeklySchedule::minuteOfWeek(3,8,0)),WeeklySchedule::minuteOfWeek(3,15,0));
+}
+
+void testAlwaysAndNever() {
+  schedule.clear();
+  CHECK(schedule.compile());
+  CHECK(!schedule.isOn(0));
+  CHECK_EQ(schedule.nextStart(0),-1);
+  CHECK_EQ(schedule.nextEnd(0),-1);
+
+  schedule.add(0,MINUTES_PER_DAY);
+  CHECK(schedule.compile());
+  CHECK_EQ(schedule.numRanges(),1);
+  CHECK(schedule.isOn(0));
+  CHECK(schedule.isOn(MINUTES_PER_WEEK-1));
+  CHECK_EQ(schedule.nextStart(100),-1);
+  CHECK_EQ(schedule.nextEnd(100),-1);
+}
+
+/**
+ *  Every interval on every day and wrapping the end of the week is the most ranges a schedule can need. With the
+ *  default SCHEDULE_MAX_RANGES it compiles; built with fewer ranges (WeeklyScheduleSmallTest) compile fails and
+ *  leaves the schedule empty rather than partly built.
+ */
+void testLimits() {
+  schedule.clear();
+  for( int i=0; i<SCHEDULE_MAX_INTERVALS; i++ ) CHECK(schedule.add(23*60+i,60+i));
+  CHECK(!schedule.add(0,10));
+  CHECK_EQ(schedule.numIntervals(),SCHEDULE_MAX_INTERVALS);
+  CHECK(schedule.interval(SCHEDULE_MAX_INTERVALS) == NULL);
+  if( 8*SCHEDULE_MAX_INTERVALS <= SCHEDULE_MAX_RANGES ) {
+    CHECK(schedule.compile());
+    CHECK_EQ(schedule.numRanges(),8);
+    CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(3,23,30)));
+    CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(0,0,30)));
+    CHECK(!schedule.isOn(WeeklySchedule::minuteOfWeek(3,12,0)));
+    CHECK_EQ(schedule.nextStart(WeeklySchedule::minuteOfWeek(3,12,0)),WeeklySchedule::minuteOfWeek(3,23,0));
+  }
+  else {
+    CHECK(!schedule.compile());
+    CHECK_EQ(schedule.numRanges(),0);
+    int on = 0;
+    for( int m=0; m<MINUTES_PER_WEEK; m++ ) {if( schedule.isOn(m) ) on++;}
+    CHECK_EQ(on,0);
+    CHECK_EQ(schedule.nextStart(0),-1);
+    CHECK_EQ(schedule.nextEnd(0),-1);
+  }
+
+  schedule.clear();
+  for( int i=0; i<20; i++ ) schedule.add(i*60,i*60+30);
+  CHECK_EQ(schedule.compile(),(140 <= SCHEDULE_MAX_RANGES));
+  CHECK_EQ(schedule.isOn(WeeklySchedule::minuteOfWeek(2,5,15)),(140 <= SCHEDULE_MAX_RANGES));
+  schedule.clear();
+  schedule.add(8*60,17*60);
+  CHECK(schedule.compile());
+  CHECK(schedule.isOn(WeeklySchedule::minuteOfWeek(2,12,0)));
+}
+
+void testCalendar() {
+  CHECK_EQ(WeeklySchedule::dayOfWeek(2023,1,1),0);
+  CHECK_EQ(WeeklySchedule::dayOfWeek(2024,2,29),4);
+  CHECK_EQ(WeeklySchedule::dayOfWeek(2000,3,1),3);
+  CHECK(strcmp(WeeklySchedule::dayName(7),"Sun") == 0);
+  CHECK(strcmp(WeeklySchedule::dayName(-1),"Sat") == 0);
+}
+
+int main() {
+  testWorkdays();
+  testWrap();
+  testMerge();
+  testAlwaysAndNever();
+  testLimits();
+  testCalendar();
+  return HOST_TEST_RESULT();
+}